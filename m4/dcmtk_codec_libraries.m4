@@ -0,0 +1,48 @@
+dnl @synopsis CHECK_DCMTK_CODEC_LIBRARIES
+dnl
+dnl This macro tries to link DCMTK JPEG-LS and JPEG codecs. The CharLS
+dnl library is libcharls up to DCMTK 3.6.0 and libdcmtkcharls since
+dnl DCMTK 3.6.1.
+dnl Sets DCMTK_CODEC_LIBS to the codec libraries found.
+dnl
+
+AC_DEFUN( [CHECK_DCMTK_CODEC_LIBRARIES],
+[
+	have_dcmtk_codec_libraries=no
+	DCMTK_CODEC_LIBS=""
+
+	AC_CACHE_CHECK(for DCMTK CharLS library,
+		ac_cv_dcmtk_charls,
+		[AC_LANG_SAVE
+		AC_LANG_CPLUSPLUS
+		ac_save_CPPFLAGS="$CPPFLAGS"
+		ac_save_LIBS="$LIBS"
+		CPPFLAGS="$CPPFLAGS -DHAVE_CONFIG_H -I/usr/include -I/usr/local/include"
+		ac_cv_dcmtk_charls=no
+
+		for ac_charls in dcmtkcharls charls; do
+			LIBS="-L/usr/lib -L/usr/lib64 -L/usr/local/lib -L/usr/local/lib64 \
+				-L/usr/lib/dcmtk -L/usr/lib64/dcmtk -L/usr/local/lib/dcmtk -L/usr/local/lib64/dcmtk \
+				-ldcmjpls -l$ac_charls -ldcmjpeg -lijg8 -lijg12 -lijg16 \
+				-ldcmimage -ldcmimgle \
+				-ldcmdata -loflog -lofstd -lpthread -lz $ac_save_LIBS"
+			AC_TRY_LINK([#include <dcmtk/dcmjpls/djdecode.h>
+				#include <dcmtk/dcmjpeg/djdecode.h>],
+				[DJLSDecoderRegistration::registerCodecs();
+				DJDecoderRegistration::registerCodecs();],
+				ac_cv_dcmtk_charls=$ac_charls)
+			test "$ac_cv_dcmtk_charls" != no && break
+		done
+
+		CPPFLAGS="$ac_save_CPPFLAGS"
+		LIBS="$ac_save_LIBS"
+		AC_LANG_RESTORE
+		]
+		)
+
+	if test "$ac_cv_dcmtk_charls" != no; then
+		have_dcmtk_codec_libraries=yes
+		DCMTK_CODEC_LIBS="-ldcmjpls -l$ac_cv_dcmtk_charls \
+			-ldcmjpeg -lijg8 -lijg12 -lijg16 -ldcmimage -ldcmimgle"
+	fi
+]) dnl CHECK_DCMTK_CODEC_LIBRARIES
@@ -15,12 +15,22 @@
  *      MA 02110-1301, USA.
  */
 
+#include <algorithm>
 #include <iostream>
 
+#include <glibmm/convert.h>
+#include <glibmm/main.h>
+#include <glibmm/regex.h>
 #include <glibmm/thread.h>
 #include <giomm/init.h>
 
 #include "dicom/xmedcon_wrapper.h"
+#include "dicom/conquest.hpp"
+#include "dicom/conquest_search.hpp"
+#include "dicom/local_index.hpp"
+#include "dicom/storage_server.hpp"
+#include "dicom/store_spool.hpp"
+#include "dicom/user_commands.hpp"
 
 #include "global_strings.hpp"
 #include "main_window.hpp"
@@ -29,6 +39,12 @@
 
 #include "application.hpp"
 
+namespace {
+
+const unsigned int expire_interval = 10; // seconds, idle associations
+
+} // namespace
+
 namespace ScanAmati {
 
 int Application::count_ = 0;
@@ -52,6 +68,8 @@ Application::static_init()
 {
 	mdc_init();
 
+	DICOM::register_codecs();
+
 	Gio::init();
 
 	if (!Glib::thread_supported())
@@ -70,11 +88,131 @@ Application::init()
 	DICOM::ServersConfiguration config(file);
 	if (config.load_servers(app.dicom_servers))
 		OFLOG_DEBUG( app.log, "Dicom servers loaded successfully");	
+
+	// storage associations stay open for the next datasets
+	if (app.prefs.has_key( "Network", "association-idle-time")) {
+		int seconds = app.prefs.get<int>( "Network", "association-idle-time");
+		DICOM::AssociationPool::instance().set_idle_time(std::max( seconds, 0));
+	}
+	if (app.prefs.has_key( "Network", "store-compression"))
+		DICOM::AssociationPool::instance().set_compression(
+			DICOM::compression_type(app.prefs.get<Glib::ustring>(
+			"Network", "store-compression")));
+	expire_connection_ = Glib::signal_timeout().connect_seconds(
+		sigc::mem_fun( *this, &Application::on_expire_associations),
+		expire_interval);
+
+	// repeated archive searches are answered from memory
+	if (app.prefs.has_key( "ConQuest", "query-cache-time")) {
+		int seconds = app.prefs.get<int>( "ConQuest", "query-cache-time");
+		DICOM::ConquestCache::instance().set_max_age(std::max( seconds, 0));
+	}
+
+	// datasets left by the previous run are sent again
+	DICOM::StoreSpool& spool = DICOM::StoreSpool::instance();
+	if (app.prefs.has_key( "Network", "spool-backoff-initial") &&
+		app.prefs.has_key( "Network", "spool-backoff-maximum"))
+		spool.set_backoff(
+			std::max( app.prefs.get<int>( "Network", "spool-backoff-initial"), 1),
+			std::max( app.prefs.get<int>( "Network", "spool-backoff-maximum"), 1));
+	if (app.prefs.has_key( "Network", "spool-max-attempts"))
+		spool.set_max_attempts(std::max( app.prefs.get<int>( "Network",
+			"spool-max-attempts"), 0));
+	spool.start(get_spool_dir());
+
+	// local files are indexed in the background for the search dialog
+	DICOM::LocalIndex& index = DICOM::LocalIndex::instance();
+	index.load(get_index_file());
+	index.set_directories(index_directories());
+	if (app.prefs.has_key( "Index", "rescan-interval"))
+		index.set_rescan_interval(std::max( app.prefs.get<int>( "Index",
+			"rescan-interval"), 0));
+	index.start();
+
+	// other stations may push studies ahead of time, port 0 disables
+	int port = 0;
+	if (app.prefs.has_key( "Network", "storage-scp-port"))
+		port = app.prefs.get<int>( "Network", "storage-scp-port");
+	if (port > 0) {
+		int associations = 4;
+		if (app.prefs.has_key( "Network", "storage-scp-associations"))
+			associations = app.prefs.get<int>( "Network",
+				"storage-scp-associations");
+		DICOM::StorageServer::instance().set_calling_titles(
+			storage_calling_titles());
+		if (!DICOM::StorageServer::instance().start( port, get_received_dir(),
+			std::max( associations, 1)))
+			OFLOG_ERROR( app.log, "Storage SCP not started");
+	}
+}
+
+std::vector<std::string>
+Application::index_directories()
+{
+	std::vector<std::string> dirs(1, get_received_dir());
+	if (app.prefs.has_key( "Index", "directories")) {
+		Glib::ustring value = app.prefs.get<Glib::ustring>( "Index",
+			"directories");
+		std::vector<Glib::ustring> list = Glib::Regex::split_simple( ";",
+			value);
+		for ( std::vector<Glib::ustring>::const_iterator it = list.begin();
+			it != list.end(); ++it)
+			if (!it->empty())
+				dirs.push_back(Glib::filename_from_utf8(*it));
+	}
+
+	// the archive of the local ConQuest server
+	if (app.prefs.has_key( "ConQuest", "localhost-server-directory")) {
+		Glib::ustring dir = app.prefs.get<Glib::ustring>( "ConQuest",
+			"localhost-server-directory");
+		DICOM::ConquestFiles cfiles(dir.raw());
+		std::string archive = cfiles.get_settings().archive_directory();
+		if (!archive.empty() &&
+			std::find( dirs.begin(), dirs.end(), archive) == dirs.end())
+			dirs.push_back(archive);
+	}
+	return dirs;
+}
+
+/** The stations allowed to push studies, ";" separated. */
+std::vector<std::string>
+Application::storage_calling_titles()
+{
+	std::vector<std::string> titles;
+	if (app.prefs.has_key( "Network", "storage-scp-calling-titles")) {
+		Glib::ustring value = app.prefs.get<Glib::ustring>( "Network",
+			"storage-scp-calling-titles");
+		std::vector<Glib::ustring> list = Glib::Regex::split_simple( ";",
+			value);
+		for ( std::vector<Glib::ustring>::const_iterator it = list.begin();
+			it != list.end(); ++it)
+			if (!it->empty())
+				titles.push_back(it->raw());
+	}
+	return titles;
+}
+
+/**
+ * Idle associations are expired between the requests too, else they stay
+ * open until the server drops them and the next request fails first.
+ */
+bool
+Application::on_expire_associations()
+{
+	DICOM::AssociationPool::instance().expire();
+	return true;
 }
 
 void
 Application::finish()
 {
+	expire_connection_.disconnect();
+	DICOM::StoreSpool::instance().stop();
+	DICOM::StorageServer::instance().stop();
+	DICOM::LocalIndex::instance().stop();
+	DICOM::LocalIndex::instance().save();
+	DICOM::AssociationPool::instance().clear();
+
 	// save preferences
 	app.prefs.save();
 
@@ -93,6 +231,8 @@ Application::static_finish()
 		app.main_window = 0;
 	}
 
+	DICOM::cleanup_codecs();
+
 	mdc_finish();
 }
 
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <sigc++/connection.h>
+
 #include "dicom/server.hpp"
 
 #include "dcmtk_defines.hpp"
@@ -40,9 +42,14 @@ public:
 	void finish();
 
 private:
+	bool on_expire_associations();
+
 	static void static_init();
 	static void static_finish();
+	static std::vector<std::string> index_directories();
+	static std::vector<std::string> storage_calling_titles();
 	static int count_;
+	sigc::connection expire_connection_;
 };
 
 static Application application;
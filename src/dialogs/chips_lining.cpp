@@ -22,7 +22,7 @@
 #include <gtkmm/treemodelcolumn.h>
 
 // files from src directory begin
-#include "scanner/data.hpp"
+#include "scanner/manager.hpp"
 #include "global_strings.hpp"
 // files from src directory end
 
@@ -50,7 +50,8 @@ ChipsLiningDialog::ChipsLiningDialog( BaseObjectType* cobject,
 	:
 	ScannerTemplateDialog( cobject, builder, "chips-lining"),
 	builder_(builder),
-	treeview_chips_(0)
+	treeview_chips_(0),
+	geometry_(Scanner::Manager::instance()->geometry())
 {
 	init_ui();
 
@@ -71,8 +72,8 @@ ChipsLiningDialog::init_ui()
 	liststore_chips_ = Glib::RefPtr<Gtk::ListStore>::cast_dynamic(obj);
 
 	// add rows
-	for ( int i = 0; i < SCANNER_CHIPS; ++i) {
-		char code = Scanner::Data::chip_code(i);
+	for ( unsigned int i = 0; i < geometry_.chips; ++i) {
+		char code = geometry_.chip_code(i);
 
 		Gtk::TreeRow row = *(liststore_chips_->append());
 		row[model_columns.label] = Glib::ustring::format(
@@ -122,7 +123,7 @@ ChipsLiningDialog::set_lining_chips(const std::vector<char>& chips)
 {
 	for ( std::vector<char>::const_iterator it = chips.begin();
 		it != chips.end(); ++it) {
-			Glib::ustring text = Glib::ustring::format(Scanner::Data::chip_number(*it));
+			Glib::ustring text = Glib::ustring::format(geometry_.chip_number(*it));
 			Gtk::TreeIter iter = liststore_chips_->get_iter(text);
 			if (iter)
 				selection_chips_->select(iter);
@@ -20,6 +20,10 @@
 #include <gtkmm/liststore.h>
 #include <gtkmm/treeselection.h>
 
+// files from src directory begin
+#include "scanner/geometry.hpp"
+// files from src directory end
+
 #include "scanner_template.hpp"
 
 namespace Gtk {
@@ -54,6 +58,7 @@ protected:
 	Glib::RefPtr<Gtk::Builder> builder_;
 	Glib::RefPtr<Gtk::ListStore> liststore_chips_;
 	Glib::RefPtr<Gtk::TreeSelection> selection_chips_;
+	Scanner::Geometry geometry_;
 };
 
 } // namespace UI
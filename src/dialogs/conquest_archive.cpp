@@ -15,16 +15,21 @@
  *      MA 02110-1301, USA.
  */
 
-#include <pqxx/transaction>
+#include <algorithm>
 
+#include <gtkmm/checkbutton.h>
 #include <gtkmm/treeview.h>
 #include <glibmm/i18n.h>
+#include <glibmm/convert.h>
+#include <glibmm/main.h>
+#include <glibmm/miscutils.h>
 
 // files from src directory begin
 #include "application.hpp"
 #include "global_strings.hpp" // constant strings, filenames, paths
 
 #include "dicom/conquest.hpp"
+#include "dicom/conquest_search.hpp"
 #include "dicom/short_information.hpp"
 #include "dicom/utils.hpp"
 // files from src directory end
@@ -64,40 +69,17 @@ const struct ModelColumns : public Gtk::TreeModel::ColumnRecord {
 	}
 } model_columns;
 
-const char* conninfo = "dbname = 'conquest' user = 'postgres'";
-
-const char* prepared1 = "query_case_insense";
-
-const char* query1 =
-	"SELECT p.patientid, t.studyid, t.studydate, p.patientnam, p.patientsex, "
-	"p.patientbir, t.studydescr, t.studytime, t.studyinsta "
-		"FROM dicompatients p, dicomstudies t, dicomseries s, dicomimages i "
-			"WHERE (p.patientid = t.patientid) "
-			"AND (t.studyinsta = s.studyinsta) "
-			"AND (s.seriesinst = i.seriesinst) "
-			"AND (p.patientnam ~* $1) "
-			"AND (p.patientid ~* $2) "
-			"AND (t.studyid ~* $3) "
-			"ORDER BY p.patientid";
-
-const char* prepared2 = "query_case_sense";
-
-const char* query2 =
-	"SELECT p.patientid, t.studyid, t.studydate, p.patientnam, p.patientsex, "
-	"p.patientbir, t.studydescr, t.studytime, t.studyinsta "
-		"FROM dicompatients p, dicomstudies t, dicomseries s, dicomimages i "
-			"WHERE (p.patientid = t.patientid) "
-			"AND (t.studyinsta = s.studyinsta) "
-			"AND (s.seriesinst = i.seriesinst) "
-			"AND (p.patientnam ~ $1) "
-			"AND (p.patientid ~ $2) "
-			"AND (t.studyid ~ $3) "
-			"ORDER BY p.patientid";
+const unsigned int search_delay = 400; // ms after the last key press
 
-bool
-compare_ids( pqxx::tuple i, pqxx::tuple j)
+/** Destination of the moved images, the temporary directory by default. */
+std::string
+retrieve_directory()
 {
-	return (i[0].as(std::string()) != j[0].as(std::string()));
+	Glib::ustring dir;
+	if (ScanAmati::app.prefs.has_key( "Files", "retrieve-directory"))
+		dir = ScanAmati::app.prefs.get<Glib::ustring>( "Files",
+			"retrieve-directory");
+	return dir.empty() ? Glib::get_tmp_dir() : Glib::filename_from_utf8(dir);
 }
 
 class ConfirmationDialog : public Gtk::MessageDialog {
@@ -122,82 +104,6 @@ namespace ScanAmati {
 
 namespace UI {
 
-struct ArchiveItem {
-	ArchiveItem();
-	ArchiveItem( const Glib::ustring&,
-		const std::vector<ArchiveItem>&);
-	ArchiveItem(const ArchiveItem&);
-	~ArchiveItem();
-	ArchiveItem& operator=(const ArchiveItem&);
-
-	Glib::ustring study_id;
-	Glib::ustring study_descr;
-	Glib::Date study_date;
-	Glib::ustring study_time;
-	Glib::ustring patient_id;
-	Glib::ustring patient_name;
-	Glib::Date patient_birthday;
-	Glib::ustring patient_sex;
-	std::string study_instance_uid;
-	std::vector<ArchiveItem> children;
-};
-
-ArchiveItem::ArchiveItem()
-	:
-	study_date( 1, Glib::Date::JANUARY, 1900),
-	patient_birthday( 1, Glib::Date::JANUARY, 1900)
-{
-}
-
-ArchiveItem::ArchiveItem( const Glib::ustring& id,
-	const std::vector<ArchiveItem>& children_items)
-	:
-	study_id(id),
-	study_date( 1, Glib::Date::JANUARY, 1900),
-	patient_birthday( 1, Glib::Date::JANUARY, 1900),
-	children(children_items)
-{
-}
-
-ArchiveItem::ArchiveItem(const ArchiveItem& foo)
-	:
-	study_id(foo.study_id),
-	study_descr(foo.study_descr),
-	study_date(foo.study_date),
-	study_time(foo.study_time),
-	patient_id(foo.patient_id),
-	patient_name(foo.patient_name),
-	patient_birthday(foo.patient_birthday),
-	patient_sex(foo.patient_sex),
-	study_instance_uid(foo.study_instance_uid),
-	children(foo.children)
-{
-}
-
-ArchiveItem::~ArchiveItem()
-{
-}
-
-ArchiveItem&
-ArchiveItem::operator=(const ArchiveItem& foo)
-{
-	if (this == &foo)
-		return *this;
-
-	study_id = foo.study_id;
-	study_descr = foo.study_descr;
-	study_date = foo.study_date;
-	study_time = foo.study_time;
-	patient_id = foo.patient_id;
-	patient_name = foo.patient_name;
-	patient_birthday = foo.patient_birthday;
-	patient_sex = foo.patient_sex;
-	study_instance_uid = foo.study_instance_uid;
-	children = foo.children;
-
-	return *this;
-}
-
 ConquestArchiveDialog::ConquestArchiveDialog( BaseObjectType* cobject,
 	const Glib::RefPtr<Gtk::Builder>& builder)
 	:
@@ -212,7 +118,7 @@ ConquestArchiveDialog::ConquestArchiveDialog( BaseObjectType* cobject,
 	button_additional_query_(0),
 	button_find_(0),
 	button_clear_(0),
-	conn_(0)
+	found_(0)
 {
 	init_ui();
 
@@ -225,12 +131,8 @@ ConquestArchiveDialog::ConquestArchiveDialog( BaseObjectType* cobject,
 
 ConquestArchiveDialog::~ConquestArchiveDialog()
 {
+	search_timeout_.disconnect();
 /*
-	if (conn_) {
-		conn_->disconnect();
-		delete conn_;
-		conn_ = 0;
-	}
 	save_preferences();
 */
 }
@@ -344,33 +246,26 @@ ConquestArchiveDialog::connect_signals()
 		sigc::mem_fun( *this, &ConquestArchiveDialog::on_find_clicked));
 	button_clear_->signal_clicked().connect(
 		sigc::mem_fun( *this, &ConquestArchiveDialog::on_clear_clicked));
+
+	// searches start a while after typing stops
+	entry_patient_name_->signal_changed().connect(
+		sigc::mem_fun( *this, &ConquestArchiveDialog::on_query_changed));
+	entry_patient_id_->signal_changed().connect(
+		sigc::mem_fun( *this, &ConquestArchiveDialog::on_query_changed));
+	entry_study_id_->signal_changed().connect(
+		sigc::mem_fun( *this, &ConquestArchiveDialog::on_query_changed));
+	checkbutton_case_sensitive_->signal_toggled().connect(
+		sigc::mem_fun( *this, &ConquestArchiveDialog::on_query_changed));
 }
 
 void
 ConquestArchiveDialog::connect_database(const char* conninfo)
 {
-/*
-	try {
-		conn_ = new pqxx::connection(conninfo);
-
-		conn_->prepare( prepared1, query1);
-		conn_->prepare( prepared2, query2);
-	}
-	catch (const std::exception& err) {
-		Gtk::MessageDialog dialog( *this, "", false, Gtk::MESSAGE_ERROR,
-			Gtk::BUTTONS_CLOSE);
-
-		dialog.set_title(_("Connecting Error"));
-		dialog.set_message(_("Unable to establish a connection."));
-		dialog.run();
-
-		button_find_->set_sensitive(false);
-		button_clear_->set_sensitive(false);
-
-		delete conn_;
-		conn_ = 0;
-	}
-*/
+	search_.reset(new DICOM::ConquestSearch(conninfo));
+	search_->signal_page().connect(
+		sigc::mem_fun( *this, &ConquestArchiveDialog::on_search_page));
+	search_->signal_finished().connect(
+		sigc::mem_fun( *this, &ConquestArchiveDialog::on_search_finished));
 }
 
 void
@@ -391,6 +286,10 @@ ConquestArchiveDialog::fill_dicom_query( Gtk::TreeModel::Row& row,
 void
 ConquestArchiveDialog::on_response(int)
 {
+	search_timeout_.disconnect();
+	if (search_)
+		search_->cancel();
+
 	hide();
 }
 
@@ -421,7 +320,7 @@ ConquestArchiveDialog::on_treeview_row_activated(
 			dialog->signal_move_result().connect(sigc::bind(
 				sigc::mem_fun( *this, &ConquestArchiveDialog::on_move_result),
 				dialog));
-			dialog->move_query( query_dataset, _PATH_TMP);
+			dialog->move_query( query_dataset, retrieve_directory());
 			dialog->run();
 
 			delete dialog;
@@ -447,120 +346,122 @@ ConquestArchiveDialog::on_move_result( bool result, const Glib::ustring& msg,
 void
 ConquestArchiveDialog::on_clear_clicked()
 {
+	search_timeout_.disconnect();
+	if (search_)
+		search_->cancel();
+
 	treestore_->clear();
-	archive_items_.clear();
+	patient_row_ = Gtk::TreeModel::iterator();
+	found_ = 0;
 	label_found_->set_text("");
 }
 
 void
 ConquestArchiveDialog::on_find_clicked()
 {
-/*
-	Glib::ustring pn = entry_patient_name_->get_text();
-	Glib::ustring pi = entry_patient_id_->get_text();
-	Glib::ustring si = entry_study_id_->get_text();
+	search_timeout_.disconnect();
+	if (!search_)
+		return;
 
-	pqxx::result r;
+	DICOM::ConquestSearch::Criteria criteria;
+	criteria.patient_name = entry_patient_name_->get_text();
+	criteria.patient_id = entry_patient_id_->get_text();
+	criteria.study_id = entry_study_id_->get_text();
+	criteria.case_sensitive = checkbutton_case_sensitive_->get_active();
 
 	treestore_->clear();
-	archive_items_.clear();
-	label_found_->set_text("");
-
-	try {
-		pqxx::work w(*conn_);
-
-		r = checkbutton_case_sensitive_->get_active() ?
-			w.prepared(prepared2)(pn.raw())(pi.raw())(si.raw()).exec() :
-			w.prepared(prepared1)(pn.raw())(pi.raw())(si.raw()).exec();
+	patient_row_ = Gtk::TreeModel::iterator();
+	found_ = 0;
+	label_found_->set_text(_("Searching..."));
 
-		if (r.empty()) {
-			throw std::runtime_error("Can't exec prepared statement!");
-		}
-		else {
-			const char* files = ngettext( "file has been found",
-				"files have been found", r.size());
+	search_->search(criteria);
+}
 
-			Glib::ustring txt = Glib::ustring::compose( "%1 %2",
-				Glib::ustring::format(r.size()), Glib::ustring(files));
+void
+ConquestArchiveDialog::on_query_changed()
+{
+	search_timeout_.disconnect();
 
-			label_found_->set_text(txt);
-		}
-	}
-	catch (const std::exception&) {
-		label_found_->set_text(_("Nothing has been found"));
+	// an empty query would list the whole archive
+	if (entry_patient_name_->get_text().empty() &&
+		entry_patient_id_->get_text().empty() &&
+		entry_study_id_->get_text().empty())
 		return;
-	}
 
-	pqxx::result::const_iterator iter = r.begin();
-
-	std::vector<ArchiveItem> current_items;
-	while (iter != r.end()) {
-		pqxx::result::const_iterator iter_next =
-			std::unique( iter, r.end(), compare_ids);
-
-		for ( pqxx::result::const_iterator it = iter; it != iter_next; ++it) {
-			ArchiveItem current_item;
-			DICOM::ShortInfo info(it);
-
-			current_item.study_id = info.study_id;
-			current_item.study_descr = info.study_description;
-			current_item.study_date = info.study_date;
-			current_item.study_time = info.study_time_string();
-			current_item.patient_id = info.patient_id;
-			current_item.patient_name = info.patient_name;
-			current_item.patient_birthday = info.patient_birthday;
+	search_timeout_ = Glib::signal_timeout().connect(
+		sigc::mem_fun( *this, &ConquestArchiveDialog::on_search_timeout),
+		search_delay);
+}
 
-			Glib::ustring sex = DICOM::format_person_sex(
-				info.patient_sex, DICOM::SEX_STRING_SHORT);
- 
-			current_item.patient_sex = sex;
-			current_item.study_instance_uid = info.study_instance_uid;
+bool
+ConquestArchiveDialog::on_search_timeout()
+{
+	on_find_clicked();
+	return false;
+}
 
-			current_items.push_back(current_item);
-		}
+void
+ConquestArchiveDialog::on_search_page(const std::vector<DICOM::ShortInfo>& rows)
+{
+	std::for_each( rows.begin(), rows.end(),
+		sigc::mem_fun( *this, &ConquestArchiveDialog::add_study_info));
 
-		archive_items_.push_back(
-			ArchiveItem( DICOM::ShortInfo::summary_info(iter), current_items));
+	found_ += rows.size();
+	label_found_->set_text(Glib::ustring::compose( _("Searching... %1"),
+		Glib::ustring::format(found_)));
+}
 
-		current_items.clear();
+void
+ConquestArchiveDialog::on_search_finished( unsigned int found,
+	const Glib::ustring& error)
+{
+	if (!error.empty()) {
+		label_found_->set_text(error);
+	}
+	else if (!found) {
+		label_found_->set_text(_("Nothing has been found"));
+	}
+	else {
+		const char* files = ngettext( "file has been found",
+			"files have been found", found);
 
-		iter = std::unique( iter, r.end(), compare_ids);
-	};
+		Glib::ustring txt = Glib::ustring::compose( "%1 %2",
+			Glib::ustring::format(found), Glib::ustring(files));
 
-	std::for_each( archive_items_.begin(), archive_items_.end(),
-		sigc::mem_fun( *this, &ConquestArchiveDialog::add_archive_item));
-*/ 
+		label_found_->set_text(txt);
+	}
 }
 
+/**
+ * The rows come ordered by patient ID, a study of another patient than
+ * the one of the last row starts a new patient row.
+ */
 void
-ConquestArchiveDialog::add_archive_item(const ArchiveItem& foo)
+ConquestArchiveDialog::add_study_info(const DICOM::ShortInfo& info)
 {
-	Gtk::TreeRow row = *(treestore_->append());
-
-	row[model_columns.study_id] = foo.study_id;
-	row[model_columns.visible] = false;
-
-	// Add Children:
-	for ( std::vector<ArchiveItem>::const_iterator it = foo.children.begin();
-		it != foo.children.end(); ++it) {
-
-		const ArchiveItem& child = *it;
-
-		Gtk::TreeRow child_row = *(treestore_->append(row.children()));
-
-		child_row[model_columns.study_id] = child.study_id;
-		child_row[model_columns.study_descr] = child.study_descr;
-		child_row[model_columns.study_date] =
-			child.study_date.format_string("%x");
-		child_row[model_columns.study_time] = child.study_time;
-		child_row[model_columns.patient_id] = child.patient_id;
-		child_row[model_columns.patient_name] = child.patient_name;
-		child_row[model_columns.patient_birthday] =
-			child.patient_birthday.format_string("%x");
-		child_row[model_columns.patient_sex] = child.patient_sex;
-		child_row[model_columns.study_instance_uid] = child.study_instance_uid;
-		child_row[model_columns.visible] = true;
+	if (!patient_row_ || patient_id_ != info.patient_id) {
+		patient_row_ = treestore_->append();
+		patient_id_ = info.patient_id;
+
+		Gtk::TreeRow row = *patient_row_;
+		row[model_columns.study_id] = info.patient_summary();
+		row[model_columns.visible] = false;
 	}
+
+	Gtk::TreeRow child_row = *(treestore_->append(patient_row_->children()));
+
+	child_row[model_columns.study_id] = info.study_id;
+	child_row[model_columns.study_descr] = info.study_description;
+	child_row[model_columns.study_date] = info.study_date.format_string("%x");
+	child_row[model_columns.study_time] = info.study_time_string();
+	child_row[model_columns.patient_id] = info.patient_id;
+	child_row[model_columns.patient_name] = info.patient_name;
+	child_row[model_columns.patient_birthday] =
+		info.patient_birthday.format_string("%x");
+	child_row[model_columns.patient_sex] = DICOM::format_person_sex(
+		info.patient_sex, DICOM::SEX_STRING_SHORT);
+	child_row[model_columns.study_instance_uid] = info.study_instance_uid;
+	child_row[model_columns.visible] = true;
 }
 
 void
@@ -21,7 +21,8 @@
 #include <gtkmm/treestore.h>
 #include <gtkmm/builder.h>
 
-#include <pqxx/connection>
+#include <vector>
+#include <tr1/memory>
 
 namespace Gtk {
 class TreeView;
@@ -36,9 +37,15 @@ class DcmDataset;
 
 namespace ScanAmati {
 
+namespace DICOM {
+
+class ConquestSearch;
+struct ShortInfo;
+
+} // namespace DICOM
+
 namespace UI {
 
-struct ArchiveItem;
 class MoveDicomDialog;
 
 class ConquestArchiveDialog : public Gtk::Dialog {
@@ -58,12 +65,16 @@ protected:
 	void save_preferences();
 	void fill_dicom_query( Gtk::TreeModel::Row&, DcmDataset&);
 
-	void add_archive_item(const ArchiveItem&);
+	void add_study_info(const DICOM::ShortInfo&);
 
 	virtual void on_response(int);
 	void on_move_result( bool, const Glib::ustring&, MoveDicomDialog*);
 	void on_find_clicked();
 	void on_clear_clicked();
+	void on_query_changed();
+	bool on_search_timeout();
+	void on_search_page(const std::vector<DICOM::ShortInfo>&);
+	void on_search_finished( unsigned int, const Glib::ustring&);
 	void on_treeview_row_activated( const Gtk::TreeModel::Path&,
 		Gtk::TreeViewColumn*);
 
@@ -83,8 +94,11 @@ protected:
 	Gtk::Button* button_find_;
 	Gtk::Button* button_clear_;
 
-	std::vector<ArchiveItem> archive_items_;
-	pqxx::connection* conn_;
+	std::tr1::shared_ptr<DICOM::ConquestSearch> search_;
+	sigc::connection search_timeout_;
+	Gtk::TreeModel::iterator patient_row_; // the last one
+	Glib::ustring patient_id_;
+	unsigned int found_;
 	sigc::signal< void, const std::string&> signal_moved_filename_;
 };
 
@@ -59,9 +59,13 @@ LiningAcquisitionDialog::LiningAcquisitionDialog( BaseObjectType* cobject,
 	radiobutton_accuracy_optimal_(0),
 	radiobutton_accuracy_precise_(0),
 	accuracy_(Scanner::LINING_ACCURACY_OPTIMAL),
-	lining_data_ready_(false),
-	chip_codes_( Scanner::array_chip_codes, Scanner::array_chip_codes + SCANNER_CHIPS)
+	lining_data_ready_(false)
 {
+	// all the chips of the connected scanner are lined by default
+	Scanner::Geometry geometry = Scanner::Manager::instance()->geometry();
+	chip_codes_.assign( geometry.chip_codes,
+		geometry.chip_codes + geometry.chips);
+
 	init_ui();
 
 	connect_signals();
@@ -43,6 +43,12 @@ const struct ModelColumns : public Gtk::TreeModelColumnRecord {
 	ModelColumns() { add(strip); add(code); }
 } model_columns;
 
+const struct ChipColumns : public Gtk::TreeModelColumnRecord {
+	Gtk::TreeModelColumn<Glib::ustring> number;
+
+	ChipColumns() { add(number); }
+} chip_columns;
+
 } // namespace
 
 namespace ScanAmati {
@@ -61,7 +67,8 @@ LiningAdjustmentDialog::LiningAdjustmentDialog( BaseObjectType* cobject,
 	menuitem_write_all_(0),
 	menutoolbutton_load_from_file_(0),
 	menuitem_restore_current_(0),
-	menuitem_restore_all_(0)
+	menuitem_restore_all_(0),
+	geometry_(Scanner::Manager::instance()->geometry())
 {
 	init_ui();
 
@@ -91,6 +98,17 @@ LiningAdjustmentDialog::init_ui()
 	builder_->get_widget( "menuitem-write-all", menuitem_write_all_);
 
 	Glib::RefPtr<Glib::Object> obj;
+
+	// the chips of the connected scanner
+	obj = builder_->get_object("liststore-chip");
+	Glib::RefPtr<Gtk::ListStore> liststore_chip =
+		Glib::RefPtr<Gtk::ListStore>::cast_dynamic(obj);
+	liststore_chip->clear();
+	for ( unsigned int i = 0; i < geometry_.chips; ++i) {
+		Gtk::TreeRow row = *(liststore_chip->append());
+		row[chip_columns.number] = Glib::ustring::format(i);
+	}
+
 	obj = builder_->get_object("liststore-strip-code");
 	liststore_strip_code_ = Glib::RefPtr<Gtk::ListStore>::cast_dynamic(obj);
 
@@ -211,7 +229,7 @@ LiningAdjustmentDialog::set_lining_data(const Scanner::State& state)
 
 		char chip = state.chip();
 		if (chip) {
-			guint i = Scanner::Data::chip_number(chip);
+			guint i = geometry_.chip_number(chip);
 			combobox_chip_->set_active(i);
 		}
 
@@ -236,7 +254,7 @@ LiningAdjustmentDialog::on_chip_changed()
 	int i = combobox_chip_->get_active_row_number();
 	Scanner::SharedManager manager = Scanner::Manager::instance();
 	if (i != -1) {
-		char chip = Scanner::Data::chip_code(i);
+		char chip = geometry_.chip_code(i);
 
 		Scanner::Command* com = Scanner::Commands::create(
 			Scanner::COMMAND_SELECT_CHIP, chip);
@@ -296,7 +314,7 @@ LiningAdjustmentDialog::on_code_changed()
 	if (i != -1) {
 		guint strip = spinbutton_strip_->get_value_as_int() - 1;
 		guint8 code = spinbutton_code_->get_value_as_int();
-		char chip = Scanner::Data::chip_code(i);
+		char chip = geometry_.chip_code(i);
 		lining_[chip][strip] = code;
 		set_strip_code( strip, code);
 	}
@@ -308,7 +326,7 @@ LiningAdjustmentDialog::on_broadcast_changed()
 	int i = combobox_chip_->get_active_row_number();
 	if (i != -1) {
 		guint8 code = spinbutton_broadcast_->get_value_as_int();
-		char chip = Scanner::Data::chip_code(i);
+		char chip = geometry_.chip_code(i);
 		for ( guint strip = 0; strip < SCANNER_STRIPS_PER_CHIP_REAL; ++strip) {
 			lining_[chip][strip] = code;
 			set_strip_code( strip, code);
@@ -355,7 +373,7 @@ LiningAdjustmentDialog::on_load_lining()
 
 		int i = combobox_chip_->get_active_row_number();
 		if (i != -1) {
-			char chip = Scanner::Data::chip_code(i);
+			char chip = geometry_.chip_code(i);
 			for ( int j = 0; j < SCANNER_STRIPS_PER_CHIP_REAL; ++j)
 				set_strip_code( j, lining_[chip][j]);
 		}
@@ -374,7 +392,7 @@ LiningAdjustmentDialog::on_write_lining()
 	if (data) {
 		int i = combobox_chip_->get_active_row_number();
 		if (i != -1) {
-			char chip = Scanner::Data::chip_code(i);
+			char chip = geometry_.chip_code(i);
 			data->set_chip_lining( chip, lining_[chip]);
 
 			Scanner::Command* com =
@@ -20,6 +20,10 @@
 #include <gtkmm/liststore.h>
 #include <gtkmm/treeselection.h>
 
+// files from src directory begin
+#include "scanner/geometry.hpp"
+// files from src directory end
+
 #include "scanner_template.hpp"
 
 namespace Gtk {
@@ -78,6 +82,7 @@ protected:
 	Glib::RefPtr<Gtk::ListStore> liststore_strip_code_;
 	Glib::RefPtr<Gtk::TreeSelection> selection_strip_code_;
 	std::map< char, std::vector<guint8> > lining_;
+	Scanner::Geometry geometry_;
 };
 
 } // namespace UI
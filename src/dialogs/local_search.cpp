@@ -0,0 +1,281 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <gtkmm/treeview.h>
+#include <glibmm/convert.h>
+#include <glibmm/i18n.h>
+#include <glibmm/timer.h>
+
+// files from src directory begin
+#include "global_strings.hpp" // constant strings, filenames, paths
+
+#include "dicom/local_index.hpp"
+// files from src directory end
+
+#include "utils.hpp"
+
+#include "local_search.hpp"
+
+namespace {
+
+const struct ModelColumns : public Gtk::TreeModel::ColumnRecord {
+	Gtk::TreeModelColumn<Glib::ustring> patient_name;
+	Gtk::TreeModelColumn<Glib::ustring> patient_id;
+	Gtk::TreeModelColumn<Glib::ustring> study_date;
+	Gtk::TreeModelColumn<Glib::ustring> study_descr;
+	Gtk::TreeModelColumn<Glib::ustring> modality;
+	Gtk::TreeModelColumn<Glib::ustring> file;
+	Gtk::TreeModelColumn<std::string> filename;
+	ModelColumns() {
+		add(patient_name);
+		add(patient_id);
+		add(study_date);
+		add(study_descr);
+		add(modality);
+		add(file);
+		add(filename);
+	}
+} model_columns;
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace UI {
+
+LocalSearchDialog::LocalSearchDialog( BaseObjectType* cobject,
+	const Glib::RefPtr<Gtk::Builder>& builder)
+	:
+	Gtk::Dialog(cobject),
+	builder_(builder),
+	treeview_(0),
+	entry_text_(0),
+	entry_date_(0),
+	entry_modality_(0),
+	label_found_(0),
+	button_find_(0),
+	button_clear_(0)
+{
+	init_ui();
+
+	connect_signals();
+
+	show_all_children();
+
+	on_index_updated();
+}
+
+LocalSearchDialog::~LocalSearchDialog()
+{
+	index_connection_.disconnect();
+}
+
+void
+LocalSearchDialog::init_ui()
+{
+	liststore_ = Gtk::ListStore::create(model_columns);
+	builder_->get_widget( "treeview-results", treeview_);
+	treeview_->set_model(liststore_);
+
+	Glib::RefPtr<Gtk::TreeSelection> select = treeview_->get_selection();
+	select->set_mode(Gtk::SELECTION_SINGLE);
+
+	builder_->get_widget( "entry-text", entry_text_);
+	builder_->get_widget( "entry-date", entry_date_);
+	builder_->get_widget( "entry-modality", entry_modality_);
+	builder_->get_widget( "label-found", label_found_);
+	builder_->get_widget( "button-find", button_find_);
+	builder_->get_widget( "button-clear", button_clear_);
+
+	create_columns();
+}
+
+void
+LocalSearchDialog::create_columns()
+{
+	// Patient's Name column
+	int cc = treeview_->append_column( Q_("Patient|Name"),
+		model_columns.patient_name);
+	Gtk::TreeViewColumn* column = treeview_->get_column(cc - 1);
+	column->set_resizable();
+	column->set_alignment(Gtk::ALIGN_CENTER);
+
+	// Patient's ID column
+	cc = treeview_->append_column( Q_("Patient|ID"), model_columns.patient_id);
+	column = treeview_->get_column(cc - 1);
+	column->set_resizable();
+	column->set_alignment(Gtk::ALIGN_CENTER);
+
+	// Study Date column
+	cc = treeview_->append_column( Q_("Study|Date"), model_columns.study_date);
+	column = treeview_->get_column(cc - 1);
+	column->set_resizable();
+	column->set_alignment(Gtk::ALIGN_CENTER);
+
+	Gtk::CellRenderer* renderer = column->get_first_cell_renderer();
+	renderer->property_xalign() = 0.5;
+
+	// Study Description column
+	cc = treeview_->append_column( Q_("Study|Description"),
+		model_columns.study_descr);
+	column = treeview_->get_column(cc - 1);
+	column->set_resizable();
+	column->set_alignment(Gtk::ALIGN_CENTER);
+
+	// Modality column
+	cc = treeview_->append_column( _("Modality"), model_columns.modality);
+	column = treeview_->get_column(cc - 1);
+	column->set_resizable();
+	column->set_alignment(Gtk::ALIGN_CENTER);
+
+	renderer = column->get_first_cell_renderer();
+	renderer->property_xalign() = 0.5;
+
+	// File column
+	cc = treeview_->append_column( _("File"), model_columns.file);
+	column = treeview_->get_column(cc - 1);
+	column->set_resizable();
+	column->set_alignment(Gtk::ALIGN_CENTER);
+}
+
+void
+LocalSearchDialog::connect_signals()
+{
+	treeview_->signal_row_activated().connect(
+		sigc::mem_fun( *this, &LocalSearchDialog::on_treeview_row_activated));
+	button_find_->signal_clicked().connect(
+		sigc::mem_fun( *this, &LocalSearchDialog::on_find_clicked));
+	button_clear_->signal_clicked().connect(
+		sigc::mem_fun( *this, &LocalSearchDialog::on_clear_clicked));
+	index_connection_ = DICOM::LocalIndex::instance().signal_updated().connect(
+		sigc::mem_fun( *this, &LocalSearchDialog::on_index_updated));
+}
+
+void
+LocalSearchDialog::on_response(int)
+{
+	hide();
+}
+
+void
+LocalSearchDialog::on_find_clicked()
+{
+	DICOM::LocalIndex::Query query;
+	query.text = entry_text_->get_text();
+	query.date = entry_date_->get_text();
+	query.modality = entry_modality_->get_text();
+
+	Glib::Timer timer;
+	std::vector<DICOM::LocalIndex::Record> records;
+	unsigned int found = DICOM::LocalIndex::instance().search( query, records);
+	double elapsed = timer.elapsed();
+
+	liststore_->clear();
+	for ( std::vector<DICOM::LocalIndex::Record>::const_iterator it =
+		records.begin(); it != records.end(); ++it) {
+		Gtk::TreeRow row = *(liststore_->append());
+
+		Glib::ustring date = it->study_date;
+		if (date.size() == 8)
+			date = Glib::ustring::compose( "%1-%2-%3", date.substr( 0, 4),
+				date.substr( 4, 2), date.substr( 6, 2));
+
+		row[model_columns.patient_name] = it->patient_name;
+		row[model_columns.patient_id] = it->patient_id;
+		row[model_columns.study_date] = date;
+		row[model_columns.study_descr] = it->study_description;
+		row[model_columns.modality] = (it->kind == DICOM::LocalIndex::KIND_RAW) ?
+			Glib::ustring("RAW") : it->modality;
+		row[model_columns.file] = Glib::filename_display_basename(it->filename);
+		row[model_columns.filename] = it->filename;
+	}
+
+	const char* files = ngettext( "file has been found",
+		"files have been found", found);
+
+	Glib::ustring txt = Glib::ustring::compose( "%1 %2 (%3 ms)",
+		Glib::ustring::format(found), Glib::ustring(files),
+		Glib::ustring::format(static_cast<int>(elapsed * 1000.0 + 0.5)));
+	if (found > records.size())
+		txt += Glib::ustring::compose( _(", the first %1 are shown"),
+			Glib::ustring::format(records.size()));
+
+	label_found_->set_text(txt);
+}
+
+void
+LocalSearchDialog::on_clear_clicked()
+{
+	liststore_->clear();
+	entry_text_->set_text("");
+	entry_date_->set_text("");
+	entry_modality_->set_text("");
+	on_index_updated();
+}
+
+void
+LocalSearchDialog::on_index_updated()
+{
+	if (liststore_->children().size())
+		return;
+
+	const DICOM::LocalIndex& index = DICOM::LocalIndex::instance();
+	Glib::ustring txt = Glib::ustring::compose( _("%1 files indexed"),
+		Glib::ustring::format(index.size()));
+	if (index.busy())
+		txt += _(", indexing...");
+
+	label_found_->set_text(txt);
+}
+
+void
+LocalSearchDialog::on_treeview_row_activated( const Gtk::TreeModel::Path& path,
+	Gtk::TreeViewColumn*)
+{
+	Gtk::TreeModel::iterator iter = liststore_->get_iter(path);
+	if (!iter)
+		return;
+
+	Gtk::TreeModel::Row row = *iter;
+	std::string filename = row[model_columns.filename];
+	signal_open_filename_(filename);
+}
+
+sigc::signal< void, const std::string&>
+LocalSearchDialog::signal_open_filename()
+{
+	return signal_open_filename_;
+}
+
+LocalSearchDialog*
+LocalSearchDialog::create()
+{
+	LocalSearchDialog* dialog = 0;
+	std::string filename(builder_local_search_dialog_filename);
+
+	Glib::RefPtr<Gtk::Builder> builder = create_from_file(filename);
+
+	if (builder)
+		//Get the GtkBuilder-instantiated dialog
+		builder->get_widget_derived( "dialog-window", dialog);
+
+	return dialog;
+}
+
+} // namespace UI
+
+} // namespace ScanAmati
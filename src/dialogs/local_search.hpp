@@ -0,0 +1,78 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <gtkmm/dialog.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/builder.h>
+
+namespace Gtk {
+class TreeView;
+class Entry;
+class Label;
+class Button;
+class TreeViewColumn;
+} // namespace Gtk
+
+namespace ScanAmati {
+
+namespace UI {
+
+/**
+ * Search of the local DICOM and raw files in the background index,
+ * an activated row opens its file.
+ */
+class LocalSearchDialog : public Gtk::Dialog {
+public:
+	LocalSearchDialog( BaseObjectType* cobject,
+		const Glib::RefPtr<Gtk::Builder>& builder);
+	virtual ~LocalSearchDialog();
+	sigc::signal< void, const std::string&> signal_open_filename();
+	static LocalSearchDialog* create();
+
+protected:
+	void init_ui();
+	void connect_signals();
+	void create_columns();
+
+	virtual void on_response(int);
+	void on_find_clicked();
+	void on_clear_clicked();
+	void on_index_updated();
+	void on_treeview_row_activated( const Gtk::TreeModel::Path&,
+		Gtk::TreeViewColumn*);
+
+	// GUI members
+	Glib::RefPtr<Gtk::Builder> builder_;
+	Glib::RefPtr<Gtk::ListStore> liststore_;
+
+	Gtk::TreeView* treeview_;
+	Gtk::Entry* entry_text_;
+	Gtk::Entry* entry_date_;
+	Gtk::Entry* entry_modality_;
+	Gtk::Label* label_found_;
+	Gtk::Button* button_find_;
+	Gtk::Button* button_clear_;
+
+	sigc::connection index_connection_;
+	sigc::signal< void, const std::string&> signal_open_filename_;
+};
+
+} // namespace UI
+
+} // namespace ScanAmati
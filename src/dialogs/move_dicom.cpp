@@ -15,6 +15,9 @@
  *      MA 02110-1301, USA.
  */
 
+#include <algorithm>
+#include <list>
+
 #include <gtkmm/combobox.h>
 #include <gtkmm/progressbar.h>
 #include <gtkmm/main.h>
@@ -33,8 +36,8 @@
 #include "global_strings.hpp"
 
 #include "dicom/conquest.hpp"
+#include "dicom/retriever.hpp"
 #include "dicom/server.hpp"
-#include "dicom/user_commands.hpp"
 // files from src directory end
 
 #include "utils.hpp"
@@ -43,18 +46,46 @@
 
 namespace {
 
-ScanAmati::UI::MoveDicomDialog* dialog_ptr;
+typedef std::tr1::shared_ptr<ScanAmati::DICOM::Retriever> RetrieverPtr;
 
-void
-progress( void* callback_data, T_DIMSE_StoreProgress* prog,
-	T_DIMSE_C_StoreRQ* req, char* file, DcmDataset** image,
-	T_DIMSE_C_StoreRSP* response, DcmDataset** status)
+/*
+ * Cancelled retrievers outlive their dialogs until the server has
+ * stopped, the ones still running at exit are left to the process.
+ */
+std::list<RetrieverPtr>* orphans = 0;
+
+const unsigned int reap_interval = 1; // seconds
+
+bool
+reap_orphans()
 {
-	dialog_ptr->move_progress( callback_data, prog, req, file, image,
-		response, status);
+	for ( std::list<RetrieverPtr>::iterator it = orphans->begin();
+		it != orphans->end(); )
+		if (!(*it)->busy()) {
+			(*it)->wait();
+			orphans->erase(it++);
+		}
+		else
+			++it;
+
+	if (!orphans->empty())
+		return true;
+
+	delete orphans;
+	orphans = 0;
+	return false;
 }
 
-DIMSE_StoreProviderCallback progress_callback = &progress;
+void
+adopt_orphan(const RetrieverPtr& retriever)
+{
+	if (!orphans) {
+		orphans = new std::list<RetrieverPtr>;
+		Glib::signal_timeout().connect_seconds( sigc::ptr_fun(&reap_orphans),
+			reap_interval);
+	}
+	orphans->push_back(retriever);
+}
 
 } // namespace
 
@@ -78,6 +109,11 @@ MoveDicomDialog::MoveDicomDialog( BaseObjectType* cobject,
 
 MoveDicomDialog::~MoveDicomDialog()
 {
+	// the dialog is closed at once, the retrieve stops in the background
+	if (retriever_ && retriever_->busy()) {
+		retriever_->cancel();
+		adopt_orphan(retriever_);
+	}
 }
 
 void
@@ -114,14 +150,17 @@ MoveDicomDialog::query(const DcmDataset& query)
 	server.title = csettings.title();
 	server.port = csettings.port();
 
-	try {
-		DICOM::MoveCommand comm(server);
-		bool res = comm.run( query, directory_.c_str(), progress_callback);
-		signal_move_result_( res, message_);
-	}
-	catch (const Exception& ex) {
-		signal_move_result_( false, ex.what());
-	}
+	retriever_.reset(new DICOM::Retriever);
+	retriever_->signal_progress().connect(
+		sigc::mem_fun( *this, &MoveDicomDialog::on_retrieve_progress));
+	retriever_->signal_done().connect(
+		sigc::mem_fun( *this, &MoveDicomDialog::on_retrieve_done));
+
+	progressbar_->set_fraction(0.);
+	progressbar_->set_text(_("Waiting for the server..."));
+
+	if (!retriever_->start( server, query, directory_))
+		signal_move_result_( false, retriever_->error());
 }
 
 void
@@ -131,82 +170,62 @@ MoveDicomDialog::on_response(int)
 }
 
 void
-MoveDicomDialog::move_progress( void* callback_data,
-	T_DIMSE_StoreProgress* prog, T_DIMSE_C_StoreRQ* req, char* file,
-	DcmDataset** image, T_DIMSE_C_StoreRSP* response, DcmDataset** status)
+MoveDicomDialog::on_retrieve_progress()
+{
+	DICOM::Retriever::Progress progress = retriever_->progress();
+
+	// the server tells the number of the images to come
+	unsigned int total = progress.remaining + progress.completed +
+		progress.failed_suboperations;
+	if (total) {
+		progressbar_->set_fraction( double(std::min( progress.written +
+			progress.failed, total)) / total);
+		progressbar_->set_text(Glib::ustring::compose(
+			_("Have been retrieved %1 of %2 images."),
+			Glib::ustring::format(progress.written),
+			Glib::ustring::format(total)));
+	}
+	else if (progress.total_bytes) {
+		progressbar_->set_fraction( double(progress.bytes) /
+			progress.total_bytes);
+		progressbar_->set_text(Glib::ustring::compose(
+			_("Have been read %1 of %2 bytes."),
+			Glib::ustring::format(progress.bytes),
+			Glib::ustring::format(progress.total_bytes)));
+	}
+}
+
+void
+MoveDicomDialog::on_retrieve_done()
 {
-	switch (prog->state) {
-	case DIMSE_StoreBegin:
-		progressbar_->set_fraction(0.);
-		break;
-	case DIMSE_StoreEnd:
+	retriever_->wait();
+
+	DICOM::Retriever::Progress progress = retriever_->progress();
+	std::vector<std::string> files = retriever_->filenames();
+	Glib::ustring error = retriever_->error();
+
+	if (progress.failed)
+		error = _("Cannot write DICOM file.");
+	else if (error.empty() && progress.failed_suboperations)
+		error = Glib::ustring::compose(
+			_("The server has failed to send %1 of %2 images."),
+			Glib::ustring::format(progress.failed_suboperations),
+			Glib::ustring::format(progress.completed +
+			progress.failed_suboperations));
+	else if (error.empty() && files.empty())
+		error = _("Nothing has been retrieved.");
+
+	if (!files.empty()) {
 		progressbar_->set_fraction(1.);
 		progressbar_->set_text(_("File has been moved successfully!"));
-		break;
-	default:
-		{
-			double fraction = double(prog->progressBytes) / prog->totalBytes;
-			progressbar_->set_fraction(fraction);
-			Glib::ustring text = Glib::ustring::compose(
-				_("Have been read %1 of %2 bytes."),
-				Glib::ustring::format(prog->progressBytes),
-				Glib::ustring::format(prog->totalBytes));
-			progressbar_->set_text(text);
-		}
-		while (Gtk::Main::events_pending())
-			Gtk::Main::iteration();
-		break;
 	}
 
-	if (prog->state == DIMSE_StoreEnd) {
-		*status = NULL;
-
-		if ((image != NULL) && (*image != NULL)) {
-			DICOM::UserCommand::StoreCallbackData* cbdata =
-				static_cast<DICOM::UserCommand::StoreCallbackData*>(callback_data);
-
-			E_TransferSyntax xfer = (*image)->getOriginalXfer();
-
-			// create full path name for the output file
-			OFString ofname;
-			OFStandard::combineDirAndFilename( ofname, directory_.c_str(),
-				cbdata->imageFileName, OFTrue);
-
-			OFCondition cond = cbdata->dcmff->saveFile( ofname.c_str(), xfer,
-				EET_ExplicitLength, EGL_withGL, EPD_withoutPadding, 0, 0,
-				EWM_fileformat);
-
-			if (cond.bad()) {
-				OFLOG_DEBUG( app.log, "Cannot write DICOM file: " << ofname);
-				response->DimseStatus = STATUS_STORE_Refused_OutOfResources;
-				message_ = Glib::ustring(_("Cannot write DICOM file."));
-			}
-			else
-				message_ = Glib::ustring(ofname.c_str());
-			if (response->DimseStatus == STATUS_Success) {
-				DIC_UI sopClass;
-				DIC_UI sopInstance;
-				// which SOP class and SOP instance ?
-/*
-				if (!DU_findSOPClassAndInstanceInDataSet( *image,
-					sopClass, sopInstance, OFFalse)) {
-
-					OFLOG_DEBUG( app.log, "Bad DICOM file: " << image);
-					response->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
-					message_ = Glib::ustring(_("Bad DICOM file."));
-				}
-				else if (strcmp( sopClass, req->AffectedSOPClassUID) != 0) {
-					response->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
-					message_ = Glib::ustring(_("Data doesn't match SOP class IUD."));
-				}
-				else if (strcmp( sopInstance, req->AffectedSOPInstanceUID) != 0) {
-					response->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
-					message_ = Glib::ustring(_("Data doesn't match SOP instance IUD."));
-				}
-*/
-			}
-		}
-    }
+	for ( std::vector<std::string>::const_iterator it = files.begin();
+		it != files.end(); ++it)
+		signal_move_result_( true, *it);
+
+	if (!error.empty())
+		signal_move_result_( false, error);
 }
 
 sigc::signal< void, bool, const Glib::ustring&>
@@ -227,8 +246,6 @@ MoveDicomDialog::create()
 		//Get the GtkBuilder-instantiated dialog
 		builder->get_widget_derived( "dialog-window", dialog);
 
-	dialog_ptr = dialog;
-
 	return dialog;
 }
 
@@ -20,9 +20,9 @@
 #include <gtkmm/dialog.h>
 #include <gtkmm/builder.h>
 
-struct T_DIMSE_StoreProgress; // progress state
-struct T_DIMSE_C_StoreRQ; // original store request
-struct T_DIMSE_C_StoreRSP; // final store response
+#include <tr1/memory>
+
+class DcmDataset;
 
 namespace Gtk {
 class ProgressBar;
@@ -30,17 +30,22 @@ class ProgressBar;
 
 namespace ScanAmati {
 
+namespace DICOM {
+class Retriever;
+} // namespace DICOM
+
 namespace UI {
 
+/**
+ * Retrieve of a query from the local ConQuest server, the result is
+ * signalled for every written file or once for a failure.
+ */
 class MoveDicomDialog : public Gtk::Dialog {
 public:
 	static MoveDicomDialog* create();
 	MoveDicomDialog( BaseObjectType* cobject,
 		const Glib::RefPtr<Gtk::Builder>& builder);
 	virtual ~MoveDicomDialog();
-	virtual void move_progress( void*, T_DIMSE_StoreProgress*,
-		T_DIMSE_C_StoreRQ*,	char*, DcmDataset**,
-		T_DIMSE_C_StoreRSP*, DcmDataset**);
 	void move_query( const DcmDataset&, const std::string& dir);
 	sigc::signal< void, bool, const Glib::ustring&> signal_move_result();
 
@@ -52,12 +57,14 @@ protected:
 
 	// Signal handlers:
 	virtual void on_response(int);
+	void on_retrieve_progress();
+	void on_retrieve_done();
 
 	// Members:
 	Glib::RefPtr<Gtk::Builder> builder_;
 	Gtk::ProgressBar* progressbar_;
 	std::string directory_;
-	Glib::ustring message_;
+	std::tr1::shared_ptr<DICOM::Retriever> retriever_;
 	sigc::signal< void, bool, const Glib::ustring&> signal_move_result_;
 };
 
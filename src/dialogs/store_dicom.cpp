@@ -16,11 +16,15 @@
  */
 
 #include <gtkmm/combobox.h>
+#include <gtkmm/label.h>
 #include <gtkmm/progressbar.h>
 #include <gtkmm/main.h>
 #include <gtkmm/textbuffer.h>
 #include <gtkmm/textview.h>
 
+#include <algorithm>
+#include <iomanip>
+
 #include <giomm/file.h>
 
 #include <glibmm/i18n.h>
@@ -32,8 +36,10 @@
 
 #include "global_strings.hpp"
 
+#include "dicom/batch_store.hpp"
 #include "dicom/conquest.hpp"
 #include "dicom/server.hpp"
+#include "dicom/store_spool.hpp"
 #include "dicom/user_commands.hpp"
 #include "dicom/utils.hpp"
 // files from src directory end
@@ -77,6 +83,8 @@ StoreDicomDialog::StoreDicomDialog( BaseObjectType* cobject,
 	builder_(builder),
 	progressbar_(0),
 	button_store_(0),
+	label_queue_(0),
+	button_retry_(0),
 	combobox_servers_(0),
 	textview_status_(0),
 	textview_errors_(0),
@@ -94,14 +102,30 @@ StoreDicomDialog::StoreDicomDialog( BaseObjectType* cobject,
 
 	load_preferences();
 
+	on_spool_changed();
+
 	show_all_children();
 }
 
 StoreDicomDialog::~StoreDicomDialog()
 {
+	spool_connection_.disconnect();
+	if (batch_) {
+		batch_->cancel();
+		batch_->wait();
+	}
 	save_preferences();
 }
 
+void
+StoreDicomDialog::set_files(const std::vector<std::string>& filenames)
+{
+	filenames_ = filenames;
+	progressbar_->set_text(Glib::ustring::compose(
+		ngettext( "%1 file to store.", "%1 files to store.",
+		filenames_.size()), Glib::ustring::format(filenames_.size())));
+}
+
 void
 StoreDicomDialog::init_ui()
 {
@@ -112,6 +136,8 @@ StoreDicomDialog::init_ui()
 	liststore_servers_ = Glib::RefPtr<Gtk::ListStore>::cast_dynamic(obj);
 
 	builder_->get_widget( "button-store", button_store_);
+	builder_->get_widget( "label-queue", label_queue_);
+	builder_->get_widget( "button-retry", button_retry_);
 	builder_->get_widget( "progressbar", progressbar_);
 	builder_->get_widget( "textview-errors", textview_errors_);
 	builder_->get_widget( "textview-status", textview_status_);
@@ -163,6 +189,10 @@ StoreDicomDialog::connect_signals()
 		*this, &StoreDicomDialog::on_dicom_server_changed));
 	button_store_->signal_clicked().connect(sigc::mem_fun(
 		*this, &StoreDicomDialog::on_store));
+	button_retry_->signal_clicked().connect(sigc::mem_fun(
+		*this, &StoreDicomDialog::on_retry));
+	spool_connection_ = DICOM::StoreSpool::instance().signal_changed().connect(
+		sigc::mem_fun( *this, &StoreDicomDialog::on_spool_changed));
 
 	if (textview_status_)
 		filemonitor_status_->signal_changed().connect(
@@ -238,8 +268,8 @@ StoreDicomDialog::on_errors_changed( const Glib::RefPtr<Gio::File>& file,
 	}
 }
 
-void
-StoreDicomDialog::on_store()
+DICOM::Server
+StoreDicomDialog::selected_server()
 {
 	DICOM::Server server;
 	Gtk::TreeIter iter = combobox_servers_->get_active();
@@ -260,16 +290,133 @@ StoreDicomDialog::on_store()
 		else
 			server = app.dicom_servers[id];
 	}
+	return server;
+}
 
+void
+StoreDicomDialog::on_store()
+{
+	DICOM::Server server = selected_server();
+
+	if (!filenames_.empty()) {
+		if (batch_ && batch_->busy())
+			return;
+
+		unsigned int associations = 4;
+		if (app.prefs.has_key( "Network", "store-associations"))
+			associations = std::max( 1,
+				app.prefs.get<int>( "Network", "store-associations"));
+
+		batch_.reset(new DICOM::BatchStore(associations));
+		batch_->set_spool(true);
+		batch_->add_server(server);
+		for ( std::vector<std::string>::const_iterator it = filenames_.begin();
+			it != filenames_.end(); ++it)
+			batch_->add_file(*it);
+
+		batch_->signal_progress().connect(sigc::mem_fun( *this,
+			&StoreDicomDialog::on_batch_progress));
+		batch_->signal_done().connect(sigc::mem_fun( *this,
+			&StoreDicomDialog::on_batch_done));
+
+		if (batch_->start()) {
+			button_store_->set_sensitive(false);
+			progressbar_->set_fraction(0.);
+		}
+		return;
+	}
+
+	DICOM::StoreSpool& spool = DICOM::StoreSpool::instance();
 	try {
 		DICOM::StoreCommand store(server);
-		bool res = store.run( dataset_, progress_callback);
+		store.run( dataset_, progress_callback);
+
+		// the server is back, the queued datasets need not wait
+		spool.retry_now();
+		return;
+	}
+	catch (const DICOM::StoreRejected& ex) {
+		OFLOG_ERROR( app.log, "Image is rejected: " << ex.what());
+		progressbar_->set_fraction(0.);
+		progressbar_->set_text(ex.what());
+		return;
+	}
+	catch (const Exception& ex) {
+		OFLOG_ERROR( app.log, "Image is not stored: " << ex.what());
+	}
+
+	// the spool sends it when the server is back
+	try {
+		spool.enqueue( *dataset_, server, DICOM::StoreSpool::PRIORITY_URGENT);
+
+		progressbar_->set_fraction(0.);
+		progressbar_->set_text(Glib::ustring::compose(
+			_("Server is unavailable, the image is queued (%1 waiting)."),
+			Glib::ustring::format(spool.metrics().waiting())));
 	}
 	catch (const Exception& ex) {
-		std::cout << ex.what() << std::endl;
+		OFLOG_ERROR( app.log, "Image is not queued: " << ex.what());
+		progressbar_->set_fraction(0.);
+		progressbar_->set_text(Glib::ustring::compose(
+			_("Image is neither stored nor queued: %1"), ex.what()));
 	}
 }
 
+void
+StoreDicomDialog::on_batch_progress()
+{
+	DICOM::BatchStore::Statistics stat = batch_->statistics();
+	unsigned int done = stat.stored + stat.failed + stat.spooled;
+
+	if (stat.total)
+		progressbar_->set_fraction(double(done) / stat.total);
+
+	Glib::ustring text = Glib::ustring::compose(
+		_("Stored %1 of %2 files, %3 failed, %4 queued (%5 MB/s)."),
+		Glib::ustring::format(stat.stored),
+		Glib::ustring::format(stat.total),
+		Glib::ustring::format(stat.failed),
+		Glib::ustring::format(stat.spooled),
+		Glib::ustring::format( std::fixed, std::setprecision(2),
+			stat.rate() / (1024. * 1024.)));
+	progressbar_->set_text(text);
+}
+
+void
+StoreDicomDialog::on_batch_done()
+{
+	on_batch_progress();
+	button_store_->set_sensitive(true);
+
+	std::vector<Glib::ustring> errors = batch_->errors();
+	if (errors.empty() || !textview_errors_)
+		return;
+
+	Glib::ustring text;
+	for ( std::vector<Glib::ustring>::const_iterator it = errors.begin();
+		it != errors.end(); ++it)
+		text += *it + "\n";
+
+	Glib::RefPtr<Gtk::TextBuffer> buf = Gtk::TextBuffer::create();
+	buf->set_text(text);
+	textview_errors_->set_buffer(buf);
+}
+
+void
+StoreDicomDialog::on_spool_changed()
+{
+	DICOM::StoreSpool::Metrics metrics =
+		DICOM::StoreSpool::instance().metrics();
+	label_queue_->set_text(metrics.summary());
+	button_retry_->set_sensitive(metrics.waiting());
+}
+
+void
+StoreDicomDialog::on_retry()
+{
+	DICOM::StoreSpool::instance().retry_now();
+}
+
 void
 StoreDicomDialog::on_response(int)
 {
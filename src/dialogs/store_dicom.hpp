@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+#include <tr1/memory>
+
 #include <gtkmm/dialog.h>
 #include <gtkmm/builder.h>
 #include <gtkmm/liststore.h>
@@ -30,6 +34,7 @@ struct T_DIMSE_C_StoreRQ;
 namespace Gtk {
 class TextView;
 class ComboBox;
+class Label;
 class ProgressBar;
 class Button;
 } // namespace Gtk
@@ -37,7 +42,9 @@ class Button;
 namespace ScanAmati {
 
 namespace DICOM {
+class BatchStore;
 class Dataset;
+struct Server;
 } // namespace DICOM;
 
 namespace UI {
@@ -48,6 +55,8 @@ public:
 	StoreDicomDialog( BaseObjectType* cobject,
 		const Glib::RefPtr<Gtk::Builder>& builder);
 	virtual ~StoreDicomDialog();
+	/** Store the files instead of the dataset. */
+	void set_files(const std::vector<std::string>& filenames);
 	virtual void store_progress( void*, T_DIMSE_StoreProgress*,
 		T_DIMSE_C_StoreRQ*);
 
@@ -58,11 +67,16 @@ protected:
 	void load_preferences();
 	void save_preferences();
 	void fill_servers_liststore();
+	DICOM::Server selected_server();
 
 	// Signal handlers:
 	virtual void on_response(int);
 	void on_dicom_server_changed();
 	void on_store();
+	void on_batch_progress();
+	void on_batch_done();
+	void on_spool_changed();
+	void on_retry();
 
 	// Conquest status log file handler
 	void on_status_changed( const Glib::RefPtr<Gio::File>&,
@@ -75,6 +89,8 @@ protected:
 	Glib::RefPtr<Gtk::Builder> builder_;
 	Gtk::ProgressBar* progressbar_;
 	Gtk::Button* button_store_;
+	Gtk::Label* label_queue_;
+	Gtk::Button* button_retry_;
 	Gtk::ComboBox* combobox_servers_;
 	Glib::RefPtr<Gtk::ListStore> liststore_servers_;
 
@@ -91,6 +107,9 @@ protected:
 	goffset offset_errors_;
 
 	DICOM::Dataset* dataset_;
+	std::vector<std::string> filenames_;
+	std::tr1::shared_ptr<DICOM::BatchStore> batch_;
+	sigc::connection spool_connection_;
 };
 
 } // namespace UI
@@ -0,0 +1,344 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <memory>
+
+#include <glibmm/convert.h>
+#include <glibmm/i18n.h>
+
+// files from src directory begin
+#include "application.hpp"
+// files from src directory end
+
+#include "store_spool.hpp"
+#include "user_commands.hpp"
+#include "batch_store.hpp"
+
+namespace {
+
+const unsigned long retry_delay = 500000; // microseconds per attempt
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+BatchStore::Statistics::Statistics()
+	:
+	total(0),
+	stored(0),
+	failed(0),
+	retried(0),
+	spooled(0),
+	bytes(0),
+	seconds(0.)
+{
+}
+
+double
+BatchStore::Statistics::rate() const
+{
+	return (seconds > 0.) ? bytes / seconds : 0.;
+}
+
+BatchStore::BatchStore( unsigned int associations, unsigned int retries)
+	:
+	associations_(std::max( associations, 1u)),
+	retries_(retries),
+	running_(0),
+	cancel_(false),
+	spool_(false)
+{
+}
+
+BatchStore::~BatchStore()
+{
+	cancel();
+	wait();
+}
+
+void
+BatchStore::add_server(const Server& server)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (!running_)
+		servers_.push_back(server);
+}
+
+void
+BatchStore::add_file(const std::string& filename)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (!running_) {
+		Item item;
+		item.filename = filename;
+		items_.push_back(item);
+	}
+}
+
+void
+BatchStore::add_dataset(const DcmDataset& dataset)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (!running_) {
+		Item item;
+		item.dataset.reset(new Dataset(dataset));
+		items_.push_back(item);
+	}
+}
+
+void
+BatchStore::set_spool(bool spool)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	spool_ = spool;
+}
+
+bool
+BatchStore::start()
+{
+	wait(); // threads of a previous run
+
+	Glib::Mutex::Lock lock(mutex_);
+	if (running_ || servers_.empty() || items_.empty())
+		return false;
+
+	jobs_.assign( servers_.size(), std::deque<Job>());
+	for ( unsigned int s = 0; s < servers_.size(); ++s) {
+		for ( unsigned int i = 0; i < items_.size(); ++i) {
+			Job job = { i, s, 0 };
+			jobs_[s].push_back(job);
+		}
+	}
+
+	statistics_ = Statistics();
+	statistics_.total = items_.size() * servers_.size();
+	errors_.clear();
+	cancel_ = false;
+	timer_.start();
+
+	unsigned int workers = std::min( associations_,
+		static_cast<unsigned int>(items_.size()));
+	for ( unsigned int s = 0; s < servers_.size(); ++s) {
+		for ( unsigned int i = 0; i < workers; ++i) {
+			threads_.push_back(Glib::Thread::create( sigc::bind(
+				sigc::mem_fun( *this, &BatchStore::run_worker), s), true));
+			++running_;
+		}
+	}
+
+	OFLOG_DEBUG( app.log, "Batch store of " << statistics_.total
+		<< " datasets started by " << running_ << " workers");
+	return true;
+}
+
+void
+BatchStore::cancel()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	cancel_ = true;
+}
+
+void
+BatchStore::wait()
+{
+	std::vector<Glib::Thread*> threads;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		threads.swap(threads_);
+	}
+
+	for ( std::vector<Glib::Thread*>::iterator iter = threads.begin();
+		iter != threads.end(); ++iter)
+		(*iter)->join();
+}
+
+bool
+BatchStore::busy() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return running_ != 0;
+}
+
+BatchStore::Statistics
+BatchStore::statistics() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	Statistics statistics = statistics_;
+	if (running_)
+		statistics.seconds = timer_.elapsed();
+	return statistics;
+}
+
+std::vector<Glib::ustring>
+BatchStore::errors() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return errors_;
+}
+
+bool
+BatchStore::next_job( unsigned int server, Job& job)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (cancel_ || jobs_[server].empty())
+		return false;
+
+	job = jobs_[server].front();
+	jobs_[server].pop_front();
+	return true;
+}
+
+/**
+ * Queue the job again unless its retries are spent.
+ */
+bool
+BatchStore::retry_job(Job job)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (job.attempts >= retries_ || cancel_)
+		return false;
+
+	++job.attempts;
+	++statistics_.retried;
+	jobs_[job.server].push_back(job);
+	return true;
+}
+
+void
+BatchStore::job_failed( const Job& job, const Glib::ustring& error)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	++statistics_.failed;
+	errors_.push_back(Glib::ustring::compose( "%1 (%2): %3",
+		item_name(job.item), servers_[job.server].name, error));
+}
+
+/**
+ * The spool writes the dataset to disk, the batch is not locked
+ * meanwhile.
+ */
+bool
+BatchStore::spool_job( const Job& job, DcmDataset& dataset)
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		if (!spool_ || cancel_)
+			return false;
+	}
+
+	try {
+		StoreSpool::instance().enqueue( dataset, servers_[job.server],
+			StoreSpool::PRIORITY_ROUTINE);
+	}
+	catch (const Exception& ex) {
+		OFLOG_ERROR( app.log, "Unable to spool " << item_name(job.item)
+			<< ": " << ex.what());
+		return false;
+	}
+
+	Glib::Mutex::Lock lock(mutex_);
+	++statistics_.spooled;
+	return true;
+}
+
+Glib::ustring
+BatchStore::item_name(unsigned int item) const
+{
+	if (!items_[item].filename.empty())
+		return Glib::filename_display_basename(items_[item].filename);
+	return Glib::ustring::compose( _("dataset %1"), item + 1);
+}
+
+BatchStore::DatasetSharedPtr
+BatchStore::load(const std::string& filename) throw(Exception)
+{
+	DcmFileFormat file;
+	OFCondition cond = file.loadFile(filename.c_str());
+	if (cond.bad()) {
+		OFLOG_DEBUG( app.log, "Unable to load " << filename << ": "
+			<< cond.text());
+		throw Exception(_("Unable to load the file."));
+	}
+	return DatasetSharedPtr(new Dataset(*file.getDataset()));
+}
+
+void
+BatchStore::run_worker(unsigned int server)
+{
+	std::auto_ptr<StoreCommand> store;
+
+	Job job;
+	while (next_job( server, job)) {
+		DatasetSharedPtr dataset = items_[job.item].dataset;
+		try {
+			if (!dataset)
+				dataset = load(items_[job.item].filename);
+			else if (servers_.size() > 1)
+				// writing keeps its state in the dataset elements
+				dataset.reset(new Dataset(*dataset));
+		}
+		catch (const Exception& ex) {
+			job_failed( job, ex.what());
+			signal_progress_();
+			continue;
+		}
+
+		try {
+			if (!store.get())
+				store.reset(new StoreCommand(servers_[server]));
+			store->run( dataset.get(), 0);
+
+			unsigned long size = dataset->size();
+			Glib::Mutex::Lock lock(mutex_);
+			++statistics_.stored;
+			statistics_.bytes += size;
+		}
+		catch (const StoreRejected& ex) {
+			// a refusal status is not a store, nor does a retry change it
+			job_failed( job, ex.what());
+		}
+		catch (const Exception& ex) {
+			// the failed association is aborted, the next one is new
+			store.reset();
+			if (retry_job(job))
+				Glib::usleep(retry_delay * (job.attempts + 1));
+			else if (!spool_job( job, *dataset))
+				job_failed( job, ex.what());
+		}
+		signal_progress_();
+	}
+
+	// the association goes back to the pool
+	store.reset();
+
+	bool done = false;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		done = (--running_ == 0);
+		if (done)
+			statistics_.seconds = timer_.elapsed();
+	}
+	if (done)
+		signal_done_();
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
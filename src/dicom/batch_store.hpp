@@ -0,0 +1,140 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <tr1/memory>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/thread.h>
+#include <glibmm/timer.h>
+
+// files from src directory begin
+#include "dcmtk_defines.hpp"
+#include "exceptions.hpp"
+// files from src directory end
+
+#include "server.hpp"
+#include "utils.hpp"
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/**
+ * Store of many datasets to one or more servers.
+ *
+ * Every server gets its own workers, each worker keeps one association
+ * of the association pool and sends the datasets one by one, so up to
+ * the given number of datasets go to a server at the same time. Files
+ * are loaded by the workers. A failed dataset is queued again after a
+ * short delay until its retries are spent, the association it failed on
+ * is aborted and the worker opens a new one. A dataset refused by the
+ * server is not retried. With the spool set, datasets whose retries are
+ * spent go to the routine lane of the store spool.
+ */
+class BatchStore {
+public:
+	struct Statistics {
+		Statistics();
+		double rate() const; /**< bytes per second */
+
+		unsigned int total; // datasets times servers
+		unsigned int stored;
+		unsigned int failed;
+		unsigned int retried;
+		unsigned int spooled; // given to the store spool
+		unsigned long long bytes;
+		double seconds;
+	};
+
+	explicit BatchStore( unsigned int associations = 4,
+		unsigned int retries = 2);
+	virtual ~BatchStore();
+
+	void add_server(const Server& server);
+	void add_file(const std::string& filename);
+	void add_dataset(const DcmDataset& dataset); /**< copied */
+	/** Hand the datasets failed for good to the store spool. */
+	void set_spool(bool spool);
+
+	/** \brief Start the workers.
+	 *
+	 * \return false if there are no servers or datasets, or the store
+	 *         is already running.
+	 */
+	bool start();
+	void cancel(); /**< queued datasets are dropped */
+	void wait();
+	bool busy() const;
+
+	Statistics statistics() const;
+	std::vector<Glib::ustring> errors() const;
+
+	/** Emitted in the GUI thread after every stored or failed dataset. */
+	Glib::Dispatcher& signal_progress() { return signal_progress_; }
+	/** Emitted in the GUI thread when the last worker is done. */
+	Glib::Dispatcher& signal_done() { return signal_done_; }
+
+private:
+	typedef std::tr1::shared_ptr<Dataset> DatasetSharedPtr;
+
+	struct Item {
+		std::string filename; // empty for a dataset given in memory
+		DatasetSharedPtr dataset;
+	};
+
+	struct Job {
+		unsigned int item;
+		unsigned int server;
+		unsigned int attempts;
+	};
+
+	void run_worker(unsigned int server);
+	bool next_job( unsigned int server, Job& job);
+	bool retry_job(Job job);
+	void job_failed( const Job& job, const Glib::ustring& error);
+	bool spool_job( const Job& job, DcmDataset& dataset);
+	Glib::ustring item_name(unsigned int item) const;
+	static DatasetSharedPtr load(const std::string& filename)
+		throw(Exception);
+
+	std::vector<Server> servers_;
+	std::vector<Item> items_; // not changed while running
+	std::vector< std::deque<Job> > jobs_; // queue of every server
+	std::vector<Glib::Thread*> threads_;
+
+	unsigned int associations_; // workers per server
+	unsigned int retries_;
+	unsigned int running_;
+	bool cancel_;
+	bool spool_;
+
+	Statistics statistics_;
+	std::vector<Glib::ustring> errors_;
+	Glib::Timer timer_;
+	mutable Glib::Mutex mutex_;
+
+	Glib::Dispatcher signal_progress_;
+	Glib::Dispatcher signal_done_;
+};
+
+} // namespace DICOM
+
+} // namespace ScanAmati
@@ -0,0 +1,441 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <ctime>
+
+#include <pqxx/connection>
+#include <pqxx/cursor>
+#include <pqxx/transaction>
+
+#include <glibmm/i18n.h>
+
+// files from src directory begin
+#include "application.hpp"
+// files from src directory end
+
+#include "conquest_search.hpp"
+
+namespace {
+
+const char* const cursor_name = "conquest_search";
+
+const char* const query_head =
+	"SELECT p.patientid, t.studyid, t.studydate, p.patientnam, p.patientsex, "
+	"p.patientbir, t.studydescr, t.studytime, t.studyinsta "
+		"FROM dicompatients p, dicomstudies t, dicomseries s, dicomimages i "
+			"WHERE (p.patientid = t.patientid) "
+			"AND (t.studyinsta = s.studyinsta) "
+			"AND (s.seriesinst = i.seriesinst) ";
+
+const char* const query_tail = "ORDER BY p.patientid";
+
+// the counters are kept by the server, no table is read
+const char* const stamp_query =
+	"SELECT coalesce(sum(n_tup_ins), 0), coalesce(sum(n_tup_upd), 0), "
+	"coalesce(sum(n_tup_del), 0) "
+		"FROM pg_stat_user_tables "
+			"WHERE relname IN ('dicompatients', 'dicomstudies', "
+			"'dicomseries', 'dicomimages')";
+
+const unsigned int cache_max_entries = 64;
+const std::vector<ScanAmati::DICOM::ShortInfo>::size_type cache_max_rows =
+	20000;
+
+Glib::ustring
+trim(const Glib::ustring& str)
+{
+	Glib::ustring::size_type begin = str.find_first_not_of(" \t");
+	if (begin == Glib::ustring::npos)
+		return Glib::ustring();
+	Glib::ustring::size_type end = str.find_last_not_of(" \t");
+	return str.substr( begin, end - begin + 1);
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+bool
+ConquestCache::Stamp::operator==(const Stamp& other) const
+{
+	return (inserted == other.inserted && updated == other.updated &&
+		deleted == other.deleted);
+}
+
+ConquestCache&
+ConquestCache::instance()
+{
+	static ConquestCache cache;
+	return cache;
+}
+
+ConquestCache::ConquestCache()
+	:
+	max_age_(3600)
+{
+}
+
+void
+ConquestCache::set_max_age(unsigned int seconds)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	max_age_ = seconds;
+	if (!max_age_)
+		entries_.clear();
+}
+
+unsigned int
+ConquestCache::max_age() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return max_age_;
+}
+
+bool
+ConquestCache::find( const std::string& key, const Stamp& stamp,
+	std::vector<ShortInfo>& rows) const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	EntryMap::const_iterator it = entries_.find(key);
+	if (it == entries_.end())
+		return false;
+
+	const Entry& entry = it->second;
+	if (!(entry.stamp == stamp) ||
+		std::difftime( std::time(0), entry.time) > max_age_)
+		return false;
+
+	rows = entry.rows;
+	return true;
+}
+
+void
+ConquestCache::insert( const std::string& key, const Stamp& stamp,
+	const std::vector<ShortInfo>& rows)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (!max_age_ || rows.size() > cache_max_rows)
+		return;
+
+	time_t now = std::time(0);
+
+	// expired entries and then the oldest ones make room for the new one
+	for ( EntryMap::iterator it = entries_.begin(); it != entries_.end(); )
+		if (std::difftime( now, it->second.time) > max_age_)
+			entries_.erase(it++);
+		else
+			++it;
+
+	while (entries_.size() >= cache_max_entries) {
+		EntryMap::iterator oldest = entries_.begin();
+		for ( EntryMap::iterator it = entries_.begin(); it != entries_.end();
+			++it)
+			if (it->second.time < oldest->second.time)
+				oldest = it;
+		entries_.erase(oldest);
+	}
+
+	Entry& entry = entries_[key];
+	entry.stamp = stamp;
+	entry.time = now;
+	entry.rows = rows;
+}
+
+void
+ConquestCache::clear()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	entries_.clear();
+}
+
+ConquestSearch::ConquestSearch( const std::string& conninfo,
+	unsigned int page_size)
+	:
+	conninfo_(conninfo),
+	page_size_(std::max( page_size, 1U)),
+	conn_(0),
+	generation_(0),
+	pending_(false),
+	running_(false),
+	stop_(false),
+	thread_(0)
+{
+	signal_ready_.connect(sigc::mem_fun( *this, &ConquestSearch::on_page_ready));
+
+	thread_ = Glib::Thread::create( sigc::mem_fun( *this,
+		&ConquestSearch::run_worker), true);
+}
+
+ConquestSearch::~ConquestSearch()
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		stop_ = true;
+		cond_.signal();
+	}
+	thread_->join();
+}
+
+void
+ConquestSearch::search(const Criteria& criteria)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	criteria_ = criteria;
+	++generation_;
+	pending_ = true;
+	cond_.signal();
+}
+
+void
+ConquestSearch::cancel()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	++generation_;
+	pending_ = false;
+}
+
+bool
+ConquestSearch::busy() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return (pending_ || running_);
+}
+
+void
+ConquestSearch::run_worker()
+{
+	for (;;) {
+		Criteria criteria;
+		unsigned int generation;
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			while (!pending_ && !stop_)
+				cond_.wait(mutex_);
+			if (stop_)
+				break;
+
+			criteria = criteria_;
+			generation = generation_;
+			pending_ = false;
+			running_ = true;
+		}
+
+		Page last;
+		last.generation = generation;
+		last.finished = true;
+
+		if (!conn_) {
+			try {
+				conn_ = new pqxx::connection(conninfo_);
+			}
+			catch (const std::exception& err) {
+				OFLOG_ERROR( app.log, "ConQuest database: " << err.what());
+				last.error = _("Unable to establish a connection.");
+			}
+		}
+
+		if (conn_) {
+			try {
+				last.total = fetch( criteria, generation);
+			}
+			catch (const std::exception& err) {
+				OFLOG_ERROR( app.log, "ConQuest query: " << err.what());
+				last.error = _("The query has failed.");
+
+				// the next search reconnects
+				delete conn_;
+				conn_ = 0;
+			}
+		}
+
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			running_ = false;
+		}
+		push_page(last);
+	}
+
+	delete conn_;
+	conn_ = 0;
+}
+
+/**
+ * Superseded searches stop at the next page, the transaction is
+ * aborted and its cursor closed when they leave.
+ */
+unsigned int
+ConquestSearch::fetch( const Criteria& requested, unsigned int generation)
+{
+	const Criteria criteria = normalize(requested);
+
+	pqxx::work w( *conn_, cursor_name);
+
+	ConquestCache& cache = ConquestCache::instance();
+	const std::string key = cache_key(criteria);
+	const ConquestCache::Stamp stamp = read_stamp(w);
+
+	std::vector<ShortInfo> rows;
+	if (cache.find( key, stamp, rows)) {
+		push_rows( rows, generation);
+		return rows.size();
+	}
+
+	const std::string op = criteria.case_sensitive ? "~" : "~*";
+	std::string query = std::string(query_head)
+		+ "AND (p.patientnam " + op + " '"
+		+ w.esc(criteria.patient_name.raw()) + "') "
+		+ "AND (p.patientid " + op + " '"
+		+ w.esc(criteria.patient_id.raw()) + "') "
+		+ "AND (t.studyid " + op + " '"
+		+ w.esc(criteria.study_id.raw()) + "') "
+		+ query_tail;
+
+	pqxx::icursorstream cursor( w, query, cursor_name, page_size_);
+
+	unsigned int total = 0;
+	while (!superseded(generation)) {
+		pqxx::result r;
+		cursor.get(r);
+		if (r.empty())
+			break;
+
+		Page page;
+		page.generation = generation;
+		page.rows.reserve(r.size());
+		for ( pqxx::result::const_iterator it = r.begin(); it != r.end(); ++it)
+			page.rows.push_back(ShortInfo(it));
+
+		total += r.size();
+		rows.insert( rows.end(), page.rows.begin(), page.rows.end());
+		push_page(page);
+	}
+
+	// results of superseded searches are not complete
+	if (!superseded(generation))
+		cache.insert( key, stamp, rows);
+
+	return total;
+}
+
+ConquestCache::Stamp
+ConquestSearch::read_stamp(pqxx::transaction_base& w)
+{
+	ConquestCache::Stamp stamp;
+	pqxx::result r = w.exec(stamp_query);
+	if (r.empty())
+		return stamp;
+
+	r[0][0].to(stamp.inserted);
+	r[0][1].to(stamp.updated);
+	r[0][2].to(stamp.deleted);
+	return stamp;
+}
+
+void
+ConquestSearch::push_rows( const std::vector<ShortInfo>& rows,
+	unsigned int generation)
+{
+	for ( std::vector<ShortInfo>::size_type i = 0; i < rows.size();
+		i += page_size_) {
+		std::vector<ShortInfo>::size_type end =
+			std::min( rows.size(), i + page_size_);
+
+		Page page;
+		page.generation = generation;
+		page.rows.assign( rows.begin() + i, rows.begin() + end);
+		push_page(page);
+	}
+}
+
+/**
+ * Surrounding blanks are dropped, case insensitive expressions are
+ * lowercased too unless they have escapes, "\D" is not "\d". Equal
+ * searches get equal criteria and so one cache entry.
+ */
+ConquestSearch::Criteria
+ConquestSearch::normalize(const Criteria& criteria)
+{
+	Criteria res(criteria);
+	Glib::ustring* values[] = {
+		&res.patient_name,
+		&res.patient_id,
+		&res.study_id
+	};
+
+	for ( unsigned int i = 0; i < G_N_ELEMENTS(values); ++i) {
+		*values[i] = trim(*values[i]);
+		if (!res.case_sensitive &&
+			values[i]->find('\\') == Glib::ustring::npos)
+			*values[i] = values[i]->lowercase();
+	}
+	return res;
+}
+
+std::string
+ConquestSearch::cache_key(const Criteria& criteria) const
+{
+	return conninfo_ + (criteria.case_sensitive ? "\nS\n" : "\nI\n")
+		+ criteria.patient_name.raw() + '\n' + criteria.patient_id.raw()
+		+ '\n' + criteria.study_id.raw();
+}
+
+bool
+ConquestSearch::superseded(unsigned int generation) const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return (stop_ || generation != generation_);
+}
+
+void
+ConquestSearch::push_page(const Page& page)
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		pages_.push_back(page);
+	}
+	signal_ready_();
+}
+
+void
+ConquestSearch::on_page_ready()
+{
+	std::deque<Page> pages;
+	unsigned int generation;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		pages.swap(pages_);
+		generation = generation_;
+	}
+
+	// pages of superseded searches are dropped
+	for ( std::deque<Page>::const_iterator it = pages.begin();
+		it != pages.end(); ++it) {
+		if (it->generation != generation)
+			continue;
+		if (!it->rows.empty())
+			signal_page_(it->rows);
+		if (it->finished)
+			signal_finished_( it->total, it->error);
+	}
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
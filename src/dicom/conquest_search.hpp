@@ -0,0 +1,182 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <ctime>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/thread.h>
+
+#include "short_information.hpp"
+
+namespace pqxx {
+class connection;
+class transaction_base;
+} // namespace pqxx
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/**
+ * Results of the recent archive searches, shared by all the searches.
+ *
+ * A result is valid for max_age() seconds while the archive stamp it
+ * was read with stays the same. The stamp is read from the statistics
+ * counters of the server rather than from the tables, so it costs
+ * nothing however large the archive is, and a changed archive is
+ * searched again as soon as the server has counted the change.
+ */
+class ConquestCache {
+public:
+	/** Rows ever inserted, updated and deleted in the archive tables. */
+	struct Stamp {
+		Stamp() : inserted(0), updated(0), deleted(0) {}
+		bool operator==(const Stamp& other) const;
+
+		unsigned long inserted;
+		unsigned long updated;
+		unsigned long deleted;
+	};
+
+	static ConquestCache& instance();
+
+	void set_max_age(unsigned int seconds);
+	unsigned int max_age() const;
+
+	bool find( const std::string& key, const Stamp& stamp,
+		std::vector<ShortInfo>& rows) const;
+	void insert( const std::string& key, const Stamp& stamp,
+		const std::vector<ShortInfo>& rows);
+	void clear();
+
+private:
+	struct Entry {
+		Stamp stamp;
+		time_t time;
+		std::vector<ShortInfo> rows;
+	};
+
+	typedef std::map< std::string, Entry> EntryMap;
+
+	ConquestCache();
+
+	EntryMap entries_;
+	unsigned int max_age_;
+	mutable Glib::Mutex mutex_;
+};
+
+/**
+ * Studies query of the ConQuest archive database in a worker thread.
+ *
+ * The query is read through a server side cursor one page at a time,
+ * every page is handed to the GUI thread by signal_page() as soon as it
+ * is fetched. A new search() supersedes the running one, its remaining
+ * pages are neither fetched nor delivered. The connection is opened by
+ * the worker on the first search and kept for the next ones. Results
+ * of the ConquestCache are delivered the same way without the query.
+ */
+class ConquestSearch {
+public:
+	struct Criteria {
+		Criteria() : case_sensitive(false) {}
+
+		Glib::ustring patient_name; // regular expressions
+		Glib::ustring patient_id;
+		Glib::ustring study_id;
+		bool case_sensitive;
+	};
+
+	explicit ConquestSearch( const std::string& conninfo,
+		unsigned int page_size = 100);
+	virtual ~ConquestSearch();
+
+	void search(const Criteria& criteria);
+	void cancel();
+	bool busy() const;
+
+	/** Rows of the current search, emitted in the GUI thread. */
+	sigc::signal< void, const std::vector<ShortInfo>&> signal_page();
+	/** \brief Emitted in the GUI thread when the current search is done.
+	 *
+	 * Rows count and an error message, the latter is empty on success.
+	 */
+	sigc::signal< void, unsigned int, const Glib::ustring&> signal_finished();
+
+private:
+	struct Page {
+		Page() : generation(0), finished(false), total(0) {}
+
+		unsigned int generation;
+		std::vector<ShortInfo> rows;
+		bool finished;
+		unsigned int total;
+		Glib::ustring error;
+	};
+
+	void run_worker();
+	void on_page_ready();
+	unsigned int fetch( const Criteria& criteria, unsigned int generation);
+	static ConquestCache::Stamp read_stamp(pqxx::transaction_base& w);
+	void push_rows( const std::vector<ShortInfo>& rows, unsigned int generation);
+	bool superseded(unsigned int generation) const;
+	static Criteria normalize(const Criteria& criteria);
+	std::string cache_key(const Criteria& criteria) const;
+	void push_page(const Page& page);
+
+	std::string conninfo_;
+	unsigned int page_size_;
+	pqxx::connection* conn_; // used by the worker only
+
+	Criteria criteria_;
+	unsigned int generation_;
+	bool pending_;
+	bool running_;
+	bool stop_;
+	std::deque<Page> pages_;
+
+	Glib::Thread* thread_;
+	mutable Glib::Mutex mutex_;
+	Glib::Cond cond_;
+	Glib::Dispatcher signal_ready_;
+
+	sigc::signal< void, const std::vector<ShortInfo>&> signal_page_;
+	sigc::signal< void, unsigned int, const Glib::ustring&> signal_finished_;
+};
+
+inline
+sigc::signal< void, const std::vector<ShortInfo>&>
+ConquestSearch::signal_page()
+{
+	return signal_page_;
+}
+
+inline
+sigc::signal< void, unsigned int, const Glib::ustring&>
+ConquestSearch::signal_finished()
+{
+	return signal_finished_;
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
@@ -0,0 +1,136 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include <glib/gstdio.h>
+#include <glibmm/miscutils.h>
+
+// files from src directory begin
+#include "application.hpp"
+// files from src directory end
+
+#include "dataset_writer.hpp"
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+DatasetWriter::DatasetWriter( unsigned int threads, unsigned int max_queued)
+	:
+	threads_count_(std::max( threads, 1U)),
+	max_queued_(std::max( max_queued, 1U)),
+	running_(false)
+{
+}
+
+DatasetWriter::~DatasetWriter()
+{
+	finish();
+}
+
+void
+DatasetWriter::start()
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		if (running_)
+			return;
+		running_ = true;
+	}
+
+	for ( unsigned int i = 0; i < threads_count_; ++i)
+		threads_.push_back(Glib::Thread::create( sigc::mem_fun( *this,
+			&DatasetWriter::run_writer), true));
+}
+
+void
+DatasetWriter::finish()
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		running_ = false;
+		cond_.broadcast();
+	}
+
+	std::for_each( threads_.begin(), threads_.end(),
+		std::mem_fun(&Glib::Thread::join));
+	threads_.clear();
+}
+
+bool
+DatasetWriter::add( DcmFileFormat* fileformat, const std::string& filename,
+	const SlotWritten& slot)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	while (running_ && jobs_.size() >= max_queued_)
+		cond_.wait(mutex_);
+
+	if (!running_) {
+		delete fileformat;
+		return false;
+	}
+
+	Job job;
+	job.fileformat = fileformat;
+	job.filename = filename;
+	job.slot = slot;
+	jobs_.push_back(job);
+	cond_.broadcast();
+	return true;
+}
+
+void
+DatasetWriter::run_writer()
+{
+	for (;;) {
+		Job job;
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			while (jobs_.empty() && running_)
+				cond_.wait(mutex_);
+			if (jobs_.empty())
+				break;
+
+			job = jobs_.front();
+			jobs_.pop_front();
+
+			// add() may wait for the room
+			cond_.broadcast();
+		}
+
+		std::auto_ptr<DcmFileFormat> fileformat(job.fileformat);
+		g_mkdir_with_parents( Glib::path_get_dirname(job.filename).c_str(),
+			0755);
+
+		E_TransferSyntax xfer = fileformat->getDataset()->getOriginalXfer();
+		OFCondition cond = fileformat->saveFile( job.filename.c_str(), xfer,
+			EET_ExplicitLength, EGL_withGL, EPD_withoutPadding, 0, 0,
+			EWM_fileformat);
+		if (cond.bad())
+			OFLOG_DEBUG( app.log, "Cannot write DICOM file: " << job.filename);
+
+		if (job.slot)
+			job.slot( job.filename, cond.good());
+	}
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
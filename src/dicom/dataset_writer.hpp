@@ -0,0 +1,86 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <glibmm/thread.h>
+
+// files from src directory begin
+#include "dcmtk_defines.hpp"
+// files from src directory end
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/**
+ * Pool of threads writing received datasets to files.
+ *
+ * Receivers queue the datasets with add() and go on with the network,
+ * add() waits only while too many datasets are queued, so memory stays
+ * bounded on slow disks. Every dataset is reported by its own slot in
+ * the writer thread.
+ */
+class DatasetWriter {
+public:
+	/** Written file name and success, called in a writer thread. */
+	typedef sigc::slot< void, const std::string&, bool> SlotWritten;
+
+	explicit DatasetWriter( unsigned int threads = 2,
+		unsigned int max_queued = 16);
+	virtual ~DatasetWriter();
+
+	void start();
+	/** Write the queued datasets and stop the threads. */
+	void finish();
+
+	/** \brief Queue a dataset.
+	 *
+	 * \param fileformat The dataset, the writer owns it.
+	 * \param filename   Full file name, its directory is created.
+	 * \param slot       Called when the file is written or has failed.
+	 * \return false if the writer is not started, the dataset is deleted.
+	 */
+	bool add( DcmFileFormat* fileformat, const std::string& filename,
+		const SlotWritten& slot);
+
+private:
+	struct Job {
+		DcmFileFormat* fileformat;
+		std::string filename;
+		SlotWritten slot;
+	};
+
+	void run_writer();
+
+	unsigned int threads_count_;
+	unsigned int max_queued_;
+	std::deque<Job> jobs_;
+	bool running_;
+
+	std::vector<Glib::Thread*> threads_;
+	Glib::Mutex mutex_;
+	Glib::Cond cond_;
+};
+
+} // namespace DICOM
+
+} // namespace ScanAmati
@@ -0,0 +1,565 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <glibmm/convert.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+// files from src directory begin
+#include "dcmtk_defines.hpp"
+// files from src directory end
+
+#include "local_index.hpp"
+
+namespace {
+
+const char* const index_header = "scanamati-index\t1";
+const char* const raw_extension = "raw";
+
+// the pixel data and other long values are not read
+const Uint32 header_read_length = 256;
+
+const unsigned int max_depth = 32;
+const unsigned int update_interval = 256; // parsed files
+
+std::string
+escape(const std::string& str)
+{
+	std::string res;
+	res.reserve(str.size());
+	for ( std::string::const_iterator it = str.begin(); it != str.end(); ++it) {
+		switch (*it) {
+		case '\\':
+			res += "\\\\";
+			break;
+		case '\t':
+			res += "\\t";
+			break;
+		case '\n':
+			res += "\\n";
+			break;
+		default:
+			res += *it;
+			break;
+		}
+	}
+	return res;
+}
+
+std::string
+unescape(const std::string& str)
+{
+	std::string res;
+	res.reserve(str.size());
+	for ( std::string::size_type i = 0; i < str.size(); ++i) {
+		if (str[i] != '\\' || i + 1 == str.size()) {
+			res += str[i];
+			continue;
+		}
+		switch (str[++i]) {
+		case 't':
+			res += '\t';
+			break;
+		case 'n':
+			res += '\n';
+			break;
+		default:
+			res += str[i];
+			break;
+		}
+	}
+	return res;
+}
+
+std::vector<std::string>
+split_fields(const std::string& line)
+{
+	std::vector<std::string> fields;
+	std::string::size_type begin = 0;
+	for (;;) {
+		std::string::size_type end = line.find( '\t', begin);
+		fields.push_back(unescape(line.substr( begin, end - begin)));
+		if (end == std::string::npos)
+			break;
+		begin = end + 1;
+	}
+	return fields;
+}
+
+Glib::ustring
+tag_string( DcmDataset* dataset, const DcmTagKey& tag)
+{
+	const char* str = 0;
+	if (dataset->findAndGetString( tag, str).good() && str)
+		return Glib::ustring(str);
+	return Glib::ustring();
+}
+
+/**
+ * Bounds of a DICOM date range: "from-to", "from-", "-to" or a single
+ * date, an empty bound is open.
+ */
+void
+date_range( const Glib::ustring& range, std::string& from, std::string& to)
+{
+	std::string str = range.raw();
+	str.erase( std::remove( str.begin(), str.end(), ' '), str.end());
+
+	std::string::size_type dash = str.find('-');
+	if (dash == std::string::npos) {
+		from = to = str;
+	}
+	else {
+		from = str.substr( 0, dash);
+		to = str.substr(dash + 1);
+	}
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+LocalIndex::Record::Record()
+	:
+	kind(KIND_OTHER),
+	mtime(0),
+	size(0)
+{
+}
+
+LocalIndex&
+LocalIndex::instance()
+{
+	static LocalIndex index;
+	return index;
+}
+
+LocalIndex::LocalIndex()
+	:
+	rescan_interval_(0),
+	thread_(0),
+	stop_(false),
+	running_(false)
+{
+}
+
+LocalIndex::~LocalIndex()
+{
+	stop();
+}
+
+bool
+LocalIndex::load(const std::string& filename)
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		filename_ = filename;
+	}
+
+	std::string contents;
+	try {
+		contents = Glib::file_get_contents(filename);
+	}
+	catch (const Glib::FileError&) {
+		return false;
+	}
+
+	std::istringstream stream(contents);
+	std::string line;
+	if (!std::getline( stream, line) || line != index_header)
+		return false;
+
+	EntryMap entries;
+	while (std::getline( stream, line)) {
+		std::vector<std::string> fields = split_fields(line);
+		if (fields.size() != 12)
+			continue;
+
+		Entry entry;
+		Record& record = entry.record;
+		record.filename = fields[0];
+		record.kind = static_cast<Kind>(std::atoi(fields[1].c_str()));
+		record.mtime = std::strtol( fields[2].c_str(), 0, 10);
+		record.size = std::strtoul( fields[3].c_str(), 0, 10);
+		record.patient_name = fields[4];
+		record.patient_id = fields[5];
+		record.study_date = fields[6];
+		record.study_description = fields[7];
+		record.modality = fields[8];
+		record.study_uid = fields[9];
+		record.sop_class_uid = fields[10];
+		record.sop_instance_uid = fields[11];
+		make_key(entry);
+
+		entries[record.filename] = entry;
+	}
+
+	Glib::Mutex::Lock lock(mutex_);
+	entries_.swap(entries);
+	return true;
+}
+
+/** The index file is replaced atomically by g_file_set_contents(). */
+bool
+LocalIndex::save() const
+{
+	std::ostringstream stream;
+	std::string filename;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		filename = filename_;
+		if (filename.empty())
+			return false;
+
+		stream << index_header << '\n';
+		for ( EntryMap::const_iterator it = entries_.begin();
+			it != entries_.end(); ++it) {
+			const Record& r = it->second.record;
+			stream << escape(r.filename) << '\t' << r.kind << '\t'
+				<< r.mtime << '\t' << r.size << '\t'
+				<< escape(r.patient_name) << '\t' << escape(r.patient_id) << '\t'
+				<< escape(r.study_date) << '\t'
+				<< escape(r.study_description) << '\t'
+				<< escape(r.modality) << '\t' << escape(r.study_uid) << '\t'
+				<< escape(r.sop_class_uid) << '\t'
+				<< escape(r.sop_instance_uid) << '\n';
+		}
+	}
+
+	std::string data = stream.str();
+	g_mkdir_with_parents( Glib::path_get_dirname(filename).c_str(), 0755);
+	return g_file_set_contents( filename.c_str(), data.c_str(), data.size(), 0);
+}
+
+void
+LocalIndex::set_directories(const std::vector<std::string>& directories)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	directories_ = directories;
+}
+
+void
+LocalIndex::set_rescan_interval(unsigned int seconds)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	rescan_interval_ = seconds;
+}
+
+void
+LocalIndex::start()
+{
+	stop();
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		stop_ = false;
+		running_ = true;
+	}
+	thread_ = Glib::Thread::create( sigc::mem_fun( *this,
+		&LocalIndex::run_scanner), true);
+}
+
+void
+LocalIndex::stop()
+{
+	if (!thread_)
+		return;
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		stop_ = true;
+		cond_.broadcast();
+	}
+	thread_->join();
+	thread_ = 0;
+}
+
+bool
+LocalIndex::busy() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return running_;
+}
+
+unsigned int
+LocalIndex::search( const Query& query, std::vector<Record>& records) const
+{
+	std::string text = query.text.casefold().raw();
+	std::string modality = query.modality.uppercase().raw();
+	std::string from, to;
+	date_range( query.date, from, to);
+
+	std::vector<const Entry*> matches;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		for ( EntryMap::const_iterator it = entries_.begin();
+			it != entries_.end(); ++it) {
+			const Entry& entry = it->second;
+			const Record& record = entry.record;
+			if (record.kind == KIND_OTHER)
+				continue;
+			if (!text.empty() && entry.key.find(text) == std::string::npos)
+				continue;
+			if (!from.empty() && record.study_date.raw() < from)
+				continue;
+			if (!to.empty() && record.study_date.raw() > to)
+				continue;
+			if (!modality.empty() && record.modality.raw() != modality)
+				continue;
+			matches.push_back(&entry);
+		}
+
+		unsigned int n = std::min( static_cast<unsigned int>(matches.size()),
+			query.max_results);
+		std::partial_sort( matches.begin(), matches.begin() + n,
+			matches.end(), &LocalIndex::newer);
+
+		records.clear();
+		records.reserve(n);
+		for ( unsigned int i = 0; i < n; ++i)
+			records.push_back(matches[i]->record);
+	}
+
+	return matches.size();
+}
+
+void
+LocalIndex::add(const std::vector<std::string>& filenames)
+{
+	for ( std::vector<std::string>::const_iterator it = filenames.begin();
+		it != filenames.end(); ++it) {
+		struct stat buf;
+		if (g_lstat( it->c_str(), &buf) || !S_ISREG(buf.st_mode))
+			continue;
+
+		Entry entry;
+		entry.record.filename = *it;
+		entry.record.mtime = buf.st_mtime;
+		entry.record.size = buf.st_size;
+		read_record(entry.record);
+		make_key(entry);
+
+		Glib::Mutex::Lock lock(mutex_);
+		entries_[*it] = entry;
+	}
+	signal_updated_();
+}
+
+unsigned int
+LocalIndex::size() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return entries_.size();
+}
+
+void
+LocalIndex::run_scanner()
+{
+	for (;;) {
+		scan();
+
+		Glib::Mutex::Lock lock(mutex_);
+		if (stop_ || !rescan_interval_)
+			break;
+
+		Glib::TimeVal wake;
+		wake.assign_current_time();
+		wake.add_seconds(rescan_interval_);
+		while (!stop_ && cond_.timed_wait( mutex_, wake))
+			;
+		if (stop_)
+			break;
+		running_ = true;
+	}
+}
+
+void
+LocalIndex::scan()
+{
+	std::vector<std::string> directories;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		directories = directories_;
+	}
+
+	StampMap files;
+	for ( std::vector<std::string>::const_iterator it = directories.begin();
+		it != directories.end(); ++it)
+		walk( *it, files, 0);
+
+	// vanished files are dropped, new and changed ones are parsed
+	std::vector<Record> changed;
+	bool vanished = false;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		if (stop_) {
+			running_ = false;
+			return;
+		}
+
+		for ( EntryMap::iterator it = entries_.begin(); it != entries_.end(); )
+			if (files.find(it->first) == files.end()) {
+				entries_.erase(it++);
+				vanished = true;
+			}
+			else
+				++it;
+
+		for ( StampMap::const_iterator it = files.begin(); it != files.end();
+			++it) {
+			EntryMap::const_iterator entry = entries_.find(it->first);
+			if (entry != entries_.end() &&
+				entry->second.record.mtime == it->second.first &&
+				entry->second.record.size == it->second.second)
+				continue;
+
+			Record record;
+			record.filename = it->first;
+			record.mtime = it->second.first;
+			record.size = it->second.second;
+			changed.push_back(record);
+		}
+	}
+
+	for ( unsigned int i = 0; i < changed.size(); ++i) {
+		Entry entry;
+		entry.record = changed[i];
+		read_record(entry.record);
+		make_key(entry);
+
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			entries_[entry.record.filename] = entry;
+			if (stop_)
+				break;
+		}
+		if ((i + 1) % update_interval == 0)
+			signal_updated_();
+	}
+
+	// an unchanged index is not written again on every rescan
+	if (vanished || !changed.empty())
+		save();
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		running_ = false;
+	}
+	signal_updated_();
+}
+
+void
+LocalIndex::walk( const std::string& directory, StampMap& files,
+	unsigned int depth)
+{
+	if (depth > max_depth)
+		return;
+
+	std::vector<std::string> names;
+	try {
+		Glib::Dir dir(directory);
+		names.assign( dir.begin(), dir.end());
+	}
+	catch (const Glib::FileError&) {
+		return;
+	}
+
+	for ( std::vector<std::string>::const_iterator it = names.begin();
+		it != names.end(); ++it) {
+		if (it->empty() || (*it)[0] == '.')
+			continue;
+
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			if (stop_)
+				return;
+		}
+
+		std::string path = Glib::build_filename( directory, *it);
+
+		// links are not followed, they could loop
+		struct stat buf;
+		if (g_lstat( path.c_str(), &buf))
+			continue;
+
+		if (S_ISDIR(buf.st_mode))
+			walk( path, files, depth + 1);
+		else if (S_ISREG(buf.st_mode))
+			files[path] = std::make_pair( buf.st_mtime,
+				static_cast<unsigned long>(buf.st_size));
+	}
+}
+
+void
+LocalIndex::read_record(Record& record)
+{
+	std::string::size_type dot = record.filename.rfind('.');
+	if (dot != std::string::npos && !g_ascii_strcasecmp(
+		record.filename.c_str() + dot + 1, raw_extension)) {
+		record.kind = KIND_RAW;
+		return;
+	}
+
+	DcmFileFormat fileformat;
+	OFCondition cond = fileformat.loadFile( record.filename.c_str(),
+		EXS_Unknown, EGL_noChange, header_read_length);
+	DcmDataset* dataset = fileformat.getDataset();
+	if (cond.bad() || !dataset) {
+		record.kind = KIND_OTHER;
+		return;
+	}
+
+	record.kind = KIND_DICOM;
+	record.patient_name = tag_string( dataset, DCM_PatientName);
+	record.patient_id = tag_string( dataset, DCM_PatientID);
+	record.study_date = tag_string( dataset, DCM_StudyDate);
+	record.study_description = tag_string( dataset, DCM_StudyDescription);
+	record.modality = tag_string( dataset, DCM_Modality);
+	record.study_uid = tag_string( dataset, DCM_StudyInstanceUID);
+	record.sop_class_uid = tag_string( dataset, DCM_SOPClassUID);
+	record.sop_instance_uid = tag_string( dataset, DCM_SOPInstanceUID);
+}
+
+void
+LocalIndex::make_key(Entry& entry)
+{
+	const Record& record = entry.record;
+	Glib::ustring key = record.patient_name + '\n' + record.patient_id + '\n'
+		+ record.study_description + '\n'
+		+ Glib::filename_display_basename(record.filename);
+	entry.key = key.casefold().raw();
+}
+
+bool
+LocalIndex::newer( const Entry* a, const Entry* b)
+{
+	if (a->record.study_date != b->record.study_date)
+		return a->record.study_date > b->record.study_date;
+	return a->record.filename < b->record.filename;
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
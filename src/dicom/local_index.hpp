@@ -0,0 +1,142 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/thread.h>
+#include <glibmm/ustring.h>
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/**
+ * Index of the DICOM and raw files of local directories.
+ *
+ * A background thread walks the directories and parses the headers of
+ * new and changed files only, unchanged files are recognized by their
+ * modification time and size. The key tags are kept in memory for
+ * search() and in an index file between the runs. Files which are
+ * neither DICOM nor raw are remembered too, so they are not parsed
+ * again. The directories are walked again every rescan interval, only
+ * the files are stat'ed then, so files copied in by other programs are
+ * found while the program runs.
+ */
+class LocalIndex {
+public:
+	enum Kind {
+		KIND_OTHER,
+		KIND_DICOM,
+		KIND_RAW
+	};
+
+	struct Record {
+		Record();
+
+		std::string filename;
+		Kind kind;
+		time_t mtime;
+		unsigned long size;
+		Glib::ustring patient_name;
+		Glib::ustring patient_id;
+		Glib::ustring study_date; // YYYYMMDD
+		Glib::ustring study_description;
+		Glib::ustring modality;
+		Glib::ustring study_uid;
+		Glib::ustring sop_class_uid;
+		Glib::ustring sop_instance_uid;
+	};
+
+	struct Query {
+		Query() : max_results(500) {}
+
+		Glib::ustring text; // part of patient, id, description or file name
+		Glib::ustring date; // DICOM date range, "20110101-20110131"
+		Glib::ustring modality;
+		unsigned int max_results;
+	};
+
+	static LocalIndex& instance();
+
+	/** Read the index file, its records are valid until the next scan. */
+	bool load(const std::string& filename);
+	bool save() const;
+
+	void set_directories(const std::vector<std::string>& directories);
+	/** Seconds between the scans, 0 scans once after start(). */
+	void set_rescan_interval(unsigned int seconds);
+	void start(); /**< scan the directories in the background */
+	void stop();
+	bool busy() const;
+
+	/** \brief Find the records, newest studies first.
+	 *
+	 * \return number of all the matching records, only max_results of
+	 *         them are returned.
+	 */
+	unsigned int search( const Query& query,
+		std::vector<Record>& records) const;
+	/** Index the files at once, e.g. the just received ones. */
+	void add(const std::vector<std::string>& filenames);
+	unsigned int size() const;
+
+	/** Emitted in the GUI thread while and after scanning. */
+	Glib::Dispatcher& signal_updated() { return signal_updated_; }
+
+private:
+	struct Entry {
+		Record record;
+		std::string key; // casefolded text searched for
+	};
+
+	typedef std::map< std::string, Entry> EntryMap;
+	typedef std::map< std::string, std::pair< time_t, unsigned long> >
+		StampMap;
+
+	LocalIndex();
+	~LocalIndex();
+
+	void run_scanner();
+	void scan();
+	void walk( const std::string& directory, StampMap& files,
+		unsigned int depth);
+	static void read_record(Record& record);
+	static void make_key(Entry& entry);
+	static bool newer( const Entry* a, const Entry* b);
+
+	EntryMap entries_;
+	std::vector<std::string> directories_;
+	std::string filename_;
+	unsigned int rescan_interval_;
+
+	Glib::Thread* thread_;
+	bool stop_;
+	bool running_;
+	mutable Glib::Mutex mutex_;
+	Glib::Cond cond_;
+	Glib::Dispatcher signal_updated_;
+};
+
+} // namespace DICOM
+
+} // namespace ScanAmati
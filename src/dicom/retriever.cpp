@@ -0,0 +1,243 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/i18n.h>
+#include <glibmm/miscutils.h>
+
+// files from src directory begin
+#include "application.hpp"
+// files from src directory end
+
+#include "retriever.hpp"
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+Retriever::Progress::Progress()
+	:
+	received(0),
+	written(0),
+	failed(0),
+	remaining(0),
+	completed(0),
+	failed_suboperations(0),
+	bytes(0),
+	total_bytes(0)
+{
+}
+
+Retriever::Retriever(unsigned int writers)
+	:
+	writer_(writers),
+	running_(false),
+	cancel_(false),
+	notified_(false),
+	thread_(0)
+{
+}
+
+Retriever::~Retriever()
+{
+	wait();
+}
+
+bool
+Retriever::start( const Server& server, const DcmDataset& query,
+	const std::string& directory)
+{
+	if (busy())
+		return false;
+
+	wait();
+
+	if (g_mkdir_with_parents( directory.c_str(), 0755) ||
+		!Glib::file_test( directory, Glib::FILE_TEST_IS_DIR)) {
+		Glib::Mutex::Lock lock(mutex_);
+		error_ = Glib::ustring::compose(
+			_("Unable to create directory \"%1\"."),
+			Glib::filename_display_name(directory));
+		return false;
+	}
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		server_ = server;
+		query_.reset(new DcmDataset(query));
+		directory_ = directory;
+		filenames_.clear();
+		progress_ = Progress();
+		error_.clear();
+		running_ = true;
+		cancel_ = false;
+		notified_ = false;
+	}
+
+	writer_.start();
+	thread_ = Glib::Thread::create( sigc::mem_fun( *this,
+		&Retriever::run_move), true);
+
+	return true;
+}
+
+void
+Retriever::wait()
+{
+	if (thread_) {
+		thread_->join();
+		thread_ = 0;
+	}
+}
+
+void
+Retriever::cancel()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	cancel_ = true;
+}
+
+bool
+Retriever::busy() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return running_;
+}
+
+Retriever::Progress
+Retriever::progress() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	notified_ = false;
+	return progress_;
+}
+
+std::vector<std::string>
+Retriever::filenames() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return filenames_;
+}
+
+Glib::ustring
+Retriever::error() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return error_;
+}
+
+void
+Retriever::run_move()
+{
+	Glib::ustring error;
+	try {
+		MoveCommand command(server_);
+		if (!command.run( *query_, this))
+			error = _("Move request failed.");
+	}
+	catch (const Exception& ex) {
+		error = ex.what();
+	}
+
+	// the received datasets are written before the end is signalled
+	writer_.finish();
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		error_ = cancel_ ? Glib::ustring(_("Retrieve has been cancelled."))
+			: error;
+		running_ = false;
+	}
+	signal_done_();
+}
+
+void
+Retriever::on_written( const std::string& filename, bool written)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (written) {
+		filenames_.push_back(filename);
+		++progress_.written;
+	}
+	else
+		++progress_.failed;
+	notify();
+}
+
+void
+Retriever::notify()
+{
+	// the GUI reads the progress before it is signalled again
+	if (notified_)
+		return;
+
+	notified_ = true;
+	signal_progress_();
+}
+
+bool
+Retriever::accepting()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return !cancel_;
+}
+
+bool
+Retriever::cancelled()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return cancel_;
+}
+
+void
+Retriever::receiving( unsigned long bytes, unsigned long total)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	progress_.bytes = bytes;
+	progress_.total_bytes = total;
+	notify();
+}
+
+void
+Retriever::received( DcmFileFormat* fileformat, const std::string& name)
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		++progress_.received;
+		notify();
+	}
+
+	// waits while the writers are behind
+	writer_.add( fileformat, Glib::build_filename( directory_, name),
+		sigc::mem_fun( *this, &Retriever::on_written));
+}
+
+void
+Retriever::moved( unsigned int remaining, unsigned int completed,
+	unsigned int failed, unsigned int)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	progress_.remaining = remaining;
+	progress_.completed = completed;
+	progress_.failed_suboperations = failed;
+	notify();
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
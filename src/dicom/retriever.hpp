@@ -0,0 +1,119 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/thread.h>
+
+// files from src directory begin
+#include "dcmtk_defines.hpp"
+// files from src directory end
+
+#include "dataset_writer.hpp"
+#include "server.hpp"
+#include "user_commands.hpp"
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/**
+ * C-MOVE retrieve of a query in the background.
+ *
+ * The move runs in its own thread and only receives the datasets of the
+ * store sub-operations, a DatasetWriter saves them into the destination
+ * directory. Progress and the end of the retrieve are signalled in the
+ * GUI thread. A cancelled retrieve refuses the datasets still coming and
+ * asks the server to stop the move at its next response.
+ */
+class Retriever : private StoreReceiver {
+public:
+	struct Progress {
+		Progress();
+
+		unsigned int received; // datasets
+		unsigned int written;
+		unsigned int failed; // not written
+		unsigned int remaining; // sub-operations of the server
+		unsigned int completed;
+		unsigned int failed_suboperations;
+		unsigned long bytes; // of the dataset being received
+		unsigned long total_bytes;
+	};
+
+	explicit Retriever(unsigned int writers = 2);
+	virtual ~Retriever();
+
+	/** \brief Start the retrieve.
+	 *
+	 * \return false if the destination directory cannot be created or
+	 *         the retriever is busy.
+	 */
+	bool start( const Server& server, const DcmDataset& query,
+		const std::string& directory);
+	void wait();
+	void cancel(); /**< wait() or signal_done() tell when it is over */
+	bool busy() const;
+
+	Progress progress() const;
+	std::vector<std::string> filenames() const; /**< written files */
+	Glib::ustring error() const; /**< empty if the move succeeded */
+
+	/** Emitted in the GUI thread while datasets come and are written. */
+	Glib::Dispatcher& signal_progress() { return signal_progress_; }
+	/** Emitted in the GUI thread when the move and the writers are done. */
+	Glib::Dispatcher& signal_done() { return signal_done_; }
+
+private:
+	// StoreReceiver
+	virtual bool accepting();
+	virtual bool cancelled();
+	virtual void receiving( unsigned long bytes, unsigned long total);
+	virtual void received( DcmFileFormat* fileformat, const std::string& name);
+	virtual void moved( unsigned int remaining, unsigned int completed,
+		unsigned int failed, unsigned int warning);
+
+	void run_move();
+	void on_written( const std::string& filename, bool written);
+	void notify(); // with the mutex locked
+
+	DatasetWriter writer_;
+	Server server_;
+	std::auto_ptr<DcmDataset> query_;
+	std::string directory_;
+
+	std::vector<std::string> filenames_;
+	Progress progress_;
+	Glib::ustring error_;
+	bool running_;
+	bool cancel_;
+	mutable bool notified_; // reset by progress()
+
+	Glib::Thread* thread_;
+	mutable Glib::Mutex mutex_;
+	Glib::Dispatcher signal_progress_;
+	Glib::Dispatcher signal_done_;
+};
+
+} // namespace DICOM
+
+} // namespace ScanAmati
@@ -0,0 +1,464 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+#include <glib/gstdio.h>
+#include <glibmm/miscutils.h>
+
+#include <config.h>
+
+// files from src directory begin
+#include "application.hpp"
+// files from src directory end
+
+#include "local_index.hpp"
+#include "user_commands.hpp"
+#include "storage_server.hpp"
+
+namespace {
+
+const int network_timeout = 30; // seconds
+const int poll_timeout = 1; // seconds, the stop request is checked
+const unsigned int idle_limit = 60; // polls without a command
+
+// lossless syntaxes first, the datasets are saved as they come
+const char* transfer_syntaxes[] = {
+#ifdef HAVE_DCMTK_CODECS
+	UID_JPEGLSLosslessTransferSyntax,
+#endif
+	UID_RLELosslessTransferSyntax,
+#ifdef HAVE_DCMTK_CODECS
+	UID_JPEGProcess14SV1TransferSyntax,
+#endif
+	UID_LittleEndianExplicitTransferSyntax,
+	UID_BigEndianExplicitTransferSyntax,
+	UID_LittleEndianImplicitTransferSyntax
+};
+
+std::string
+study_directory(DcmDataset* dataset)
+{
+	const char* uid = 0;
+	if (dataset && dataset->findAndGetString( DCM_StudyInstanceUID, uid).good()
+		&& uid && *uid) {
+		std::string str(uid);
+		if (str.find_first_not_of("0123456789.") == std::string::npos)
+			return str;
+	}
+	return std::string("unknown");
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/** Datasets and studies of one association. */
+class StorageServer::Session : public StoreReceiver {
+public:
+	Session( StorageServer& server, const std::string& title)
+		:
+		calling_title(title),
+		pending(0),
+		server_(server)
+	{
+	}
+
+	virtual void received( DcmFileFormat* fileformat, const std::string& name)
+	{
+		server_.store( this, fileformat, name);
+	}
+
+	std::string calling_title;
+	std::map< std::string, Study> studies;
+	unsigned int pending; // datasets being written
+
+private:
+	StorageServer& server_;
+};
+
+StorageServer&
+StorageServer::instance()
+{
+	static StorageServer server;
+	return server;
+}
+
+StorageServer::StorageServer()
+	:
+	network_(0),
+	associations_(4),
+	serving_(0),
+	received_(0),
+	stop_(false)
+{
+}
+
+StorageServer::~StorageServer()
+{
+	stop();
+}
+
+bool
+StorageServer::start( unsigned int port, const std::string& directory,
+	unsigned int associations)
+{
+	if (network_)
+		return false;
+
+	if (!dcmDataDict.isDictionaryLoaded())
+		OFLOG_WARN( app.log, "No data dictionary loaded, check environment "
+			"variable: " << DCM_DICT_ENVIRONMENT_VARIABLE);
+
+	OFCondition cond = ASC_initializeNetwork( NET_ACCEPTOR, port,
+		network_timeout, &network_);
+	if (cond.bad()) {
+		OFString temp_str;
+		OFLOG_ERROR( app.log, "Cannot listen on port " << port << ": "
+			<< DimseCondition::dump( temp_str, cond));
+		network_ = 0;
+		return false;
+	}
+
+	g_mkdir_with_parents( directory.c_str(), 0755);
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		directory_ = directory;
+		associations_ = std::max( associations, 1U);
+		received_ = 0;
+		stop_ = false;
+	}
+
+	writer_.start();
+
+	threads_.push_back(Glib::Thread::create( sigc::mem_fun( *this,
+		&StorageServer::run_listener), true));
+	for ( unsigned int i = 0; i < associations_; ++i)
+		threads_.push_back(Glib::Thread::create( sigc::mem_fun( *this,
+			&StorageServer::run_worker), true));
+
+	return true;
+}
+
+void
+StorageServer::stop()
+{
+	if (!network_)
+		return;
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		stop_ = true;
+		cond_.broadcast();
+	}
+
+	std::for_each( threads_.begin(), threads_.end(),
+		std::mem_fun(&Glib::Thread::join));
+	threads_.clear();
+
+	// accepted associations nobody has served
+	for ( std::deque<T_ASC_Association*>::iterator it = pending_.begin();
+		it != pending_.end(); ++it) {
+		ASC_abortAssociation(*it);
+		ASC_dropSCPAssociation(*it);
+		ASC_destroyAssociation(&*it);
+	}
+	pending_.clear();
+
+	writer_.finish();
+
+	ASC_dropNetwork(&network_);
+	network_ = 0;
+}
+
+bool
+StorageServer::running() const
+{
+	return (network_ != 0);
+}
+
+void
+StorageServer::set_calling_titles(const std::vector<std::string>& titles)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	calling_titles_ = titles;
+}
+
+std::vector<StorageServer::Study>
+StorageServer::take_studies()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	std::vector<Study> studies;
+	studies.swap(studies_);
+	return studies;
+}
+
+unsigned int
+StorageServer::received() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return received_;
+}
+
+void
+StorageServer::run_listener()
+{
+	for (;;) {
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			if (stop_)
+				break;
+		}
+
+		T_ASC_Association* assoc = 0;
+		OFCondition cond = ASC_receiveAssociation( network_, &assoc,
+			ASC_DEFAULTMAXPDU, NULL, NULL, OFFalse, DUL_NOBLOCK, poll_timeout);
+		if (cond.bad()) {
+			if (cond != DUL_NOASSOCIATIONREQUEST) {
+				OFString temp_str;
+				OFLOG_DEBUG( app.log, "Receiving association failed: "
+					<< DimseCondition::dump( temp_str, cond));
+			}
+			if (assoc) {
+				ASC_dropAssociation(assoc);
+				ASC_destroyAssociation(&assoc);
+			}
+			continue;
+		}
+
+		// the associations waiting for a worker are limited too
+		bool busy;
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			busy = (serving_ + pending_.size() >= 2 * associations_);
+		}
+
+		if (busy) {
+			OFLOG_DEBUG( app.log, "Too many associations, rejected");
+			T_ASC_RejectParameters rej = {
+				ASC_RESULT_REJECTEDTRANSIENT,
+				ASC_SOURCE_SERVICEPROVIDER_PRESENTATION_RELATED,
+				ASC_REASON_SP_PRES_LOCALLIMITEXCEEDED
+			};
+			ASC_rejectAssociation( assoc, &rej);
+			cond = EC_IllegalCall;
+		}
+		else
+			cond = negotiate(assoc);
+
+		if (cond.bad()) {
+			ASC_dropAssociation(assoc);
+			ASC_destroyAssociation(&assoc);
+			continue;
+		}
+
+		Glib::Mutex::Lock lock(mutex_);
+		pending_.push_back(assoc);
+		cond_.broadcast();
+	}
+}
+
+void
+StorageServer::run_worker()
+{
+	for (;;) {
+		T_ASC_Association* assoc;
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			while (pending_.empty() && !stop_)
+				cond_.wait(mutex_);
+			if (stop_)
+				break;
+
+			assoc = pending_.front();
+			pending_.pop_front();
+			++serving_;
+		}
+
+		serve(assoc);
+
+		Glib::Mutex::Lock lock(mutex_);
+		--serving_;
+	}
+}
+
+void
+StorageServer::serve(T_ASC_Association* assoc)
+{
+	Session session( *this, assoc->params->DULparams.callingAPTitle);
+	OFLOG_DEBUG( app.log, "Association from " << session.calling_title);
+
+	unsigned int idle = 0;
+	for (;;) {
+		bool stop;
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			stop = stop_;
+		}
+		if (stop) {
+			ASC_abortAssociation(assoc);
+			break;
+		}
+
+		T_DIMSE_Message msg;
+		T_ASC_PresentationContextID presID;
+		OFCondition cond = DIMSE_receiveCommand( assoc, DIMSE_NONBLOCKING,
+			poll_timeout, &presID, &msg, NULL);
+
+		if (cond == DIMSE_NODATAAVAILABLE) {
+			if (++idle > idle_limit) {
+				OFLOG_DEBUG( app.log, "Idle association aborted");
+				ASC_abortAssociation(assoc);
+				break;
+			}
+			continue;
+		}
+		idle = 0;
+
+		if (cond == EC_Normal)
+			cond = serve_command( assoc, &msg, presID, &session);
+
+		if (cond == DUL_PEERREQUESTEDRELEASE) {
+			ASC_acknowledgeRelease(assoc);
+			break;
+		}
+		if (cond == DUL_PEERABORTEDASSOCIATION)
+			break;
+		if (cond.bad()) {
+			OFString temp_str;
+			OFLOG_DEBUG( app.log, "DIMSE failure (aborting association): "
+				<< DimseCondition::dump( temp_str, cond));
+			ASC_abortAssociation(assoc);
+			break;
+		}
+	}
+
+	ASC_dropSCPAssociation(assoc);
+	ASC_destroyAssociation(&assoc);
+
+	// the studies of the association are complete when written
+	std::vector<std::string> filenames;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		while (session.pending)
+			cond_.wait(mutex_);
+
+		for ( std::map< std::string, Study>::const_iterator it =
+			session.studies.begin(); it != session.studies.end(); ++it) {
+			studies_.push_back(it->second);
+			filenames.insert( filenames.end(), it->second.filenames.begin(),
+				it->second.filenames.end());
+		}
+	}
+
+	if (!filenames.empty()) {
+		LocalIndex::instance().add(filenames);
+		signal_received_();
+	}
+}
+
+void
+StorageServer::store( Session* session, DcmFileFormat* fileformat,
+	const std::string& name)
+{
+	std::string study_uid = study_directory(fileformat->getDataset());
+	std::string filename = Glib::build_filename( directory_, study_uid, name);
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		++session->pending;
+	}
+
+	// waits while the writers are behind
+	if (!writer_.add( fileformat, filename, sigc::bind( sigc::mem_fun( *this,
+		&StorageServer::on_written), session, study_uid))) {
+		Glib::Mutex::Lock lock(mutex_);
+		--session->pending;
+		cond_.broadcast();
+	}
+}
+
+void
+StorageServer::on_written( const std::string& filename, bool written,
+	Session* session, std::string study_uid)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	if (written) {
+		Study& study = session->studies[study_uid];
+		study.study_uid = study_uid;
+		study.calling_title = session->calling_title;
+		study.filenames.push_back(filename);
+		++received_;
+	}
+	--session->pending;
+	cond_.broadcast();
+}
+
+OFCondition
+StorageServer::negotiate(T_ASC_Association* assoc)
+{
+	const std::string called(assoc->params->DULparams.calledAPTitle);
+	const std::string calling(assoc->params->DULparams.callingAPTitle);
+
+	T_ASC_RejectParameters rej = {
+		ASC_RESULT_REJECTEDPERMANENT,
+		ASC_SOURCE_SERVICEUSER,
+		ASC_REASON_SU_NOREASON
+	};
+	if (called != app.ae_title)
+		rej.reason = ASC_REASON_SU_CALLEDAETITLENOTRECOGNIZED;
+	else {
+		Glib::Mutex::Lock lock(mutex_);
+		if (!calling_titles_.empty() && std::find( calling_titles_.begin(),
+			calling_titles_.end(), calling) == calling_titles_.end())
+			rej.reason = ASC_REASON_SU_CALLINGAETITLENOTRECOGNIZED;
+	}
+
+	if (rej.reason != ASC_REASON_SU_NOREASON) {
+		OFLOG_DEBUG( app.log, "Association from " << calling << " to "
+			<< called << " rejected");
+		ASC_rejectAssociation( assoc, &rej);
+		return EC_IllegalCall;
+	}
+
+	const char* known_syntaxes[] = { UID_VerificationSOPClass };
+
+	OFCondition cond = ASC_acceptContextsWithPreferredTransferSyntaxes(
+		assoc->params, known_syntaxes, DIM_OF(known_syntaxes),
+		transfer_syntaxes, DIM_OF(transfer_syntaxes));
+
+	// the array of Storage SOP Class UIDs comes from dcuid.h
+	if (cond.good())
+		cond = ASC_acceptContextsWithPreferredTransferSyntaxes(
+			assoc->params, dcmAllStorageSOPClassUIDs,
+			numberOfAllDcmStorageSOPClassUIDs,
+			transfer_syntaxes, DIM_OF(transfer_syntaxes));
+
+	if (cond.good())
+		cond = ASC_acknowledgeAssociation(assoc);
+
+	return cond;
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
@@ -0,0 +1,118 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/thread.h>
+
+// files from src directory begin
+#include "dcmtk_defines.hpp"
+// files from src directory end
+
+#include "dataset_writer.hpp"
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/**
+ * Storage SCP receiving the datasets pushed by other stations.
+ *
+ * A listener thread accepts the associations and hands them to a pool
+ * of threads, each serves one association at a time, so several
+ * stations may send at once. The received datasets are saved by a
+ * DatasetWriter into a directory of their study. When an association
+ * ends and its files are written, its studies are complete, they are
+ * added to the LocalIndex and announced by signal_received().
+ *
+ * Only associations called with the AE title of the application are
+ * accepted, and only from the calling AE titles set, if any are.
+ */
+class StorageServer {
+public:
+	struct Study {
+		std::string study_uid;
+		std::string calling_title; // of the sending station
+		std::vector<std::string> filenames;
+	};
+
+	static StorageServer& instance();
+
+	/** \brief Start listening.
+	 *
+	 * \param port         TCP port of the associations.
+	 * \param directory    Directory of the study directories.
+	 * \param associations Number of associations served at once.
+	 * \return false if the network cannot be initialized.
+	 */
+	bool start( unsigned int port, const std::string& directory,
+		unsigned int associations = 4);
+	void stop(); /**< associations in progress are aborted */
+	bool running() const;
+
+	/** Stations allowed to send, an empty list allows any. */
+	void set_calling_titles(const std::vector<std::string>& titles);
+
+	/** Studies completed since the last call. */
+	std::vector<Study> take_studies();
+	unsigned int received() const; /**< datasets written since start */
+
+	/** Emitted in the GUI thread when studies have been completed. */
+	Glib::Dispatcher& signal_received() { return signal_received_; }
+
+private:
+	class Session;
+	friend class Session;
+
+	StorageServer();
+	~StorageServer();
+
+	void run_listener();
+	void run_worker();
+	void serve(T_ASC_Association* assoc);
+	void store( Session* session, DcmFileFormat* fileformat,
+		const std::string& name);
+	void on_written( const std::string& filename, bool written,
+		Session* session, std::string study_uid);
+	OFCondition negotiate(T_ASC_Association* assoc);
+
+	T_ASC_Network* network_;
+	std::string directory_;
+	unsigned int associations_;
+	std::vector<std::string> calling_titles_;
+	DatasetWriter writer_;
+
+	std::deque<T_ASC_Association*> pending_; // accepted, not served
+	unsigned int serving_;
+	std::vector<Study> studies_;
+	unsigned int received_;
+	bool stop_;
+
+	std::vector<Glib::Thread*> threads_;
+	mutable Glib::Mutex mutex_;
+	Glib::Cond cond_;
+	Glib::Dispatcher signal_received_;
+};
+
+} // namespace DICOM
+
+} // namespace ScanAmati
@@ -0,0 +1,636 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/keyfile.h>
+#include <glibmm/i18n.h>
+
+// files from src directory begin
+#include "application.hpp"
+// files from src directory end
+
+#include "user_commands.hpp"
+#include "utils.hpp"
+#include "store_spool.hpp"
+
+namespace {
+
+const char* const lane_names[] = { "urgent", "routine" };
+const char* const failed_name = "failed";
+const char* const dataset_extension = ".dcm";
+const char* const job_extension = ".job";
+const char* const partial_extension = ".part";
+const char* const job_group = "Job";
+
+bool
+has_suffix( const std::string& name, const std::string& suffix)
+{
+	return name.size() > suffix.size() &&
+		!name.compare( name.size() - suffix.size(), suffix.size(), suffix);
+}
+
+/** Servers of the same address and title share a sender. */
+Glib::ustring
+sender_key(const ScanAmati::DICOM::Server& server)
+{
+	return server.title + '@' + server.called_address();
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+StoreSpool::Metrics::Metrics()
+	:
+	sent(0),
+	failures(0),
+	given_up(0),
+	last_latency(0.),
+	mean_latency(0.),
+	oldest(0)
+{
+	std::fill( depth, depth + PRIORITIES, 0);
+}
+
+unsigned int
+StoreSpool::Metrics::waiting() const
+{
+	unsigned int count = 0;
+	for ( int p = 0; p < PRIORITIES; ++p)
+		count += depth[p];
+	return count;
+}
+
+Glib::ustring
+StoreSpool::Metrics::summary() const
+{
+	Glib::ustring text = Glib::ustring::compose(
+		_("Outgoing queue: %1 urgent, %2 routine, %3 failed; "
+		"%4 sent, mean delay %5 s."),
+		Glib::ustring::format(depth[PRIORITY_URGENT]),
+		Glib::ustring::format(depth[PRIORITY_ROUTINE]),
+		Glib::ustring::format(given_up), Glib::ustring::format(sent),
+		Glib::ustring::format( std::fixed, std::setprecision(0),
+		mean_latency));
+	if (waiting() && !last_error.empty())
+		text += Glib::ustring::compose( _(" Last error: %1"), last_error);
+	return text;
+}
+
+StoreSpool&
+StoreSpool::instance()
+{
+	static StoreSpool spool;
+	return spool;
+}
+
+StoreSpool::StoreSpool()
+	:
+	initial_backoff_(10),
+	maximum_backoff_(600),
+	max_attempts_(20),
+	sequence_(0),
+	latency_sum_(0.),
+	stop_(false)
+{
+}
+
+StoreSpool::~StoreSpool()
+{
+	stop();
+}
+
+bool
+StoreSpool::start(const std::string& directory)
+{
+	stop();
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		directory_ = directory;
+		if (g_mkdir_with_parents( failed_dir().c_str(), 0700)) {
+			OFLOG_DEBUG( app.log, "Unable to create spool directory "
+				<< failed_dir());
+			directory_.clear();
+			return false;
+		}
+		for ( int p = 0; p < PRIORITIES; ++p) {
+			Priority priority = static_cast<Priority>(p);
+			if (g_mkdir_with_parents( lane_dir(priority).c_str(), 0700)) {
+				OFLOG_DEBUG( app.log, "Unable to create spool directory "
+					<< lane_dir(priority));
+				directory_.clear();
+				return false;
+			}
+			resume(priority);
+		}
+		metrics_.given_up = count_given_up();
+		stop_ = false;
+
+		for ( int p = 0; p < PRIORITIES; ++p)
+			for ( Lane::const_iterator it = lanes_[p].begin();
+				it != lanes_[p].end(); ++it)
+				start_sender(it->server);
+	}
+	return true;
+}
+
+/**
+ * Senders blocked in an association are waited for, the jobs stay in
+ * the directory.
+ */
+void
+StoreSpool::stop()
+{
+	Senders senders;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		stop_ = true;
+		cond_.broadcast();
+		senders.swap(senders_);
+	}
+
+	for ( Senders::const_iterator it = senders.begin(); it != senders.end();
+		++it)
+		it->second->join();
+}
+
+/** Start the sender of the server unless it runs, the mutex must be locked. */
+void
+StoreSpool::start_sender(const Server& server)
+{
+	Glib::ustring key = sender_key(server);
+	if (stop_ || senders_.count(key))
+		return;
+
+	try {
+		senders_[key] = Glib::Thread::create( sigc::bind( sigc::mem_fun(
+			*this, &StoreSpool::run_sender), key), true);
+	}
+	catch (const Glib::ThreadError& ex) {
+		OFLOG_ERROR( app.log, "Unable to start the sender for "
+			<< key << ": " << ex.what());
+	}
+}
+
+void
+StoreSpool::enqueue( DcmDataset& dataset, const Server& server,
+	Priority priority) throw(Exception)
+{
+	Job job;
+	std::string file;
+	std::string jobfile;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		if (directory_.empty())
+			throw Exception(_("Outgoing queue is not available."));
+
+		Glib::TimeVal now;
+		now.assign_current_time();
+
+		std::ostringstream name;
+		name << std::setfill('0') << std::setw(10) << now.tv_sec
+			<< std::setw(6) << now.tv_usec << '-'
+			<< std::setw(4) << (sequence_++ % 10000);
+
+		job.name = name.str();
+		job.priority = priority;
+		job.server = server;
+		job.attempts = 0;
+		job.queued = now.tv_sec;
+		job.next_try = now.tv_sec;
+
+		file = dataset_file(job);
+		jobfile = job_file(job);
+	}
+
+	// the sender is not held up while the dataset is written, and the
+	// dataset is complete before the job file exists
+	std::string partial = file + partial_extension;
+	DcmFileFormat fileformat(&dataset);
+	OFCondition cond = fileformat.saveFile( partial.c_str(),
+		EXS_Unknown, EET_ExplicitLength, EGL_withGL);
+	if (cond.bad() || g_rename( partial.c_str(), file.c_str())) {
+		g_remove(partial.c_str());
+		throw Exception(_("Unable to write the dataset to the outgoing queue."));
+	}
+
+	try {
+		write_job( jobfile, job);
+	}
+	catch (const Exception&) {
+		g_remove(file.c_str());
+		throw;
+	}
+
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		lanes_[priority].push_back(job);
+		++metrics_.depth[priority];
+		if (!metrics_.oldest || job.queued < metrics_.oldest)
+			metrics_.oldest = job.queued;
+		start_sender(server);
+		cond_.broadcast();
+	}
+	signal_changed_();
+}
+
+void
+StoreSpool::retry_now()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	time_t now = time(0);
+	for ( int p = 0; p < PRIORITIES; ++p)
+		for ( Lane::iterator it = lanes_[p].begin(); it != lanes_[p].end(); ++it)
+			it->next_try = now;
+	cond_.broadcast();
+}
+
+void
+StoreSpool::set_backoff( unsigned int initial, unsigned int maximum)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	initial_backoff_ = std::max( initial, 1u);
+	maximum_backoff_ = std::max( maximum, initial_backoff_);
+}
+
+void
+StoreSpool::set_max_attempts(unsigned int attempts)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	max_attempts_ = attempts;
+}
+
+StoreSpool::Metrics
+StoreSpool::metrics() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return metrics_;
+}
+
+void
+StoreSpool::run_sender(Glib::ustring server)
+{
+	for (;;) {
+		Job job;
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			for (;;) {
+				if (stop_)
+					return;
+
+				time_t wake = 0;
+				if (take_ready( server, time(0), job, wake))
+					break;
+
+				if (wake)
+					cond_.timed_wait( mutex_, Glib::TimeVal( wake, 0));
+				else
+					cond_.wait(mutex_);
+			}
+		}
+
+		try {
+			send(job);
+			finish_job( job, OUTCOME_SENT, Glib::ustring());
+		}
+		catch (const StoreRejected& ex) {
+			OFLOG_ERROR( app.log, "Spooled dataset " << job.name
+				<< " is rejected: " << ex.what());
+			finish_job( job, OUTCOME_REJECTED, ex.what());
+		}
+		catch (const Exception& ex) {
+			OFLOG_DEBUG( app.log, "Spooled dataset " << job.name
+				<< " is not stored: " << ex.what());
+			finish_job( job, OUTCOME_FAILED, ex.what());
+		}
+		signal_changed_();
+	}
+}
+
+/**
+ * Take the first job for the server of the highest lane whose time has
+ * come, otherwise return the time its next job is due.
+ */
+bool
+StoreSpool::take_ready( const Glib::ustring& server, time_t now, Job& job,
+	time_t& wake)
+{
+	wake = 0;
+	for ( int p = 0; p < PRIORITIES; ++p) {
+		for ( Lane::const_iterator it = lanes_[p].begin();
+			it != lanes_[p].end(); ++it) {
+			if (sender_key(it->server) != server)
+				continue;
+			if (it->next_try <= now) {
+				job = *it;
+				return true;
+			}
+			if (!wake || it->next_try < wake)
+				wake = it->next_try;
+		}
+	}
+	return false;
+}
+
+void
+StoreSpool::send(const Job& job) throw(Exception)
+{
+	DcmFileFormat fileformat;
+	OFCondition cond = fileformat.loadFile(dataset_file(job).c_str());
+	if (cond.bad())
+		throw StoreRejected(cond.text()); // it will not load next time
+
+	Dataset dataset(*fileformat.getDataset());
+	StoreCommand store(job.server);
+	store.run( &dataset, 0);
+}
+
+void
+StoreSpool::finish_job( const Job& job, Outcome outcome,
+	const Glib::ustring& error)
+{
+	Glib::Mutex::Lock lock(mutex_);
+
+	Lane& lane = lanes_[job.priority];
+	Lane::iterator it = lane.begin();
+	while (it != lane.end() && it->name != job.name)
+		++it;
+	if (it == lane.end())
+		return;
+
+	time_t now = time(0);
+	if (outcome == OUTCOME_SENT) {
+		// a crash in between leaves a dataset without job, dropped on resume
+		g_remove(job_file(job).c_str());
+		g_remove(dataset_file(job).c_str());
+		lane.erase(it);
+
+		--metrics_.depth[job.priority];
+		++metrics_.sent;
+		metrics_.last_latency = difftime( now, job.queued);
+		latency_sum_ += metrics_.last_latency;
+		metrics_.mean_latency = latency_sum_ / metrics_.sent;
+		update_oldest();
+		return;
+	}
+
+	unsigned int shift = std::min( it->attempts, 16u);
+	unsigned int delay = std::min( initial_backoff_ << shift, maximum_backoff_);
+
+	++it->attempts;
+	it->next_try = now + delay;
+	it->error = error;
+
+	++metrics_.failures;
+	metrics_.last_error = error;
+
+	if (outcome == OUTCOME_REJECTED ||
+		(max_attempts_ && it->attempts >= max_attempts_)) {
+		give_up(it);
+		return;
+	}
+
+	try {
+		write_job( job_file(*it), *it);
+	}
+	catch (const Exception& ex) {
+		OFLOG_DEBUG( app.log, ex.what());
+	}
+}
+
+/**
+ * Move the job files to the failed directory, the mutex must be locked.
+ */
+void
+StoreSpool::give_up(Lane::iterator it)
+{
+	Job job = *it;
+	lanes_[job.priority].erase(it);
+	--metrics_.depth[job.priority];
+	update_oldest();
+
+	std::string dataset = Glib::build_filename( failed_dir(),
+		job.name + dataset_extension);
+	std::string jobfile = Glib::build_filename( failed_dir(),
+		job.name + job_extension);
+	try {
+		if (g_rename( dataset_file(job).c_str(), dataset.c_str()))
+			throw Exception(_("Unable to move the dataset."));
+		write_job( jobfile, job);
+		g_remove(job_file(job).c_str());
+		++metrics_.given_up;
+	}
+	catch (const Exception& ex) {
+		OFLOG_ERROR( app.log, "Spooled dataset " << job.name
+			<< " is dropped: " << ex.what());
+		g_remove(job_file(job).c_str());
+		g_remove(dataset_file(job).c_str());
+		return;
+	}
+
+	OFLOG_ERROR( app.log, "Spooled dataset " << job.name << " for "
+		<< job.server.name << " is given up after " << job.attempts
+		<< " attempts: " << job.error);
+}
+
+/** The mutex must be locked. */
+void
+StoreSpool::update_oldest()
+{
+	metrics_.oldest = 0;
+	for ( int p = 0; p < PRIORITIES; ++p)
+		if (!lanes_[p].empty() && (!metrics_.oldest ||
+			lanes_[p].front().queued < metrics_.oldest))
+			metrics_.oldest = lanes_[p].front().queued;
+}
+
+/**
+ * Load the jobs left in the lane directory by the previous run; partly
+ * written datasets and datasets without a job are removed.
+ */
+void
+StoreSpool::resume(Priority priority)
+{
+	std::string dir = lane_dir(priority);
+	std::vector<std::string> names;
+	try {
+		Glib::Dir entries(dir);
+		names.assign( entries.begin(), entries.end());
+	}
+	catch (const Glib::FileError& ex) {
+		OFLOG_DEBUG( app.log, ex.what());
+		return;
+	}
+	std::sort( names.begin(), names.end());
+
+	Lane& lane = lanes_[priority];
+	lane.clear();
+	metrics_.depth[priority] = 0;
+
+	time_t now = time(0);
+	for ( std::vector<std::string>::const_iterator it = names.begin();
+		it != names.end(); ++it) {
+		std::string path = Glib::build_filename( dir, *it);
+
+		if (has_suffix( *it, partial_extension)) {
+			g_remove(path.c_str());
+			continue;
+		}
+
+		bool is_dataset = has_suffix( *it, dataset_extension);
+		if (!is_dataset && !has_suffix( *it, job_extension))
+			continue;
+
+		std::string base = it->substr( 0, it->rfind('.'));
+		std::string pair = Glib::build_filename( dir,
+			base + (is_dataset ? job_extension : dataset_extension));
+		if (!Glib::file_test( pair, Glib::FILE_TEST_EXISTS)) {
+			g_remove(path.c_str());
+			continue;
+		}
+		if (is_dataset)
+			continue; // taken with its job file
+
+		Job job;
+		if (!read_job( path, job)) {
+			g_remove(path.c_str());
+			g_remove(pair.c_str());
+			continue;
+		}
+		job.name = base;
+		job.priority = priority;
+		// the backoff goes on, a clock set back does not stall the job
+		if (!job.next_try || job.next_try > now + time_t(maximum_backoff_))
+			job.next_try = now;
+		lane.push_back(job);
+
+		++metrics_.depth[priority];
+		if (!metrics_.oldest || job.queued < metrics_.oldest)
+			metrics_.oldest = job.queued;
+	}
+
+	if (!lane.empty())
+		OFLOG_DEBUG( app.log, "Resumed " << lane.size() << " "
+			<< lane_names[priority] << " spooled datasets");
+}
+
+unsigned int
+StoreSpool::count_given_up() const
+{
+	unsigned int count = 0;
+	try {
+		Glib::Dir entries(failed_dir());
+		for ( Glib::Dir::iterator it = entries.begin(); it != entries.end();
+			++it)
+			if (has_suffix( *it, job_extension))
+				++count;
+	}
+	catch (const Glib::FileError& ex) {
+		OFLOG_DEBUG( app.log, ex.what());
+	}
+	return count;
+}
+
+std::string
+StoreSpool::lane_dir(Priority priority) const
+{
+	return Glib::build_filename( directory_, lane_names[priority]);
+}
+
+std::string
+StoreSpool::failed_dir() const
+{
+	return Glib::build_filename( directory_, failed_name);
+}
+
+std::string
+StoreSpool::dataset_file(const Job& job) const
+{
+	return Glib::build_filename( lane_dir(job.priority),
+		job.name + dataset_extension);
+}
+
+std::string
+StoreSpool::job_file(const Job& job) const
+{
+	return Glib::build_filename( lane_dir(job.priority),
+		job.name + job_extension);
+}
+
+bool
+StoreSpool::read_job( const std::string& filename, Job& job)
+{
+	Glib::KeyFile keyfile;
+	try {
+		keyfile.load_from_file(filename);
+		job.server.name = keyfile.get_string( job_group, "Server");
+		job.server.host = keyfile.get_string( job_group, "Host");
+		job.server.title = keyfile.get_string( job_group, "AE Title");
+		job.server.port = keyfile.get_integer( job_group, "Port");
+		job.attempts = keyfile.get_integer( job_group, "Attempts");
+		job.queued = keyfile.get_double( job_group, "Queued");
+		job.next_try = keyfile.has_key( job_group, "Next Try") ?
+			time_t(keyfile.get_double( job_group, "Next Try")) : 0;
+		job.error = keyfile.has_key( job_group, "Error") ?
+			keyfile.get_string( job_group, "Error") : Glib::ustring();
+	}
+	catch (const Glib::Error& ex) {
+		OFLOG_DEBUG( app.log, "Broken spool job " << filename << ": "
+			<< ex.what());
+		return false;
+	}
+	return true;
+}
+
+/** The job file is replaced atomically by g_file_set_contents(). */
+void
+StoreSpool::write_job( const std::string& filename, const Job& job)
+	throw(Exception)
+{
+	Glib::KeyFile keyfile;
+	keyfile.set_string( job_group, "Server", job.server.name);
+	keyfile.set_string( job_group, "Host", job.server.host);
+	keyfile.set_string( job_group, "AE Title", job.server.title);
+	keyfile.set_integer( job_group, "Port", job.server.port);
+	keyfile.set_integer( job_group, "Attempts", job.attempts);
+	keyfile.set_double( job_group, "Queued", job.queued);
+	keyfile.set_double( job_group, "Next Try", job.next_try);
+	if (!job.error.empty())
+		keyfile.set_string( job_group, "Error", job.error);
+
+	std::string data = keyfile.to_data();
+	GError* error = 0;
+	if (!g_file_set_contents( filename.c_str(), data.c_str(), data.size(),
+		&error)) {
+		Glib::ustring message = error->message;
+		g_error_free(error);
+		throw Exception(message);
+	}
+}
+
+} // namespace DICOM
+
+} // namespace ScanAmati
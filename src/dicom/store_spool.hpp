@@ -0,0 +1,170 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/thread.h>
+
+// files from src directory begin
+#include "dcmtk_defines.hpp"
+#include "exceptions.hpp"
+// files from src directory end
+
+#include "server.hpp"
+
+namespace ScanAmati {
+
+namespace DICOM {
+
+/**
+ * Disk backed queue of outgoing datasets.
+ *
+ * Every queued dataset is a pair of files in the lane directory of its
+ * priority: the dataset itself and a job file with the server and the
+ * state of the delivery. The dataset is written first and the job file
+ * is replaced atomically, so a crash leaves either a complete job or
+ * nothing, and the jobs left in the directory are resumed on start().
+ *
+ * Every server has its own sender thread, started with the first job
+ * for it. A sender takes the jobs of its server, urgent lane first, each
+ * lane in order of arrival, so a server which does not answer holds up
+ * only its own jobs. A failed job waits before the next attempt, the
+ * delay doubles with every attempt up to the maximum backoff. A job
+ * refused by the server, or failed the maximum number of times, is
+ * moved to the failed directory and left there for the operator.
+ */
+class StoreSpool {
+public:
+	enum Priority {
+		PRIORITY_URGENT,
+		PRIORITY_ROUTINE,
+		PRIORITIES
+	};
+
+	struct Metrics {
+		Metrics();
+
+		unsigned int depth[PRIORITIES]; // queued datasets of every lane
+		unsigned int sent;
+		unsigned int failures; // failed attempts
+		unsigned int given_up; // jobs in the failed directory
+		double last_latency; // seconds from enqueue() to the server
+		double mean_latency;
+		time_t oldest; // enqueue time of the oldest job, 0 if none
+		Glib::ustring last_error;
+
+		unsigned int waiting() const;
+		Glib::ustring summary() const; /**< one line for the GUI */
+	};
+
+	static StoreSpool& instance();
+
+	/** \brief Resume the jobs of the directory and start their senders.
+	 *
+	 * \return false if the directory can not be created.
+	 */
+	bool start(const std::string& directory);
+	void stop();
+
+	/** \brief Queue a copy of the dataset for the server.
+	 *
+	 * \throw Exception if the dataset can not be written to the spool.
+	 */
+	void enqueue( DcmDataset& dataset, const Server& server,
+		Priority priority = PRIORITY_ROUTINE) throw(Exception);
+
+	/** Try all the waiting jobs now. */
+	void retry_now();
+
+	/** Delays in seconds of the first and of any later attempt. */
+	void set_backoff( unsigned int initial, unsigned int maximum);
+	/** Attempts before a job is given up, 0 for no limit. */
+	void set_max_attempts(unsigned int attempts);
+
+	Metrics metrics() const;
+
+	/** Emitted in the GUI thread when a job is queued, sent or failed. */
+	Glib::Dispatcher& signal_changed() { return signal_changed_; }
+
+private:
+	struct Job {
+		std::string name; // base name of the files, sorts by arrival
+		Priority priority;
+		Server server;
+		unsigned int attempts;
+		time_t queued;
+		time_t next_try;
+		Glib::ustring error;
+	};
+
+	typedef std::list<Job> Lane;
+	typedef std::map< Glib::ustring, Glib::Thread*> Senders; // by server
+
+	StoreSpool();
+	~StoreSpool();
+
+	enum Outcome {
+		OUTCOME_SENT,
+		OUTCOME_FAILED, // tried again later
+		OUTCOME_REJECTED // never sent again
+	};
+
+	void start_sender(const Server& server);
+	void run_sender(Glib::ustring server);
+	bool take_ready( const Glib::ustring& server, time_t now, Job& job,
+		time_t& wake);
+	void send(const Job& job) throw(Exception);
+	void finish_job( const Job& job, Outcome outcome,
+		const Glib::ustring& error);
+	void give_up( Lane::iterator it);
+	void update_oldest();
+	void resume(Priority priority);
+	unsigned int count_given_up() const;
+
+	std::string lane_dir(Priority priority) const;
+	std::string failed_dir() const;
+	std::string dataset_file(const Job& job) const;
+	std::string job_file(const Job& job) const;
+	static bool read_job( const std::string& filename, Job& job);
+	static void write_job( const std::string& filename, const Job& job)
+		throw(Exception);
+
+	std::string directory_;
+	Lane lanes_[PRIORITIES];
+	unsigned int initial_backoff_;
+	unsigned int maximum_backoff_;
+	unsigned int max_attempts_;
+	unsigned int sequence_;
+	Metrics metrics_;
+	double latency_sum_;
+
+	Senders senders_;
+	bool stop_;
+	mutable Glib::Mutex mutex_;
+	Glib::Cond cond_;
+	Glib::Dispatcher signal_changed_;
+};
+
+} // namespace DICOM
+
+} // namespace ScanAmati
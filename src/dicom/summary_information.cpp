@@ -169,13 +169,6 @@ const DefaultTagString file_defaults[] = {
 	{ DCM_SamplesPerPixel, "1" },
 	{ DCM_PhotometricInterpretation, "MONOCHROME2" },
 	{ DCM_BitsAllocated, "16" },
-#if SCANNER_ADC_RESOLUTION == 14
-	{ DCM_BitsStored, "14" },
-	{ DCM_HighBit, "13" },
-#elif SCANNER_ADC_RESOLUTION == 12
-	{ DCM_BitsStored, "12" },
-	{ DCM_HighBit, "11" },
-#endif
 	{ DCM_PixelRepresentation, "0000H" },
 	{ DCM_PixelIntensityRelationship, "LIN" },
 	{ DCM_PixelIntensityRelationshipSign, "1" },
@@ -185,13 +178,6 @@ const DefaultTagString file_defaults[] = {
 	{ DCM_PresentationLUTShape, "IDENTITY" },
 	{ DCM_LossyImageCompression, "00" },
 	{ DCM_BurnedInAnnotation, "NO" },
-#if SCANNER_ADC_RESOLUTION == 14
-	{ DCM_WindowCenter, "8193" },
-	{ DCM_WindowWidth, "16384" },
-#elif SCANNER_ADC_RESOLUTION == 12
-	{ DCM_WindowCenter, "2047" },
-	{ DCM_WindowWidth, "4095" },
-#endif
 	{ DCM_ScanOptions, "STEP" },
 	{ DCM_DetectorType, "DIRECT" },
 	{ DCM_DetectorConfiguration, "SLOT" },
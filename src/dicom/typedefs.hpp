@@ -69,6 +69,12 @@ enum SexStringType {
 	SEX_STRING_SHORT
 };
 
+enum CompressionType { // lossless only
+	COMPRESSION_NONE,
+	COMPRESSION_JPEG_LS,
+	COMPRESSION_RLE
+};
+
 typedef std::vector<PositionType> PositionVector;
 typedef std::map< PositionType, Glib::ustring> PositionStringMap;
 typedef std::pair< PositionType, Glib::ustring> PositionStringPair;
@@ -15,7 +15,12 @@
  *      MA 02110-1301, USA.
  */
 
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
 #include <glibmm/i18n.h>
+#include <sigc++/bind.h>
 
 // files from src directory begin
 #include "application.hpp"
@@ -28,16 +33,24 @@
 namespace {
 
 typedef ScanAmati::DICOM::UserCommand::StoreCallbackData StoreCallbackData;
+typedef ScanAmati::DICOM::StoreReceiver StoreReceiver;
 
 OFLogger& log = ScanAmati::app.log;
 
-const char* cmove_filename = 0;
+const unsigned int default_idle_time = 60; // seconds
 
-DIMSE_StoreProviderCallback store_provider_callback;
+// image classes proposed with the compressed transfer syntax
+const char* const compressed_sop_classes[] = {
+	UID_DigitalXRayImageStorageForPresentation,
+	UID_DigitalXRayImageStorageForProcessing,
+	UID_ComputedRadiographyImageStorage
+};
 
 struct CallbackInfo {
 	T_ASC_Association *assoc;
 	T_ASC_PresentationContextID presId;
+	StoreReceiver* receiver;
+	bool cancel_sent;
 };
 
 const struct QuerySyntax {
@@ -52,6 +65,15 @@ const struct QuerySyntax {
 		UID_RETIRED_MOVEPatientStudyOnlyQueryRetrieveInformationModel }
 };
 
+/** The SOP instance UID names the file, it must not be a path. */
+bool
+is_uid(const char* str)
+{
+	if (!str || !*str)
+		return false;
+	return (strspn( str, "0123456789.") == strlen(str));
+}
+
 void
 substituteOverrideKeys(DcmDataset*)
 {
@@ -59,11 +81,31 @@ substituteOverrideKeys(DcmDataset*)
 }
 
 void
-moveCallback( void*, T_DIMSE_C_MoveRQ*, int count, T_DIMSE_C_MoveRSP* response)
+moveCallback( void* callbackData, T_DIMSE_C_MoveRQ* request, int count,
+	T_DIMSE_C_MoveRSP* response)
 {
     OFString temp_str;
     OFLOG_DEBUG( log, "Move Response " << count << ":" << std::endl
 		<< DIMSE_dumpMessage( temp_str, *response, DIMSE_INCOMING));
+
+	CallbackInfo* info = static_cast<CallbackInfo*>(callbackData);
+	if (!info || !info->receiver)
+		return;
+
+	info->receiver->moved( response->NumberOfRemainingSubOperations,
+		response->NumberOfCompletedSubOperations,
+		response->NumberOfFailedSubOperations,
+		response->NumberOfWarningSubOperations);
+
+	// the server stops the sub-operations and sends the final response
+	if (!info->cancel_sent && info->receiver->cancelled()) {
+		OFCondition cond = DIMSE_sendCancelRequest( info->assoc,
+			info->presId, request->MessageID);
+		if (cond.bad())
+			OFLOG_DEBUG( log, "Cancel Request Failed: "
+				<< DimseCondition::dump( temp_str, cond));
+		info->cancel_sent = true;
+	}
 }
 
 OFBool
@@ -187,7 +229,8 @@ addPresentationContext( T_ASC_Parameters *params,
 
 OFCondition
 addStoragePresentationContexts( T_ASC_Parameters *params,
-	OFList<OFString>& sopClasses)
+	OFList<OFString>& sopClasses,
+	ScanAmati::DICOM::CompressionType compression)
 {
 	/*
 	 * Each SOP Class will be proposed in two presentation contexts (unless
@@ -245,6 +288,16 @@ addStoragePresentationContexts( T_ASC_Parameters *params,
 		++s_cur;
 	}
 
+	// The image classes are proposed compressed in one context and with
+	// all the uncompressed syntaxes in the other, the server may refuse
+	// the compressed one.
+	E_TransferSyntax compressed =
+		ScanAmati::DICOM::compression_transfer_syntax(compression);
+	OFList<OFString> compressedSops;
+	if (compressed != EXS_Unknown)
+		for ( unsigned int i = 0; i < DIM_OF(compressed_sop_classes); ++i)
+			compressedSops.push_back(compressed_sop_classes[i]);
+
 	// add the (short list of) known storage SOP classes to the list
 	// the array of Storage SOP Class UIDs comes from dcuid.h
 	for (int i = 0; i < numberOfDcmShortSCUStorageSOPClassUIDs; i++)
@@ -273,6 +326,19 @@ addStoragePresentationContexts( T_ASC_Parameters *params,
 			return ASC_BADPRESENTATIONCONTEXTID;
 		}
 
+		if (isaListMember( compressedSops, *s_cur)) {
+			cond = addPresentationContext( params, pid, *s_cur,
+				DcmXfer(compressed).getXferID());
+			pid += 2;
+
+			if (cond.good())
+				cond = addPresentationContext( params, pid, *s_cur,
+					combinedSyntaxes);
+			pid += 2;
+			++s_cur;
+			continue;
+		}
+
 		// SOP class with preferred transfer syntax
 		cond = addPresentationContext( params, pid, *s_cur, preferredTransferSyntax);
 		pid += 2;   /* only odd presentation context id's */
@@ -293,6 +359,24 @@ addStoragePresentationContexts( T_ASC_Parameters *params,
 	return cond;
 }
 
+/**
+ * Accepted presentation context of the abstract syntax with exactly the
+ * transfer syntax, 0 if there is none.
+ */
+T_ASC_PresentationContextID
+acceptedContext( T_ASC_Association* assoc, const char* abstractSyntax,
+	E_TransferSyntax xfer)
+{
+	T_ASC_PresentationContextID presId = ASC_findAcceptedPresentationContextID(
+		assoc, abstractSyntax, DcmXfer(xfer).getXferID());
+	if (presId == 0)
+		return 0;
+
+	T_ASC_PresentationContext pc;
+	ASC_findAcceptedPresentationContext( assoc->params, presId, &pc);
+	return (DcmXfer(pc.acceptedTransferSyntax).getXfer() == xfer) ? presId : 0;
+}
+
 OFCondition
 acceptSubAssoc( T_ASC_Network* net, T_ASC_Association** assoc)
 {
@@ -321,7 +405,7 @@ acceptSubAssoc( T_ASC_Network* net, T_ASC_Association** assoc)
 	cond = ASC_acceptContextsWithPreferredTransferSyntaxes( (*assoc)->params,
 		knownAbstractSyntaxes, DIM_OF(knownAbstractSyntaxes), transferSyntaxes,
 		numTransferSyntaxes);
-/*
+
 	if (cond.good()) {
 		// the array of Storage SOP Class UIDs comes from dcuid.h
 		cond = ASC_acceptContextsWithPreferredTransferSyntaxes(
@@ -329,7 +413,6 @@ acceptSubAssoc( T_ASC_Network* net, T_ASC_Association** assoc)
 			dcmAllStorageSOPClassUIDs, numberOfAllDcmStorageSOPClassUIDs,
 			transferSyntaxes, numTransferSyntaxes);
 	}
-*/
 	if (cond.good())
 		cond = ASC_acknowledgeAssociation(*assoc);
 	if (cond.bad()) {
@@ -361,7 +444,6 @@ echoSCP( T_ASC_Association* assoc, T_DIMSE_Message* msg,
 	return cond;
 }
 
-// That callback MUST BE in GUI
 void
 storeSCPCallback(
 	/* in */
@@ -377,23 +459,14 @@ storeSCPCallback(
 	DIC_UI sopClass;
 	DIC_UI sopInstance;
 
-	// dump some information if required (depending on the progress state)
-	// We can't use oflog for the pdu output, but we use a special logger for
-	// generating this output. If it is set to level "INFO" we generate the
-	// output, if it's set to "DEBUG" then we'll assume that there is debug output
-	// generated for each PDU elsewhere.
-	switch (progress->state) {
-	case DIMSE_StoreBegin:
-		std::cout << "RECV: ";
-		break;
-	case DIMSE_StoreEnd:
-		std::cout << std::endl;
-		break;
-	default:
-		std::cout << '.';
-		break;
+	StoreCallbackData* cbdata = static_cast<StoreCallbackData*>(callbackData);
+	StoreReceiver* receiver = cbdata->receiver;
+
+	if (progress->state != DIMSE_StoreEnd) {
+		if (receiver)
+			receiver->receiving( progress->progressBytes, progress->totalBytes);
+		return;
 	}
-	std::cout.flush();
 
 	if (progress->state == DIMSE_StoreEnd) {
 		*statusDetail = NULL;    /* no status detail */
@@ -406,16 +479,42 @@ storeSCPCallback(
 		* status will reflect this.  The callback function is still called to allow cleanup.
 		*/
 
-		if ((imageDataSet != NULL) && (*imageDataSet != NULL)) {
-			StoreCallbackData* cbdata = static_cast<StoreCallbackData*>(callbackData);
+		/* the image must be consistent, its sopClass and sopInstance must
+		* correspond with those in the request.
+		*/
+		if ((imageDataSet != NULL) && (*imageDataSet != NULL) &&
+			rsp->DimseStatus == STATUS_Success) {
+			if (!DU_findSOPClassAndInstanceInDataSet( *imageDataSet,
+				sopClass, sopInstance, OFFalse)) {
 
+				OFLOG_DEBUG( log, "Bad DICOM file: " << imageFileName);
+				rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+			}
+			else if (strcmp( sopClass, req->AffectedSOPClassUID) != 0) {
+				rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+			}
+			else if (strcmp( sopInstance, req->AffectedSOPInstanceUID) != 0) {
+				rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+			}
+			else if (!is_uid(req->AffectedSOPInstanceUID)) {
+				OFLOG_DEBUG( log, "Bad SOP instance UID: "
+					<< req->AffectedSOPInstanceUID);
+				rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+			}
+		}
+
+		if ((imageDataSet != NULL) && (*imageDataSet != NULL) && receiver) {
+			// the receiver writes the dataset after the response is sent
+			if (!receiver->accepting())
+				rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+			cbdata->accepted = (rsp->DimseStatus == STATUS_Success);
+		}
+		else if ((imageDataSet != NULL) && (*imageDataSet != NULL) &&
+			rsp->DimseStatus == STATUS_Success) {
 			/* create full path name for the output file */
 			OFString ofname;
-			if (cmove_filename)
-				ofname = OFString(cmove_filename);
-			else
-				OFStandard::combineDirAndFilename( ofname, "/tmp/",
-					cbdata->imageFileName, OFTrue);
+			OFStandard::combineDirAndFilename( ofname, _PATH_TMP,
+				cbdata->imageFileName, OFTrue);
 
 			E_TransferSyntax xfer = (*imageDataSet)->getOriginalXfer();
 
@@ -427,36 +526,13 @@ storeSCPCallback(
 				OFLOG_DEBUG( log, "Cannot write DICOM file: " << ofname);
 				rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
 			}
-
-
-			/* should really check the image to make sure it is consistent,
-			* that its sopClass and sopInstance correspond with those in
-			* the request.
-			*/
-			if (rsp->DimseStatus == STATUS_Success) {
-				/* which SOP class and SOP instance ? */
-/*
-				if (!DU_findSOPClassAndInstanceInDataSet( *imageDataSet,
-					sopClass, sopInstance, OFFalse)) {
-
-					OFLOG_DEBUG( log, "Bad DICOM file: " << imageFileName);
-					rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
-				}
-				else if (strcmp( sopClass, req->AffectedSOPClassUID) != 0) {
-					rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
-				}
-				else if (strcmp( sopInstance, req->AffectedSOPInstanceUID) != 0) {
-					rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
-				}
-*/
-			}
 		}
     }
 }
 
 OFCondition
 storeSCP( T_ASC_Association* assoc, T_DIMSE_Message* msg,
-	T_ASC_PresentationContextID presID)
+	T_ASC_PresentationContextID presID, StoreReceiver* receiver)
 {
 	OFCondition cond = EC_Normal;
 	T_DIMSE_C_StoreRQ* req;
@@ -464,8 +540,9 @@ storeSCP( T_ASC_Association* assoc, T_DIMSE_Message* msg,
 
 	req = &msg->msg.CStoreRQ;
 
-	sprintf( imageFileName, "%s.%s",
-		dcmSOPClassUIDToModality(req->AffectedSOPClassUID),
+	// the request is refused by the callback if the UID is not valid
+	snprintf( imageFileName, sizeof(imageFileName), "%s.%s",
+		dcmSOPClassUIDToModality( req->AffectedSOPClassUID, "OT"),
 		req->AffectedSOPInstanceUID);
 
 	OFString temp_str;
@@ -475,26 +552,33 @@ storeSCP( T_ASC_Association* assoc, T_DIMSE_Message* msg,
 	OFLOG_DEBUG( log,
 		DIMSE_dumpMessage( temp_str, *req, DIMSE_INCOMING, NULL, presID));
 
+	// the dataset is handed over to the receiver, if any
+	std::auto_ptr<DcmFileFormat> dcmff(new DcmFileFormat);
+
 	StoreCallbackData callbackData;
 	callbackData.assoc = assoc;
 	callbackData.imageFileName = imageFileName;
-	DcmFileFormat dcmff;
-	callbackData.dcmff = &dcmff;
+	callbackData.dcmff = dcmff.get();
+	callbackData.receiver = receiver;
+	callbackData.accepted = false;
 
 	// store SourceApplicationEntityTitle in metaheader
 	if (assoc && assoc->params) {
 		const char *aet = assoc->params->DULparams.callingAPTitle;
 		if (aet)
-			dcmff.getMetaInfo()->putAndInsertString(
+			dcmff->getMetaInfo()->putAndInsertString(
 				DCM_SourceApplicationEntityTitle, aet);
     }
 
-	DcmDataset *dset = dcmff.getDataset();
+	DcmDataset *dset = dcmff->getDataset();
 
 	cond = DIMSE_storeProvider( assoc, presID, req, NULL, OFTrue,
-		&dset, store_provider_callback, reinterpret_cast<void*>(&callbackData),
+		&dset, storeSCPCallback, reinterpret_cast<void*>(&callbackData),
 		DIMSE_BLOCKING, 0);
 
+	if (cond.good() && callbackData.accepted)
+		receiver->received( dcmff.release(), imageFileName);
+
 	if (cond.bad()) {
 		OFLOG_DEBUG( log, "Store SCP Failed: " <<
 			DimseCondition::dump( temp_str, cond));
@@ -507,7 +591,7 @@ storeSCP( T_ASC_Association* assoc, T_DIMSE_Message* msg,
 }
 
 OFCondition
-subOpSCP(T_ASC_Association** subAssoc)
+subOpSCP( T_ASC_Association** subAssoc, StoreReceiver* receiver)
 {
 	T_DIMSE_Message msg;
 	T_ASC_PresentationContextID presID;
@@ -518,21 +602,10 @@ subOpSCP(T_ASC_Association** subAssoc)
 	OFCondition cond = DIMSE_receiveCommand( *subAssoc, DIMSE_BLOCKING, 5,
 		&presID, &msg, NULL);
 
-	if (cond == EC_Normal) {
-		switch (msg.CommandField) {
-		case DIMSE_C_STORE_RQ:
-			cond = storeSCP(*subAssoc, &msg, presID);
-			break;
-		case DIMSE_C_ECHO_RQ:
-			cond = echoSCP(*subAssoc, &msg, presID);
-			break;
-		default:
-			cond = DIMSE_BADCOMMANDTYPE;
-			OFLOG_DEBUG( log, "Cannot handle command: 0x"
-				<< std::hex << static_cast<unsigned>(msg.CommandField));
-			break;
-		}
-	}
+	if (cond == EC_Normal)
+		cond = ScanAmati::DICOM::serve_command( *subAssoc, &msg, presID,
+			receiver);
+
 	/* clean up on association termination */
 	if (cond == DUL_PEERREQUESTEDRELEASE) {
 		cond = ASC_acknowledgeRelease(*subAssoc);
@@ -559,7 +632,7 @@ subOpSCP(T_ASC_Association** subAssoc)
 }
 
 void
-subOpCallback( void * /*subOpCallbackData*/, T_ASC_Network* net,
+subOpCallback( void* subOpCallbackData, T_ASC_Network* net,
 	T_ASC_Association** subAssoc)
 {
 	if (net == NULL) return;   /* help no net ! */
@@ -569,7 +642,7 @@ subOpCallback( void * /*subOpCallbackData*/, T_ASC_Network* net,
 		acceptSubAssoc( net, subAssoc);
 	} else {
 		/* be a service class provider */
-		subOpSCP(subAssoc);
+		subOpSCP( subAssoc, static_cast<StoreReceiver*>(subOpCallbackData));
 	}
 }
 
@@ -579,6 +652,27 @@ namespace ScanAmati {
 
 namespace DICOM {
 
+OFCondition
+serve_command( T_ASC_Association* assoc, T_DIMSE_Message* msg,
+	T_ASC_PresentationContextID presID, StoreReceiver* receiver)
+{
+	OFCondition cond;
+	switch (msg->CommandField) {
+	case DIMSE_C_STORE_RQ:
+		cond = storeSCP( assoc, msg, presID, receiver);
+		break;
+	case DIMSE_C_ECHO_RQ:
+		cond = echoSCP( assoc, msg, presID);
+		break;
+	default:
+		cond = DIMSE_BADCOMMANDTYPE;
+		OFLOG_DEBUG( log, "Cannot handle command: 0x"
+			<< std::hex << static_cast<unsigned>(msg->CommandField));
+		break;
+	}
+	return cond;
+}
+
 UserCommand::UserCommand( const Server& server,
 	unsigned int retrieve_port, bool ignore) throw(Exception)
 	:
@@ -715,18 +809,232 @@ EchoCommand::run() throw(Exception)
 	return static_cast<bool>(!status);
 }
 
-StoreCommand::StoreCommand(const Server& server) throw(Exception)
+AssociationPool::Connection::Connection()
 	:
-	UserCommand(server),
-	association_(0)
+	compression(COMPRESSION_NONE),
+	network(0),
+	parameters(0),
+	association(0),
+	last_used(0)
 {
+}
+
+AssociationPool::AssociationPool()
+	:
+	idle_time_(default_idle_time),
+	compression_(COMPRESSION_NONE)
+{
+}
+
+AssociationPool::~AssociationPool()
+{
+	clear();
+}
+
+AssociationPool&
+AssociationPool::instance()
+{
+	static AssociationPool pool;
+	return pool;
+}
+
+void
+AssociationPool::set_idle_time(unsigned int seconds)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	idle_time_ = seconds;
+}
+
+unsigned int
+AssociationPool::idle_time() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return idle_time_;
+}
+
+void
+AssociationPool::set_compression(CompressionType compression)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	compression_ = compression;
+}
+
+CompressionType
+AssociationPool::compression() const
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return compression_;
+}
+
+/** Associations negotiated with another compression are not reused. */
+std::string
+AssociationPool::key( const Server& server, CompressionType compression)
+{
+	std::string key = server.title.raw() + '@' + server.called_address().raw();
+	if (compression != COMPRESSION_NONE) {
+		key += '/';
+		key += DcmXfer(compression_transfer_syntax(compression)).getXferID();
+	}
+	return key;
+}
+
+AssociationPool::Connection*
+AssociationPool::acquire( const Server& server, bool& reused)
+	throw(Exception)
+{
+	std::vector<Connection*> expired;
+	Connection* connection = 0;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		take_expired(expired);
+
+		IdleMap::iterator iter = idle_.find(key( server, compression_));
+		if (iter != idle_.end()) {
+			connection = iter->second;
+			idle_.erase(iter);
+		}
+	}
+
+	// releasing waits for the peer, the pool is not locked meanwhile
+	close_expired(expired);
+
+	reused = (connection != 0);
+	if (reused) {
+		OFLOG_DEBUG( app.log, "Reusing association to " << connection->key);
+		return connection;
+	}
+	return open(server);
+}
+
+AssociationPool::Connection*
+AssociationPool::open(const Server& server) throw(Exception)
+{
+	Connection* connection = new Connection;
+	connection->compression = compression();
+	connection->key = key( server, connection->compression);
+
+	try {
+		negotiate( server, *connection);
+	}
+	catch (const Exception&) {
+		close( connection, false);
+		throw;
+	}
+	return connection;
+}
+
+void
+AssociationPool::release( Connection* connection, bool reusable)
+{
+	if (!connection)
+		return;
+
+	std::vector<Connection*> expired;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		if (reusable && idle_time_) {
+			connection->last_used = time(0);
+			idle_.insert(IdleMap::value_type( connection->key, connection));
+			connection = 0;
+		}
+		take_expired(expired);
+	}
+
+	if (connection)
+		close( connection, reusable);
+	close_expired(expired);
+}
+
+void
+AssociationPool::clear()
+{
+	IdleMap idle;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		idle.swap(idle_);
+	}
+
+	for ( IdleMap::iterator iter = idle.begin(); iter != idle.end(); ++iter)
+		close( iter->second, true);
+}
+
+void
+AssociationPool::expire()
+{
+	std::vector<Connection*> expired;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		take_expired(expired);
+	}
+
+	// releasing waits for the peer, the caller is the GUI thread
+	if (!expired.empty())
+		Glib::Thread::create( sigc::bind( sigc::ptr_fun(
+			&AssociationPool::close_expired), expired), false);
+}
+
+void
+AssociationPool::close_expired(std::vector<Connection*> expired)
+{
+	for ( unsigned int i = 0; i < expired.size(); ++i)
+		close( expired[i], true);
+}
+
+/**
+ * Moves the associations idle for longer than the idle time out of the
+ * pool, the mutex must be locked.
+ */
+void
+AssociationPool::take_expired(std::vector<Connection*>& expired)
+{
+	time_t now = time(0);
+
+	IdleMap::iterator iter = idle_.begin();
+	while (iter != idle_.end()) {
+		if (difftime( now, iter->second->last_used) >= idle_time_) {
+			expired.push_back(iter->second);
+			idle_.erase(iter++);
+		}
+		else
+			++iter;
+	}
+}
+
+void
+AssociationPool::negotiate( const Server& server, Connection& connection)
+	throw(Exception)
+{
+	/* make sure data dictionary is loaded */
+	if (!dcmDataDict.isDictionaryLoaded()) {
+		std::cerr << "Warning: no data dictionary loaded, ";
+		std::cerr << "check environment variable: ";
+		std::cerr << DCM_DICT_ENVIRONMENT_VARIABLE << std::endl;
+		throw Exception(_("Data Dictionary wasn't loaded."));
+	}
+
+	// network struct, contains DICOM upper layer FSM etc.
+	OFCondition cond = ASC_initializeNetwork( NET_REQUESTOR, 0, 5,
+		&connection.network);
+	if (cond.bad()) {
+		if (app.debug) DimseCondition::dump(cond);
+		throw Exception(_("Unable to initialize network."));
+	}
+
+	// parameters of association request
+	cond = ASC_createAssociationParameters( &connection.parameters,
+		ASC_DEFAULTMAXPDU);
+	if (cond.bad()) {
+		if (app.debug) DimseCondition::dump(cond);
+		throw Exception(_("Unable to create parameters of the association."));
+	}
+
+	T_ASC_Parameters* parameters = connection.parameters;
 	OFList<OFString> sopClassUIDList; // the list of sop classes
 
 	// set calling and called AE titles
-	OFCondition cond = ASC_setAPTitles( parameters_, app.ae_title.c_str(),
+	cond = ASC_setAPTitles( parameters, app.ae_title.c_str(),
 		server.title.c_str(), NULL);
 	if (cond.bad()) {
-		parameters_ = 0;
 		if (app.debug) DimseCondition::dump(cond);
 		throw Exception(_("Unable to set application entity titles."));
 	}
@@ -734,7 +1042,7 @@ StoreCommand::StoreCommand(const Server& server) throw(Exception)
     /* Set the transport layer type (type of network connection) in the params */
     /* strucutre. The default is an insecure connection; where OpenSSL is  */
     /* available the user is able to request an encrypted,secure connection. */
-    cond = ASC_setTransportLayerType( parameters_, OFFalse);
+    cond = ASC_setTransportLayerType( parameters, OFFalse);
     if (cond.bad()) {
         DimseCondition::dump(cond);
         throw Exception(_("Unable to set type of network connection."));
@@ -742,10 +1050,11 @@ StoreCommand::StoreCommand(const Server& server) throw(Exception)
 
 	DIC_NODENAME local_host;
 	gethostname( local_host, sizeof(local_host) - 1);
-	ASC_setPresentationAddresses( parameters_, local_host,
+	ASC_setPresentationAddresses( parameters, local_host,
 		server.called_address().c_str());
 
-	cond = addStoragePresentationContexts( parameters_, sopClassUIDList);
+	cond = addStoragePresentationContexts( parameters, sopClassUIDList,
+		connection.compression);
 	if (cond.bad()) {
 		DimseCondition::dump(cond);
 		throw Exception(_("Unable to add storage presentation contexts."));
@@ -754,18 +1063,19 @@ StoreCommand::StoreCommand(const Server& server) throw(Exception)
 	/* dump presentation contexts if required */
 	OFLOG_DEBUG( app.log, "Request Parameters:");
 	if (app.debug)
-		ASC_dumpParameters( parameters_, std::cout);
+		ASC_dumpParameters( parameters, std::cout);
 
 	/* create association, i.e. try to establish a network connection to another */
 	/* DICOM application. This call creates an instance of T_ASC_Association*. */
 	OFLOG_DEBUG( app.log, "Requesting Association");
 
-	cond = ASC_requestAssociation( network_, parameters_, &association_);
+	cond = ASC_requestAssociation( connection.network, parameters,
+		&connection.association);
 	if (cond.bad()) {
 		if (cond == DUL_ASSOCIATIONREJECTED) {
 			T_ASC_RejectParameters rej;
 
-			ASC_getRejectParameters( parameters_, &rej);
+			ASC_getRejectParameters( parameters, &rej);
 			OFLOG_DEBUG( app.log, "Association Rejected");
 			ASC_printRejectParameters(stderr, &rej);
 			throw Exception(_("Association rejected."));
@@ -779,37 +1089,106 @@ StoreCommand::StoreCommand(const Server& server) throw(Exception)
 	/* dump the presentation contexts which have been accepted/refused */
 	OFLOG_DEBUG( app.log, "Association Parameters Negotiated");
 	if (app.debug)
-		ASC_dumpParameters( parameters_, std::cout);
+		ASC_dumpParameters( parameters, std::cout);
 
 	/* count the presentation contexts which have been accepted by the SCP */
 	/* If there are none, finish the execution */
-	if (ASC_countAcceptedPresentationContexts(parameters_) == 0) {
+	if (ASC_countAcceptedPresentationContexts(parameters) == 0) {
 		OFLOG_DEBUG( app.log, "No Acceptable Presentation Contexts");
 		throw Exception(_("No acceptable presentation contexts."));
 	}
 }
 
-StoreCommand::~StoreCommand()
+void
+AssociationPool::close( Connection* connection, bool release)
 {
-	/* destroy the association, i.e. free memory of T_ASC_Association* structure. This */
-	/* call is the counterpart of ASC_requestAssociation(...) which was called above. */
+	if (connection->association) {
+		/* release the association or abort it after a failure, then free */
+		/* memory of the T_ASC_Association* structure and its parameters */
+		OFCondition cond = release ?
+			ASC_releaseAssociation(connection->association) :
+			ASC_abortAssociation(connection->association);
+		if (cond.bad()) {
+			DimseCondition::dump(cond);
+		}
 
-	OFCondition cond = ASC_releaseAssociation(association_); // release association
-	if (cond.bad()) {
-		DimseCondition::dump(cond);
+		cond = ASC_destroyAssociation(&connection->association);
+		if (cond.bad()) {
+			DimseCondition::dump(cond);
+		}
 	}
-	
-	cond = ASC_destroyAssociation(&association_);
-	if (cond.bad()) {
-		DimseCondition::dump(cond);
+	else if (connection->parameters) {
+		ASC_destroyAssociationParameters(&connection->parameters);
 	}
+
+	if (connection->network)
+		ASC_dropNetwork(&connection->network);
+
+	delete connection;
+}
+
+StoreCommand::StoreCommand(const Server& server) throw(Exception)
+	:
+	server_(server),
+	connection_(0),
+	reused_(false),
+	failed_(false)
+{
+	connection_ = AssociationPool::instance().acquire( server_, reused_);
+}
+
+StoreCommand::~StoreCommand()
+{
+	AssociationPool::instance().release( connection_, !failed_);
 }
 
+/**
+ * A reused association may have been closed by the server after its
+ * own idle timeout, the dataset is sent once more over a new
+ * association then.
+ */
 bool
 StoreCommand::run( Dataset* dataset,
 	DIMSE_StoreUserCallback callback) throw(Exception)
 {
-	DIC_US msgId = association_->nextMsgID++;
+	try {
+		return store( dataset, callback);
+	}
+	catch (const StoreRejected&) {
+		throw;
+	}
+	catch (const Exception&) {
+		failed_ = true;
+		if (!reused_)
+			throw;
+	}
+
+	OFLOG_DEBUG( app.log, "Reused association failed, requesting a new one");
+	AssociationPool& pool = AssociationPool::instance();
+	pool.release( connection_, false);
+	connection_ = 0;
+	reused_ = false;
+
+	connection_ = pool.open(server_);
+	failed_ = false;
+	try {
+		return store( dataset, callback);
+	}
+	catch (const StoreRejected&) {
+		throw;
+	}
+	catch (const Exception&) {
+		failed_ = true;
+		throw;
+	}
+}
+
+bool
+StoreCommand::store( Dataset* dataset,
+	DIMSE_StoreUserCallback callback) throw(Exception)
+{
+	T_ASC_Association* association = connection_->association;
+	DIC_US msgId = association->nextMsgID++;
 	T_ASC_PresentationContextID presId;
 	T_DIMSE_C_StoreRQ req;
 	T_DIMSE_C_StoreRSP rsp;
@@ -823,29 +1202,45 @@ StoreCommand::run( Dataset* dataset,
 	OFLOG_DEBUG( app.log, "Sending dataset");
 
 	/* figure out which SOP class and SOP instance is encapsulated in the file */
-/*
 	if (!DU_findSOPClassAndInstanceInDataSet( set,
 		sopClass, sopInstance, OFFalse)) {
 		OFLOG_DEBUG( app.log, "No SOP Class & Instance UIDs in dataset");
-		throw Exception(_("No SOP class and instance UIDs in dataset."));
+		throw StoreRejected(_("No SOP class and instance UIDs in dataset."));
 	}
-*/
+
 	/* figure out which of the accepted presentation contexts should be used */
-	DcmXfer filexfer(set->getOriginalXfer());
+	presId = 0;
+
+	/* the compressed context is used if the codec takes the pixel data */
+	E_TransferSyntax compressed =
+		compression_transfer_syntax(connection_->compression);
+	if (compressed != EXS_Unknown) {
+		presId = acceptedContext( association, sopClass, compressed);
+		if (presId && !set->canWriteXfer(compressed) &&
+			!compress_dataset( *set, connection_->compression)) {
+			OFLOG_DEBUG( app.log, "Pixel data can not be compressed, "
+				"sending uncompressed");
+			presId = 0;
+		}
+	}
 
-	/* special case: if the file uses an unencapsulated transfer syntax (uncompressed
-	 * or deflated explicit VR) and we prefer deflated explicit VR, then try
-	 * to find a presentation context for deflated explicit VR first.
-	*/
-	if (filexfer.isNotEncapsulated()) {
-        filexfer = EXS_DeflatedLittleEndianExplicit;
-    }
+	if (presId == 0) {
+		DcmXfer filexfer(set->getOriginalXfer());
 
-	if (filexfer.getXfer() != EXS_Unknown)
-		presId = ASC_findAcceptedPresentationContextID( association_, sopClass,
-			filexfer.getXferID());
-    else
-		presId = ASC_findAcceptedPresentationContextID( association_, sopClass);
+		/* special case: if the file uses an unencapsulated transfer syntax (uncompressed
+		 * or deflated explicit VR) and we prefer deflated explicit VR, then try
+		 * to find a presentation context for deflated explicit VR first.
+		*/
+		if (filexfer.isNotEncapsulated())
+			filexfer = EXS_DeflatedLittleEndianExplicit;
+
+		if (filexfer.getXfer() != EXS_Unknown)
+			presId = ASC_findAcceptedPresentationContextID( association,
+				sopClass, filexfer.getXferID());
+		else
+			presId = ASC_findAcceptedPresentationContextID( association,
+				sopClass);
+	}
 
     if (presId == 0) {
         const char *modalityName = dcmSOPClassUIDToModality(sopClass);
@@ -855,14 +1250,27 @@ StoreCommand::run( Dataset* dataset,
 			modalityName = "unknown SOP class";
         OFLOG_DEBUG( app.log, "No presentation context for: " << modalityName
 			<< " " << sopClass);
-        throw Exception(_("Presentation context is absent."));
+        throw StoreRejected(_("Presentation context is absent."));
     }
 
+	/* a compressed dataset is decompressed for an uncompressed context */
+	{
+		T_ASC_PresentationContext pc;
+		ASC_findAcceptedPresentationContext( association->params, presId, &pc);
+		E_TransferSyntax netxfer = DcmXfer(pc.acceptedTransferSyntax).getXfer();
+		if (!set->canWriteXfer(netxfer)) {
+			set->chooseRepresentation( netxfer, 0);
+			if (!set->canWriteXfer(netxfer))
+				throw StoreRejected(_("Unable to convert the dataset to the "
+					"negotiated transfer syntax."));
+		}
+	}
+
     /* if required, dump general information concerning transfer syntaxes */
 	if (app.debug) {
 		DcmXfer fileTransfer(set->getOriginalXfer());
 		T_ASC_PresentationContext pc;
-		ASC_findAcceptedPresentationContext( association_->params, presId, &pc);
+		ASC_findAcceptedPresentationContext( association->params, presId, &pc);
         DcmXfer netTransfer(pc.acceptedTransferSyntax);
         OFLOG_DEBUG( app.log, "Transfer: " <<
 			dcmFindNameOfUID(fileTransfer.getXferID()) << " -> " <<
@@ -882,20 +1290,10 @@ StoreCommand::run( Dataset* dataset,
 		<< "(" << dcmSOPClassUIDToModality(sopClass) << ")");
 
 	/* finally conduct transmission of data */
-	cond = DIMSE_storeUser( association_, presId, &req,
+	cond = DIMSE_storeUser( association, presId, &req,
 		NULL, set, callback, NULL, DIMSE_BLOCKING, 0,
 		&rsp, &statusDetail, NULL, dataset->size());
 
-	/*
-	 * If store command completed normally, with a status
-	 * of success or some warning then the image was accepted.
-	 */
-	if (cond == EC_Normal &&
-		(rsp.DimseStatus == STATUS_Success ||
-		DICOM_WARNING_STATUS(rsp.DimseStatus))) {
-		;
-	}
-
 	/* dump some more general information */
 	if (cond == EC_Normal) {
 		if (app.debug)
@@ -904,6 +1302,7 @@ StoreCommand::run( Dataset* dataset,
 	else {
 		OFLOG_DEBUG( app.log, "Dataset store failed");
 		DimseCondition::dump(cond);
+		delete statusDetail;
 		throw Exception(cond.text());
 	}
 
@@ -914,6 +1313,24 @@ StoreCommand::run( Dataset* dataset,
 		delete statusDetail;
     }
 
+	/*
+	 * If store command completed normally, with a status
+	 * of success or some warning then the image was accepted.
+	 * Out of resources may pass, any other failure is final.
+	 */
+	if (rsp.DimseStatus != STATUS_Success &&
+		!DICOM_WARNING_STATUS(rsp.DimseStatus)) {
+		std::ostringstream status;
+		status << std::hex << std::setw(4) << std::setfill('0')
+			<< rsp.DimseStatus;
+		Glib::ustring message = Glib::ustring::compose(
+			_("Server has refused the dataset, status 0x%1."), status.str());
+		OFLOG_DEBUG( app.log, message);
+		if ((rsp.DimseStatus & 0xff00) == STATUS_STORE_Refused_OutOfResources)
+			throw Exception(message);
+		throw StoreRejected(message);
+	}
+
     return static_cast<bool>(cond.good());
 }
 
@@ -1004,8 +1421,8 @@ MoveCommand::~MoveCommand()
 }
 
 bool
-MoveCommand::run( const DcmDataset& query, const char* filename,
-	DIMSE_StoreProviderCallback callback) throw(Exception)
+MoveCommand::run( const DcmDataset& query,
+	StoreReceiver* receiver) throw(Exception)
 {
 	T_ASC_PresentationContextID presId;
 	T_DIMSE_C_MoveRQ req;
@@ -1016,8 +1433,6 @@ MoveCommand::run( const DcmDataset& query, const char* filename,
 	DcmDataset* statusDetail = 0;
 	CallbackInfo callbackData;
 
-	store_provider_callback = callback ? callback : &storeSCPCallback;
-	cmove_filename = filename;
 	sopClass = query_syntax[query_model_].move_syntax;
 
 	// which presentation context should be used
@@ -1031,6 +1446,8 @@ MoveCommand::run( const DcmDataset& query, const char* filename,
 
 	callbackData.assoc = association_;
 	callbackData.presId = presId;
+	callbackData.receiver = receiver;
+	callbackData.cancel_sent = false;
 
 	req.MessageID = msgId;
 
@@ -1039,11 +1456,12 @@ MoveCommand::run( const DcmDataset& query, const char* filename,
 	req.DataSetType = DIMSE_DATASET_PRESENT;
 
 	/* set the destination to be me */
-//	ASC_getAPTitles( association_->params, req.MoveDestination, NULL, NULL);
+	OFStandard::strlcpy( req.MoveDestination, app.ae_title.c_str(),
+		sizeof(req.MoveDestination));
 
 	OFCondition cond = DIMSE_moveUser( association_, presId, &req, dataset,
 		moveCallback, &callbackData, DIMSE_BLOCKING, 0, network_, subOpCallback,
-        NULL, &rsp, &statusDetail, &rspIds, OFTrue);
+        receiver, &rsp, &statusDetail, &rspIds, OFTrue);
 
 	if (cond == EC_Normal) {
 		OFString temp_str;
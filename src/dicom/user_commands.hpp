@@ -17,18 +17,58 @@
 
 #pragma once
 
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glibmm/thread.h>
+
 // files from src directory begin
 #include "dcmtk_defines.hpp"
 #include "exceptions.hpp"
 // files from src directory begin
 
+#include "server.hpp"
 #include "utils.hpp"
 
 namespace ScanAmati {
 
 namespace DICOM {
 
-struct Server;
+/**
+ * Receiver of the datasets of the C-MOVE store sub-operations.
+ *
+ * The methods are called in the thread running MoveCommand::run().
+ */
+class StoreReceiver {
+public:
+	virtual ~StoreReceiver() {}
+
+	/** Return false to refuse the dataset being received. */
+	virtual bool accepting() { return true; }
+	/** Return true to cancel the C-MOVE, asked on every move response. */
+	virtual bool cancelled() { return false; }
+	/** Bytes of the dataset being received. */
+	virtual void receiving( unsigned long bytes, unsigned long total) {}
+	/** \brief A dataset has been received.
+	 *
+	 * \param fileformat The dataset, the receiver owns it.
+	 * \param name       File name made of the modality and SOP instance.
+	 */
+	virtual void received( DcmFileFormat* fileformat,
+		const std::string& name) = 0;
+	/** Sub-operations counts of a C-MOVE response. */
+	virtual void moved( unsigned int remaining, unsigned int completed,
+		unsigned int failed, unsigned int warning) {}
+};
+
+/** \brief Answer a C-STORE or C-ECHO request received on an association.
+ *
+ * Stored datasets go to the receiver or to the temporary directory.
+ */
+OFCondition serve_command( T_ASC_Association* assoc, T_DIMSE_Message* msg,
+	T_ASC_PresentationContextID presID, StoreReceiver* receiver);
 
 class UserCommand {
 public:
@@ -40,6 +80,8 @@ public:
 		char* imageFileName;
 		DcmFileFormat* dcmff;
 		T_ASC_Association* assoc;
+		StoreReceiver* receiver;
+		bool accepted; // the dataset goes to the receiver
 	};
 
 protected:
@@ -54,14 +96,105 @@ public:
 	bool run() throw(Exception);
 };
 
-class StoreCommand : public UserCommand {
+/**
+ * Storage associations kept open between C-STORE requests.
+ *
+ * An association is negotiated once for all the storage SOP classes
+ * and given back to the pool after every request, so successive
+ * datasets to the same server skip the connection and negotiation.
+ * Idle associations are released after the idle time. The pool may be
+ * used from several threads, every association is used by one command
+ * at a time.
+ */
+class AssociationPool {
+public:
+	struct Connection {
+		Connection();
+
+		std::string key; // called title and address of the server
+		CompressionType compression; // proposed for the image classes
+		T_ASC_Network* network;
+		T_ASC_Parameters* parameters; // owned by the association
+		T_ASC_Association* association;
+		time_t last_used;
+	};
+
+	static AssociationPool& instance();
+
+	/** \brief Take an idle association of the server or open a new one.
+	 *
+	 * \param reused Set if the association has been used before, the
+	 *               server may have closed it in the meantime.
+	 */
+	Connection* acquire( const Server& server, bool& reused)
+		throw(Exception);
+	Connection* open(const Server& server) throw(Exception);
+
+	/** Give the association back, an association which failed a
+	 * request is aborted instead. */
+	void release( Connection* connection, bool reusable = true);
+
+	/** Idle time in seconds, 0 releases associations after every
+	 * request. */
+	void set_idle_time(unsigned int seconds);
+	unsigned int idle_time() const;
+
+	/** Lossless transfer syntax proposed for the image SOP classes
+	 * besides the uncompressed ones. */
+	void set_compression(CompressionType compression);
+	CompressionType compression() const;
+
+	/** Release all the idle associations. */
+	void clear();
+
+	/** Release the associations idle for longer than the idle time,
+	 * called periodically while no request uses the pool. */
+	void expire();
+
+private:
+	AssociationPool();
+	~AssociationPool();
+
+	static std::string key( const Server& server,
+		CompressionType compression);
+	static void negotiate( const Server& server, Connection& connection)
+		throw(Exception);
+	static void close( Connection* connection, bool release);
+	static void close_expired(std::vector<Connection*> expired);
+
+	typedef std::multimap< std::string, Connection*> IdleMap;
+
+	void take_expired(std::vector<Connection*>& expired);
+
+	IdleMap idle_;
+	unsigned int idle_time_;
+	CompressionType compression_;
+	mutable Glib::Mutex mutex_;
+};
+
+/**
+ * The server has refused the dataset or can not take it at all, sending
+ * it again does not help. The association stays usable.
+ */
+class StoreRejected : public Exception {
+public:
+	explicit StoreRejected(const Glib::ustring& msg) : Exception(msg) {}
+};
+
+class StoreCommand {
 public:
 	StoreCommand(const Server&) throw(Exception);
 	virtual ~StoreCommand();
 	bool run( Dataset* dataset,
 		DIMSE_StoreUserCallback callback) throw(Exception);
 protected:
-	T_ASC_Association *association_;
+	bool store( Dataset* dataset,
+		DIMSE_StoreUserCallback callback) throw(Exception);
+
+	Server server_;
+	AssociationPool::Connection* connection_;
+	bool reused_; // the association served a previous command
+	bool failed_;
 };
 
 class MoveCommand : public UserCommand {
@@ -74,8 +207,9 @@ public:
 	MoveCommand( const Server&,
 		QueryModel query_model = MODEL_PATIENT_ROOT) throw(Exception);
 	virtual ~MoveCommand();
-	bool run( const DcmDataset& query, const char* filename = 0,
-		DIMSE_StoreProviderCallback callback = 0) throw(Exception);
+	/** Datasets are written to the temporary directory without receiver. */
+	bool run( const DcmDataset& query,
+		StoreReceiver* receiver = 0) throw(Exception);
 protected:
 	T_ASC_Association *association_;
 	QueryModel query_model_;
@@ -15,6 +15,17 @@
  *      MA 02110-1301, USA.
  */
 
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/dcmdata/dcrleerg.h>
+
+#include <config.h>
+
+#ifdef HAVE_DCMTK_CODECS
+#include <dcmtk/dcmjpeg/djdecode.h>
+#include <dcmtk/dcmjpls/djdecode.h>
+#include <dcmtk/dcmjpls/djencode.h>
+#endif
+
 #include "utils.hpp"
 
 namespace {
@@ -158,6 +169,73 @@ format_oftime(const OFTime& time)
 	return str;
 }
 
+void
+register_codecs()
+{
+	DcmRLEEncoderRegistration::registerCodecs();
+	DcmRLEDecoderRegistration::registerCodecs();
+#ifdef HAVE_DCMTK_CODECS
+	DJLSEncoderRegistration::registerCodecs();
+	DJLSDecoderRegistration::registerCodecs();
+	// lossless JPEG is accepted from other stations
+	DJDecoderRegistration::registerCodecs();
+#endif
+}
+
+void
+cleanup_codecs()
+{
+	DcmRLEEncoderRegistration::cleanup();
+	DcmRLEDecoderRegistration::cleanup();
+#ifdef HAVE_DCMTK_CODECS
+	DJLSEncoderRegistration::cleanup();
+	DJLSDecoderRegistration::cleanup();
+	DJDecoderRegistration::cleanup();
+#endif
+}
+
+/**
+ * JPEG-LS is taken for none without the codec, RLE is a part of the
+ * DCMTK data library.
+ */
+CompressionType
+compression_type(const Glib::ustring& name)
+{
+#ifdef HAVE_DCMTK_CODECS
+	if (name == "jpeg-ls")
+		return COMPRESSION_JPEG_LS;
+#endif
+	if (name == "rle")
+		return COMPRESSION_RLE;
+	else
+		return COMPRESSION_NONE;
+}
+
+E_TransferSyntax
+compression_transfer_syntax(CompressionType compression)
+{
+	switch (compression) {
+	case COMPRESSION_JPEG_LS:
+		return EXS_JPEGLSLossless;
+	case COMPRESSION_RLE:
+		return EXS_RLELossless;
+	case COMPRESSION_NONE:
+	default:
+		return EXS_Unknown;
+	}
+}
+
+bool
+compress_dataset( DcmDataset& dataset, CompressionType compression)
+{
+	E_TransferSyntax xfer = compression_transfer_syntax(compression);
+	if (xfer == EXS_Unknown)
+		return false;
+
+	OFCondition cond = dataset.chooseRepresentation( xfer, 0);
+	return cond.good() && dataset.canWriteXfer(xfer);
+}
+
 unsigned long
 Dataset::size( const E_TransferSyntax xfer, const E_EncodingType enctype)
 {
@@ -115,8 +115,28 @@ Glib::ustring format_person_sex( SexType sex, SexStringType type);
 
 Glib::ustring format_oftime(const OFTime& time);
 
+/** Register the lossless encoders and decoders of DCMTK. */
+void register_codecs();
+void cleanup_codecs();
+
+/** \brief Compression of a preferences value.
+ *
+ * \param name "none", "jpeg-ls" or "rle".
+ */
+CompressionType compression_type(const Glib::ustring& name);
+E_TransferSyntax compression_transfer_syntax(CompressionType);
+
+/** \brief Add the compressed representation of the pixel data.
+ *
+ * \return false if the codec refuses the pixel data, the dataset can
+ *         only be written uncompressed then.
+ */
+bool compress_dataset( DcmDataset& dataset, CompressionType compression);
+
 class Dataset : public DcmDataset {
 public:
+	Dataset() {}
+	explicit Dataset(const DcmDataset& dataset) : DcmDataset(dataset) {}
 	unsigned long size(
 		const E_TransferSyntax xfer = EXS_LittleEndianImplicit,
 		const E_EncodingType enctype = EET_UndefinedLength);
@@ -33,6 +33,20 @@ File::write_image_data( DcmDataset* dataset,
 	status = dataset->putAndInsertUint16( DCM_Columns, image->width());
 	if (!status.good())
 		return false;
+
+	// the stored bits and the window follow the detector resolution
+	unsigned int bits = image->adc_bits();
+	status = dataset->putAndInsertUint16( DCM_BitsStored, bits);
+	if (status.good())
+		status = dataset->putAndInsertUint16( DCM_HighBit, bits - 1);
+	if (status.good())
+		status = dataset->putAndInsertString( DCM_WindowCenter,
+			Glib::ustring::format(1 << (bits - 1)).c_str());
+	if (status.good())
+		status = dataset->putAndInsertString( DCM_WindowWidth,
+			Glib::ustring::format(1 << bits).c_str());
+	if (!status.good())
+		return false;
 	
 	if (data) {
 		status = dataset->putAndInsertUint16Array( DCM_PixelData, data,
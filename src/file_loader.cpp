@@ -18,10 +18,20 @@
 #include <gtkmm/filefilter.h>
 #include <glibmm/i18n.h>
 
+#include <dcmtk/dcmdata/dcfcache.h>
+
 #include "global_strings.hpp"
+#include "scanner/geometry.hpp"
 #include "file.hpp"
 #include "file_loader.hpp"
 
+namespace {
+
+// longer values are read from the file when they are accessed
+const Uint32 lazy_read_length = 4096;
+
+} // namespace
+
 namespace ScanAmati {
 
 FileLoader::FileLoader( const std::string& filename,
@@ -52,6 +62,9 @@ FileLoader::load(FileLoadType type) throw(Exception)
 			else
 				;
 		}
+		else if (is_raw_file()) {
+			res = load_raw(file); // Studio raw file
+		}
 		else {
 			res = load_dcm( file, type); // DICOM file
 		}
@@ -64,12 +77,24 @@ FileLoader::load(FileLoadType type) throw(Exception)
 		signal_file_loaded_( filename_, file);
 }
 
+bool
+FileLoader::is_raw_file() const
+{
+	std::string::size_type pos = filename_.rfind('.');
+	if (pos == std::string::npos)
+		return false;
+
+	return !g_ascii_strcasecmp( filename_.c_str() + pos + 1, "raw");
+}
+
 Image::SummaryData
 FileLoader::create_image_summary(const Image::DataSharedPtr& image)
 {
 	Image::SummaryData summary;
 	summary.raw_data() = image;
 	summary.fill_image_buffer();
+	if (image)
+		summary.set_chip_codes(Scanner::image_chip_codes(image->width()));
 	return summary;
 }
 
@@ -91,39 +116,28 @@ FileLoader::load_raw(File& file) throw(Exception)
 }
 
 bool
-FileLoader::load_dcm( File& file, FileLoadType) throw(Exception)
+FileLoader::load_dcm( File& file, FileLoadType type) throw(Exception)
 {
 	Image::DataSharedPtr image;
 	OFCondition result;
 
 	DcmFileFormat fileformat;
 
-	result = fileformat.loadFile(filename_.c_str());
+	// the pixel data are not read with the header
+	result = fileformat.loadFile( filename_.c_str(), EXS_Unknown,
+		EGL_noChange, lazy_read_length);
 	if (result.bad()) {
 		throw Exception(result.text());
 	}
 
 	DcmDataset* dataset = fileformat.getDataset();
 	if (dataset) {
-		Uint16 h, w;
-		result = dataset->findAndGetUint16( DCM_Rows, h); // height
-		if (result.bad())
-			throw Exception(_("Unable to load image height."));
-
-		result = dataset->findAndGetUint16( DCM_Columns, w); // width
-		if (result.bad())
-			throw Exception(_("Unable to load image width."));
-			
-		const Uint16* pix;
-		result = dataset->findAndGetUint16Array( DCM_PixelData, pix);
-		if (result.good()) {
-			const gint16* data = reinterpret_cast<const gint16*>(pix);
-			if (data)
-				image = Image::Data::create_from_data( w, h, data);
+		if (type == LOAD_INFO) {
+			file = File(DICOM::SummaryInfo(dataset));
+			return true;
 		}
-		else
-			throw Exception(_("Unable to load image data."));
 
+		image = load_pixel_data(dataset);
 		if (image) {
 			Image::SummaryData summary = create_image_summary(image);
 			file = File( summary, DICOM::SummaryInfo(dataset));
@@ -134,6 +148,66 @@ FileLoader::load_dcm( File& file, FileLoadType) throw(Exception)
 	return false;
 }
 
+/**
+ * Uncompressed pixel data are read from the file straight into the
+ * image buffer, compressed pixel data are decoded by the codecs first.
+ */
+Image::DataSharedPtr
+FileLoader::load_pixel_data(DcmDataset* dataset) throw(Exception)
+{
+	Image::DataSharedPtr image;
+	OFCondition result;
+
+	Uint16 h, w;
+	result = dataset->findAndGetUint16( DCM_Rows, h); // height
+	if (result.bad())
+		throw Exception(_("Unable to load image height."));
+
+	result = dataset->findAndGetUint16( DCM_Columns, w); // width
+	if (result.bad())
+		throw Exception(_("Unable to load image width."));
+
+	if (!w || !h)
+		throw Exception(_("Unable to load image data."));
+
+	DcmElement* element = 0;
+	result = dataset->findAndGetElement( DCM_PixelData, element);
+	if (result.bad() || !element)
+		throw Exception(_("Unable to load image data."));
+
+	if (!DcmXfer(dataset->getOriginalXfer()).isEncapsulated()) {
+		Uint32 length = w * h * sizeof(gint16);
+		if (element->getLength() < length)
+			throw Exception(_("Unable to load image data."));
+
+		image = Image::Data::create( w, h);
+
+		DcmFileCache cache;
+		result = element->getPartialValue( image->data(), 0, length, &cache);
+		if (result.bad())
+			throw Exception(_("Unable to load image data."));
+	}
+	else {
+		const Uint16* pix = 0;
+		result = dataset->chooseRepresentation( EXS_LittleEndianExplicit, 0);
+		if (result.good())
+			result = dataset->findAndGetUint16Array( DCM_PixelData, pix);
+		if (result.bad() || !pix)
+			throw Exception(_("Unable to decompress image data."));
+
+		image = Image::Data::create_from_data( w, h,
+			reinterpret_cast<const gint16*>(pix));
+	}
+
+	// images saved before the resolution was recorded keep the default
+	Uint16 bits;
+	result = dataset->findAndGetUint16( DCM_BitsStored, bits);
+	if (result.good() && bits > 0 && bits < 16)
+		image->set_adc_bits(bits);
+
+	return image;
+}
+
 sigc::signal< void, const std::string&, File&>
 FileLoader::signal_file_loaded()
 {
@@ -33,7 +33,7 @@ namespace ScanAmati {
 struct File;
 
 enum FileLoadType {
-	LOAD_INFO, // Load only dicom summary information
+	LOAD_INFO, // Load only dicom summary information, pixels stay on disk
 	LOAD_ALL // load everything
 };
 
@@ -57,7 +57,9 @@ public:
 
 private:
 	bool load_dcm( File& file, FileLoadType) throw(Exception);
+	Image::DataSharedPtr load_pixel_data(DcmDataset*) throw(Exception);
 	bool load_raw(File& file) throw(Exception);
+	bool is_raw_file() const;
 	Image::SummaryData create_image_summary(const Image::DataSharedPtr&);
 
 	sigc::signal< void, const std::string&, File&> signal_file_loaded_;
@@ -20,11 +20,13 @@
 #include <glibmm/regex.h>
 
 #include "dicom/summary_information.hpp"
+#include "dicom/utils.hpp"
 
 #include <dcmtk/dcmdata/dctk.h>
 
 #include "global_strings.hpp"
 #include "application.hpp"
+#include "file.hpp"
 #include "file_saver.hpp"
 
 namespace ScanAmati {
@@ -33,8 +35,13 @@ FileSaver::FileSaver(const std::string& filename,
 	const Gtk::FileFilter* filter)
 	:
 	filename_(filename),
-	filter_(filter)
+	filter_(filter),
+	compression_(DICOM::COMPRESSION_NONE)
 {
+	if (app.prefs.has_key( "Files", "dicom-compression"))
+		compression_ = DICOM::compression_type(app.prefs.get<Glib::ustring>(
+			"Files", "dicom-compression"));
+
 	bool res = false;
 	Glib::ustring name = filter_->get_name();
 	std::string key = name.collate_key();
@@ -123,16 +130,17 @@ FileSaver::save_file_dcm( const Image::DataSharedPtr& image,
 
 	info.save(dataset);
 
-	Uint16* data = reinterpret_cast<Uint16*>(image->data());
+	if (!File::write_image_data( dataset, image))
+		return false;
 
-	dataset->putAndInsertUint16( DCM_Rows, image->height());
-	dataset->putAndInsertUint16( DCM_Columns, image->width());
+	if (image->data()) {
+		// uncompressed if the codec does not take the pixel data
+		E_TransferSyntax xfer = EXS_LittleEndianExplicit;
+		if (DICOM::compress_dataset( *dataset, compression_))
+			xfer = DICOM::compression_transfer_syntax(compression_);
 
-	if (data) {
-		dataset->putAndInsertUint16Array( DCM_PixelData, data,
-			image->width() * image->height());
 		OFCondition status = fileformat.saveFile( filename_.c_str(),
-			EXS_LittleEndianExplicit, EET_UndefinedLength, EGL_withGL);
+			xfer, EET_UndefinedLength, EGL_withGL);
 		if (!status.good())
 			return false;
 	}
@@ -22,6 +22,7 @@
 #include <string>
 
 #include "image/summary_data.hpp"
+#include "dicom/typedefs.hpp"
 #include "exceptions.hpp"
 
 namespace Gtk {
@@ -71,6 +72,7 @@ private:
 
 	std::string filename_;
 	const Gtk::FileFilter* filter_;
+	DICOM::CompressionType compression_; // of DICOM files
 
 	sigc::signal< void, const std::string&> signal_file_saved_;
 };
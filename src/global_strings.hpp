@@ -54,6 +54,11 @@ const char* const lining_file_extension = "lining";
 const char* const bad_strips_file_extension = "bad_strips";
 const char* const dicom_servers_file = "dicom_servers";
 const char* const radiation_output_file = "radiation_output";
+const char* const thumbnails_dir = "thumbnails";
+const char* const thumbnail_file_extension = "ppm";
+const char* const spool_dir = "spool";
+const char* const index_file = "index";
+const char* const received_dir = "received";
 
 const char* const sound_caution_filename = SCANAMATI_PKGDATADIR
 	G_DIR_SEPARATOR_S "sounds" G_DIR_SEPARATOR_S "caution.ogg";
@@ -104,6 +109,8 @@ const char* const builder_dicom_information_dialog_filename = SCANAMATI_PKGDATAD
 
 const char* const builder_conquest_archive_dialog_filename = SCANAMATI_PKGDATADIR
 	G_DIR_SEPARATOR_S "ui" G_DIR_SEPARATOR_S "conquest-archive-dialog.glade";
+const char* const builder_local_search_dialog_filename = SCANAMATI_PKGDATADIR
+	G_DIR_SEPARATOR_S "ui" G_DIR_SEPARATOR_S "local-search-dialog.glade";
 
 const char* const builder_person_name_dialog_filename = SCANAMATI_PKGDATADIR
 	G_DIR_SEPARATOR_S "ui" G_DIR_SEPARATOR_S "person-name-dialog.glade";
@@ -117,6 +124,7 @@ const char* const conf_key_window_position_x = "window-position-x";
 const char* const conf_key_window_position_y = "window-position-y";
 const char* const conf_key_window_vpaned_position = "window-vpaned-position";
 const char* const conf_key_window_hpaned_position = "window-hpaned-position";
+const char* const conf_key_image_store_memory_size = "image-store-memory-size";
 
 // Dialog window configure templates
 const char* const conf_key_dialog_width = "-dialog-width";
@@ -133,18 +141,21 @@ const char* const conf_key_state_chip_capacity = "chip-capacity";
 const char* const conf_key_state_temperature_control = "temperature-control";
 const char* const conf_key_state_temperature_average = "temperature-average";
 const char* const conf_key_state_temperature_spread = "temperature-spread";
+const char* const conf_key_state_chips = "chips";
+const char* const conf_key_state_adc_resolution = "adc-resolution";
+const char* const conf_key_state_movement_ramp = "movement-ramp";
 
-const char array_chip_codes[SCANNER_CHIPS] = {
-#if SCANNER_CHIPS == 16
+const char array_chip_codes_16[16] = {
 	'0', '1', '2', '3',
 	'4', '5', '6', '7',
 	'8', '9', 'A', 'B',
 	'C', 'D', 'E', 'F'
-#elif SCANNER_CHIPS == 12
+};
+
+const char array_chip_codes_12[12] = {
 	'2', '3', '4', '5',
 	'6', '7', '8', '9',
 	'A', 'B', 'C', 'D'
-#endif
 };
 
 const char* const handshake_message = "Welcome";
@@ -0,0 +1,70 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include <unistd.h>
+#include <glibmm/thread.h>
+
+#include "bands.hpp"
+
+namespace {
+
+const unsigned int max_threads = 8;
+const unsigned int min_band = 64; // rows or columns per thread
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace Image {
+
+std::vector<Band>
+split_bands( unsigned int size, unsigned int threads)
+{
+	if (!threads) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? cpus : 1;
+	}
+	threads = std::min( threads, max_threads);
+	threads = std::max( 1u, std::min( threads, size / min_band));
+
+	std::vector<Band> bands;
+	unsigned int band = (size + threads - 1) / threads;
+	for ( unsigned int begin = 0; begin < size; begin += band)
+		bands.push_back(Band( begin, std::min( begin + band, size)));
+	return bands;
+}
+
+void
+run_jobs(const std::vector< sigc::slot<void> >& jobs)
+{
+	std::vector<Glib::Thread*> workers;
+	for ( unsigned int i = 1; i < jobs.size(); ++i)
+		workers.push_back(Glib::Thread::create( jobs[i], true));
+
+	if (!jobs.empty())
+		jobs[0]();
+
+	for ( std::vector<Glib::Thread*>::iterator iter = workers.begin();
+		iter != workers.end(); ++iter)
+		(*iter)->join();
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,46 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include <sigc++/slot.h>
+
+namespace ScanAmati {
+
+namespace Image {
+
+typedef std::pair< unsigned int, unsigned int> Band; // [first, second)
+
+/** \brief Split rows or columns between threads.
+ *
+ * \param size    Rows or columns to split.
+ * \param threads Wanted threads, 0 for the number of processors.
+ * \return bands of at least 64 rows or columns, 8 bands at most.
+ */
+std::vector<Band> split_bands( unsigned int size, unsigned int threads);
+
+/**
+ * Runs the first job in the calling thread and the others in their
+ * own threads, returns when all of them are done.
+ */
+void run_jobs(const std::vector< sigc::slot<void> >& jobs);
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -147,6 +147,7 @@ Calibration::calibrate(const DataSharedPtr& image)
 	std::vector<double> column_tmp(map_.size());
 
 	DataSharedPtr result = Data::create( image->width(), image->height());
+	result->set_adc_bits(image->adc_bits());
 
 	std::vector<guint> all_strips(image->width());
 
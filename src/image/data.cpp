@@ -29,20 +29,10 @@
 
 
 #include "data.hpp"
+#include "expression.hpp"
 
 namespace {
 
-gint16
-normalize_value(gint16 value)
-{
-	if (value <= SCANNER_ADC_COUNT_MIN)
-		return 0;
-	else if (value >= SCANNER_ADC_COUNT_MAX)
-		return SCANNER_ADC_COUNT_MAX;
-	else
-		return value;
-}
-
 const double tension = 0.;
 
 } // namespace
@@ -51,6 +41,8 @@ namespace ScanAmati {
 
 namespace Image {
 
+const unsigned int Data::default_adc_bits = SCANNER_ADC_RESOLUTION;
+
 DataSharedPtr
 Data::create_from_data( unsigned int width, unsigned int height,
 	const gint16* data)
@@ -68,8 +60,10 @@ DataSharedPtr
 Data::create_from_shared(const DataSharedPtr& image)
 {
 	DataSharedPtr res;
-	if (image && !image->empty())
+	if (image && !image->empty()) {
 		res = create_from_data( image->width(), image->height(), image->data());
+		res->adc_bits_ = image->adc_bits_;
+	}
 
 	return res;
 }
@@ -78,6 +72,7 @@ Data::Data( unsigned int width, unsigned int height)
 	:
 	width_(width),
 	height_(height),
+	adc_bits_(default_adc_bits),
 	data_(0)
 {
 	assert(width_ * height_);
@@ -89,6 +84,7 @@ Data::Data( unsigned int width, unsigned int height,
 	:
 	width_(width),
 	height_(height),
+	adc_bits_(default_adc_bits),
 	data_(0)
 {
 	assert(width_ * height_);
@@ -103,6 +99,7 @@ Data::Data( unsigned int width, unsigned int height,
 	:
 	width_(width),
 	height_(height),
+	adc_bits_(default_adc_bits),
 	data_(0)
 {
 	assert(width_ * height_);
@@ -121,6 +118,7 @@ Data::Data(const Data& obj)
 	:
 	width_(obj.width_),
 	height_(obj.height_),
+	adc_bits_(obj.adc_bits_),
 	data_(0)
 {
 	if (!obj.empty()) {
@@ -136,6 +134,7 @@ Data::operator=(const Data& obj)
 		return *this;
 
 	this->clear();
+	this->adc_bits_ = obj.adc_bits_;
 
 	if (!obj.empty()) {
 		this->width_ = obj.width_;
@@ -375,12 +374,7 @@ Data::subtract_row(const DataVector& row)
 	if (row.size() != width_)
 		return false;
 
-	for ( unsigned int i = 0; i < height_; ++i) {
-		for ( unsigned int j = 0; j < width_; ++j) {
-			data_[width_ * i + j] -= row[j];
-		}
-	}
-	return true;
+	return assign(pixels(*this) - columns(row));
 }
 
 /**
@@ -399,11 +393,10 @@ Data::get_horizontal_part( unsigned int r1, unsigned int r2) const
 		return shared;
 
 	shared = create( width_, (r2 - r1));
+	shared->adc_bits_ = adc_bits_;
 
-	for( unsigned int i = 0; i < width_; i++) {
-		for( unsigned int j = r1, k = 0; j < r2; j++, k++)
-			shared->pixel( i, k) = data_[width_ * j + i];
-	}
+	// rows are contiguous
+	std::copy( data_ + width_ * r1, data_ + width_ * r2, shared->data());
 
 	return shared;
 }
@@ -424,10 +417,11 @@ Data::get_vertical_part( unsigned int c1, unsigned int c2) const
 		return shared;
 
 	shared = create((c2 - c1), height_);
+	shared->adc_bits_ = adc_bits_;
 
 	for ( unsigned int i = 0; i < height_; i++) {
-		for ( unsigned int j = c1, k = 0; j < c2; j++, k++)
-			shared->pixel( k, i) = data_[width_ * i + j];
+		const gint16* row = data_ + width_ * i;
+		std::copy( row + c1, row + c2, &shared->pixel( 0, i));
 	}
 
 	return shared;
@@ -448,8 +442,8 @@ Data::set_vertical_part( const DataSharedPtr& obj,
 		return false;
 
 	for ( unsigned int i = 0; i < height_; i++) {
-		for ( unsigned int j = c1, k = 0; j < c2; j++, k++)
-			data_[width_ * i + j] = obj->pixel( k, i);
+		const gint16* row = &obj->pixel( 0, i);
+		std::copy( row, row + (c2 - c1), data_ + width_ * i + c1);
 	}
 
 	return true;
@@ -458,13 +452,7 @@ Data::set_vertical_part( const DataSharedPtr& obj,
 bool
 Data::add_value(gint16 value)
 {
-	if (empty())
-		return false;
-
-	std::transform( data_, data_ + width_ * height_, data_,
-		std::bind2nd( std::plus<gint16>(), value));
-
-	return true;
+	return assign(pixels(*this) + value);
 }
 
 bool
@@ -482,7 +470,7 @@ Data::set_levels( double lower, double upper, double gamma)
 			image.columns(), image.rows());
 
 		for ( size_t i = 0; i < image.columns() * image.rows(); ++i) {
-			double pix = double(SCANNER_ADC_COUNT_MAX * pixels++->red) / USHRT_MAX;
+			double pix = double(adc_count_max() * pixels++->red) / USHRT_MAX;
 			pixel(i) = static_cast<gint16>(pix);
 		}
 	}
@@ -500,7 +488,7 @@ Data::image_buffer(std::vector<guint8>& buf) const
 		buf.resize(width_ * height_);
 		for ( const gint16* pos = begin(); pos != end(); ++pos) {
 			ptrdiff_t i = pos - begin();
-			double value = double(UCHAR_MAX * *pos) / SCANNER_ADC_COUNT_MAX;
+			double value = double(UCHAR_MAX * *pos) / adc_count_max();
 			buf[i] = static_cast<gint8>(value);
 		}
 		res = true;
@@ -511,12 +499,8 @@ Data::image_buffer(std::vector<guint8>& buf) const
 bool
 Data::normalize()
 {
-	if (empty())
-		return false;
-
-	std::transform( data_, data_ + width_ * height_, data_, normalize_value);
-
-	return true;
+	return assign(clamp( pixels(*this), SCANNER_ADC_COUNT_MIN,
+		adc_count_max()));
 }
 
 std::ostream&
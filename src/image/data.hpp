@@ -30,6 +30,9 @@ namespace Image {
 
 class Data;
 
+template <typename E>
+class Expression;
+
 typedef std::vector<gint16> DataVector;
 
 typedef std::tr1::shared_ptr<Data> DataSharedPtr;
@@ -51,6 +54,10 @@ public:
 	void clear();
 	unsigned int width() const { return width_; }
 	unsigned int height() const { return height_; }
+	/** ADC resolution of the detector the pixels come from. */
+	unsigned int adc_bits() const { return adc_bits_; }
+	gint16 adc_count_max() const { return (1 << adc_bits_) - 1; }
+	void set_adc_bits(unsigned int bits) { adc_bits_ = bits; }
 
 	bool shift_columns( ColumnsShiftDirectionType dir = COLUMNS_SHIFT_LEFT,
 		unsigned int times = 1);
@@ -77,6 +84,10 @@ public:
 
 	bool set_levels( double lower, double upper, double gamma);
 
+	/** Evaluate expression.hpp expression into the pixels in one pass. */
+	template <typename E>
+	bool assign(const Expression<E>& expression);
+
 	gint16& pixel( unsigned int column, unsigned int row);
 	gint16& pixel( unsigned int column, unsigned int row) const;
 	gint16& pixel(unsigned int pos) { return *(data_ + pos); }
@@ -95,7 +106,7 @@ public:
 	static DataSharedPtr create_from_shared(const DataSharedPtr& shared);
 
 protected:
-	Data() : width_(0), height_(0), data_(0) {}
+	Data() : width_(0), height_(0), adc_bits_(default_adc_bits), data_(0) {}
 	Data( unsigned int width, unsigned int height);
 	Data( unsigned int width, unsigned int height, const gint16* data);
 	Data( unsigned int width, unsigned int height, const DataVector& data);
@@ -103,8 +114,12 @@ protected:
 	Data(const Data& obj);
 	Data& operator=(const Data& obj);
 
+	/** Resolution of the images which do not record it. */
+	static const unsigned int default_adc_bits;
+
 	unsigned int width_;
 	unsigned int height_;
+	unsigned int adc_bits_;
 	gint16* data_;
 };
 
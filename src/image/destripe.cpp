@@ -0,0 +1,271 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include <sigc++/bind.h>
+#include <sigc++/functors/mem_fun.h>
+
+#include "bands.hpp"
+#include "destripe.hpp"
+
+namespace {
+
+void
+add_sums( std::vector<double>& to, const std::vector<double>& from)
+{
+	for ( unsigned int i = 0; i < to.size(); ++i)
+		to[i] += from[i];
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace Image {
+
+Destriper::ColumnSums::ColumnSums(unsigned int width)
+	:
+	count( width, 0.),
+	mean( width, 0.),
+	mean2( width, 0.),
+	pixel( width, 0.),
+	product( width, 0.)
+{
+}
+
+Destriper::Destriper( unsigned int radius, double rejection)
+	:
+	radius_(std::max( 1u, radius)),
+	rejection_(rejection)
+{
+}
+
+bool
+Destriper::estimate( const DataSharedPtr& image, unsigned int threads)
+{
+	if (!image || image->empty() || image->width() < 2 * radius_ + 1)
+		return false;
+
+	const unsigned int width = image->width();
+	std::vector<Band> bands = split_bands( image->height(), threads);
+	std::vector<ColumnSums> sums( bands.size(), ColumnSums(width));
+	std::vector< sigc::slot<void> > jobs(bands.size());
+
+	// residuals by columns
+	std::vector<float> residuals( size_t(width) * image->height());
+	for ( unsigned int i = 0; i < bands.size(); ++i)
+		jobs[i] = sigc::bind( sigc::mem_fun( *this,
+			&Destriper::store_residuals), image.get(), bands[i].first,
+			bands[i].second, &residuals);
+	run_jobs(jobs);
+
+	// median and median absolute deviation of every column, edges of
+	// objects spoil the mean and the standard deviation
+	centers_.resize(width);
+	limits_.resize(width);
+	std::vector<Band> columns = split_bands( width, bands.size());
+	jobs.resize(columns.size());
+	for ( unsigned int i = 0; i < columns.size(); ++i)
+		jobs[i] = sigc::bind( sigc::mem_fun( *this,
+			&Destriper::column_limits), image->height(), columns[i].first,
+			columns[i].second, &residuals);
+	run_jobs(jobs);
+	residuals.clear();
+
+	// line fit over the rows within the limits
+	jobs.resize(bands.size());
+	for ( unsigned int i = 0; i < bands.size(); ++i)
+		jobs[i] = sigc::bind( sigc::mem_fun( *this,
+			&Destriper::accumulate_fit), image.get(), bands[i].first,
+			bands[i].second, &sums[i]);
+	run_jobs(jobs);
+
+	ColumnSums& total = sums[0];
+	for ( unsigned int i = 1; i < sums.size(); ++i) {
+		add_sums( total.count, sums[i].count);
+		add_sums( total.mean, sums[i].mean);
+		add_sums( total.mean2, sums[i].mean2);
+		add_sums( total.pixel, sums[i].pixel);
+		add_sums( total.product, sums[i].product);
+	}
+
+	gains_.assign( width, 1.f);
+	offsets_.assign( width, 0.f);
+	scales_.assign( width, 1.f);
+	shifts_.assign( width, 0.f);
+
+	for ( unsigned int c = 0; c < width; ++c) {
+		double n = total.count[c];
+		if (n < 2.)
+			continue;
+
+		double mean = total.mean[c] / n;
+		double pixel = total.pixel[c] / n;
+		double variance = total.mean2[c] / n - mean * mean;
+		double covariance = total.product[c] / n - mean * pixel;
+
+		double gain = 1.;
+		// a gain needs the neighbours to change over the rows
+		if (variance > std::max( 1., 1e-4 * mean * mean)) {
+			gain = covariance / variance;
+			if (gain < .5 || gain > 2.)
+				gain = 1.;
+		}
+
+		gains_[c] = gain;
+		offsets_[c] = pixel - gain * mean;
+		scales_[c] = 1. / gain;
+		shifts_[c] = -offsets_[c] / gain;
+	}
+	return true;
+}
+
+bool
+Destriper::apply( const DataSharedPtr& image, unsigned int threads) const
+{
+	if (!image || image->empty() || image->width() != scales_.size())
+		return false;
+
+	std::vector<Band> bands = split_bands( image->height(), threads);
+	std::vector< sigc::slot<void> > jobs(bands.size());
+
+	for ( unsigned int i = 0; i < bands.size(); ++i)
+		jobs[i] = sigc::bind( sigc::mem_fun( *this,
+			&Destriper::correct_rows), image.get(), bands[i].first,
+			bands[i].second);
+	run_jobs(jobs);
+	return true;
+}
+
+/**
+ * Mean of the row within the radius around each column, the column
+ * itself is left out.
+ */
+void
+Destriper::neighbours_mean( const gint16* row, unsigned int width,
+	std::vector<gint32>& prefix, std::vector<float>& mean) const
+{
+	prefix[0] = 0;
+	for ( unsigned int i = 0; i < width; ++i)
+		prefix[i + 1] = prefix[i] + row[i];
+
+	for ( unsigned int i = 0; i < width; ++i) {
+		unsigned int left = (i > radius_) ? i - radius_ : 0;
+		unsigned int right = std::min( i + radius_ + 1, width);
+		mean[i] = float(prefix[right] - prefix[left] - row[i]) /
+			(right - left - 1);
+	}
+}
+
+void
+Destriper::store_residuals( const Data* image, unsigned int begin,
+	unsigned int end, std::vector<float>* residuals) const
+{
+	const unsigned int width = image->width();
+	const unsigned int height = image->height();
+	std::vector<gint32> prefix(width + 1);
+	std::vector<float> mean(width);
+
+	for ( unsigned int j = begin; j < end; ++j) {
+		const gint16* row = image->data() + size_t(j) * width;
+		neighbours_mean( row, width, prefix, mean);
+
+		for ( unsigned int i = 0; i < width; ++i)
+			(*residuals)[size_t(i) * height + j] = row[i] - mean[i];
+	}
+}
+
+/**
+ * Columns [begin, end), the residuals of each column are reordered.
+ */
+void
+Destriper::column_limits( unsigned int height, unsigned int begin,
+	unsigned int end, std::vector<float>* residuals)
+{
+	const double mad_sigma = 1.4826; // MAD to the standard deviation
+
+	for ( unsigned int i = begin; i < end; ++i) {
+		float* first = &(*residuals)[size_t(i) * height];
+		float* middle = first + height / 2;
+		float* last = first + height;
+
+		std::nth_element( first, middle, last);
+		float center = *middle;
+
+		for ( float* pos = first; pos != last; ++pos)
+			*pos = std::fabs(*pos - center);
+		std::nth_element( first, middle, last);
+
+		centers_[i] = center;
+		// at least one count, flat columns have no spread
+		limits_[i] = std::max( 1., rejection_ * mad_sigma * *middle);
+	}
+}
+
+void
+Destriper::accumulate_fit( const Data* image, unsigned int begin,
+	unsigned int end, ColumnSums* sums) const
+{
+	const unsigned int width = image->width();
+	std::vector<gint32> prefix(width + 1);
+	std::vector<float> mean(width);
+
+	for ( unsigned int j = begin; j < end; ++j) {
+		const gint16* row = image->data() + size_t(j) * width;
+		neighbours_mean( row, width, prefix, mean);
+
+		for ( unsigned int i = 0; i < width; ++i) {
+			double m = mean[i];
+			double p = row[i];
+			if (std::fabs(p - m - centers_[i]) > limits_[i])
+				continue;
+
+			sums->count[i] += 1.;
+			sums->mean[i] += m;
+			sums->mean2[i] += m * m;
+			sums->pixel[i] += p;
+			sums->product[i] += m * p;
+		}
+	}
+}
+
+void
+Destriper::correct_rows( Data* image, unsigned int begin,
+	unsigned int end) const
+{
+	const unsigned int width = image->width();
+	const float* scale = &scales_[0];
+	const float* shift = &shifts_[0];
+
+	for ( unsigned int j = begin; j < end; ++j) {
+		gint16* row = image->data() + size_t(j) * width;
+
+		for ( unsigned int i = 0; i < width; ++i) {
+			float value = row[i] * scale[i] + shift[i] + .5f;
+			value = (value < 0.f) ? 0.f : value;
+			value = (value > float(SHRT_MAX)) ? float(SHRT_MAX) : value;
+			row[i] = static_cast<gint16>(value);
+		}
+	}
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,93 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "data.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+/**
+ * Removal of vertical stripes caused by the gain and offset drift of
+ * single strips.
+ *
+ * Each pixel is compared with the mean of its row neighbours within
+ * the radius, which keeps the low frequency content of the row. For
+ * every column a line from the neighbour means to the pixels is fitted
+ * over the rows, rows where the column differs from its neighbours by
+ * more than the rejection limit times the robust spread of the column
+ * (edges of objects) are left out. The
+ * correction inverts the line of each column. Rows are split between
+ * several threads in both the estimation and the correction.
+ */
+class Destriper {
+
+public:
+	explicit Destriper( unsigned int radius = 8, double rejection = 2.5);
+
+	/** \brief Estimate the column gains and offsets of the image.
+	 *
+	 * Columns whose neighbour means hardly change over the rows get
+	 * an offset only.
+	 */
+	bool estimate( const DataSharedPtr& image, unsigned int threads = 0);
+
+	/** Correct the image in place with the estimated columns. */
+	bool apply( const DataSharedPtr& image, unsigned int threads = 0) const;
+
+	const std::vector<float>& gains() const { return gains_; }
+	const std::vector<float>& offsets() const { return offsets_; }
+
+private:
+	struct ColumnSums {
+		explicit ColumnSums(unsigned int width);
+
+		std::vector<double> count;
+		std::vector<double> mean; // sum of neighbours means
+		std::vector<double> mean2;
+		std::vector<double> pixel;
+		std::vector<double> product; // sum of pixel * neighbours mean
+	};
+
+	void neighbours_mean( const gint16* row, unsigned int width,
+		std::vector<gint32>& prefix, std::vector<float>& mean) const;
+	void store_residuals( const Data* image, unsigned int begin,
+		unsigned int end, std::vector<float>* residuals) const;
+	void column_limits( unsigned int height, unsigned int begin,
+		unsigned int end, std::vector<float>* residuals);
+	void accumulate_fit( const Data* image, unsigned int begin,
+		unsigned int end, ColumnSums* sums) const;
+	void correct_rows( Data* image, unsigned int begin,
+		unsigned int end) const;
+
+	unsigned int radius_;
+	double rejection_;
+	std::vector<float> limits_; // residual window of the fit
+	std::vector<float> centers_;
+	std::vector<float> gains_;
+	std::vector<float> offsets_;
+	std::vector<float> scales_; // 1 / gain
+	std::vector<float> shifts_; // - offset / gain
+};
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,203 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "data.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+/**
+ * Lazily evaluated per pixel expressions over Image::Data.
+ *
+ * An expression is built from image pixels, per column rows and
+ * constants and is evaluated in a single pass when it is assigned:
+ *
+ * \code
+ * image->assign(clamp( pixels(*image) - columns(pedestals) + offset,
+ *     0, image->adc_count_max()));
+ * \endcode
+ *
+ * Values are computed in 32 bits and stored as 16 bit pixels. All the
+ * nodes are inlined, so the compiler sees one plain loop per row.
+ */
+template <typename E>
+class Expression {
+
+public:
+	const E& derived() const { return static_cast<const E&>(*this); }
+};
+
+/** Pixels of an image, the image may be the assignment target too. */
+class Pixels : public Expression<Pixels> {
+
+public:
+	explicit Pixels(const Data& data) : data_(data.data()),
+		width_(data.width()), height_(data.height()) {}
+	gint32 operator()( size_t pos, unsigned int) const { return data_[pos]; }
+	bool check( unsigned int width, unsigned int height) const
+		{ return (width == width_) && (height == height_); }
+
+private:
+	const gint16* data_;
+	unsigned int width_;
+	unsigned int height_;
+};
+
+/** Row of values repeated down the image, one value per column. */
+class Columns : public Expression<Columns> {
+
+public:
+	explicit Columns(const DataVector& row) : row_(row) {}
+	gint32 operator()( size_t, unsigned int column) const
+		{ return row_[column]; }
+	bool check( unsigned int width, unsigned int) const
+		{ return row_.size() == width; }
+
+private:
+	const DataVector& row_;
+};
+
+class Scalar : public Expression<Scalar> {
+
+public:
+	Scalar(gint32 value) : value_(value) {}
+	gint32 operator()( size_t, unsigned int) const { return value_; }
+	bool check( unsigned int, unsigned int) const { return true; }
+
+private:
+	gint32 value_;
+};
+
+template <typename Op, typename L, typename R>
+class Binary : public Expression< Binary<Op, L, R> > {
+
+public:
+	Binary( const L& left, const R& right) : left_(left), right_(right) {}
+	gint32 operator()( size_t pos, unsigned int column) const
+		{ return Op::apply( left_( pos, column), right_( pos, column)); }
+	bool check( unsigned int width, unsigned int height) const
+		{ return left_.check( width, height) && right_.check( width, height); }
+
+private:
+	L left_;
+	R right_;
+};
+
+template <typename E>
+class Clamp : public Expression< Clamp<E> > {
+
+public:
+	Clamp( const E& expr, gint32 lower, gint32 upper)
+		: expr_(expr), lower_(lower), upper_(upper) {}
+	gint32 operator()( size_t pos, unsigned int column) const;
+	bool check( unsigned int width, unsigned int height) const
+		{ return expr_.check( width, height); }
+
+private:
+	E expr_;
+	gint32 lower_;
+	gint32 upper_;
+};
+
+template <typename E>
+inline
+gint32
+Clamp<E>::operator()( size_t pos, unsigned int column) const
+{
+	gint32 value = expr_( pos, column);
+	value = (value < lower_) ? lower_ : value;
+	return (value > upper_) ? upper_ : value;
+}
+
+struct AddOp {
+	static gint32 apply( gint32 a, gint32 b) { return a + b; }
+};
+
+struct SubtractOp {
+	static gint32 apply( gint32 a, gint32 b) { return a - b; }
+};
+
+struct MultiplyOp {
+	static gint32 apply( gint32 a, gint32 b) { return a * b; }
+};
+
+struct MinOp {
+	static gint32 apply( gint32 a, gint32 b) { return (a < b) ? a : b; }
+};
+
+struct MaxOp {
+	static gint32 apply( gint32 a, gint32 b) { return (a < b) ? b : a; }
+};
+
+inline Pixels pixels(const Data& data) { return Pixels(data); }
+inline Columns columns(const DataVector& row) { return Columns(row); }
+
+template <typename E>
+inline
+Clamp<E>
+clamp( const Expression<E>& expr, gint32 lower, gint32 upper)
+{
+	return Clamp<E>( expr.derived(), lower, upper);
+}
+
+#define SCANAMATI_IMAGE_BINARY_FUNCTION(name, Op) \
+template <typename L, typename R> \
+inline Binary<Op, L, R> \
+name( const Expression<L>& left, const Expression<R>& right) \
+{ return Binary<Op, L, R>( left.derived(), right.derived()); } \
+\
+template <typename L> \
+inline Binary<Op, L, Scalar> \
+name( const Expression<L>& left, gint32 right) \
+{ return Binary<Op, L, Scalar>( left.derived(), Scalar(right)); } \
+\
+template <typename R> \
+inline Binary<Op, Scalar, R> \
+name( gint32 left, const Expression<R>& right) \
+{ return Binary<Op, Scalar, R>( Scalar(left), right.derived()); }
+
+SCANAMATI_IMAGE_BINARY_FUNCTION(operator+, AddOp)
+SCANAMATI_IMAGE_BINARY_FUNCTION(operator-, SubtractOp)
+SCANAMATI_IMAGE_BINARY_FUNCTION(operator*, MultiplyOp)
+SCANAMATI_IMAGE_BINARY_FUNCTION(min, MinOp)
+SCANAMATI_IMAGE_BINARY_FUNCTION(max, MaxOp)
+
+#undef SCANAMATI_IMAGE_BINARY_FUNCTION
+
+template <typename E>
+bool
+Data::assign(const Expression<E>& expression)
+{
+	const E& expr = expression.derived();
+	if (empty() || !expr.check( width_, height_))
+		return false;
+
+	gint16* row = data_;
+	for ( unsigned int k = 0; k < height_; ++k, row += width_) {
+		size_t pos = size_t(k) * width_;
+		for ( unsigned int i = 0; i < width_; ++i)
+			row[i] = static_cast<gint16>(expr( pos + i, i));
+	}
+	return true;
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
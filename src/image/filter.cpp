@@ -0,0 +1,416 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include <sigc++/bind.h>
+#include <sigc++/functors/mem_fun.h>
+
+#include "bands.hpp"
+#include "filter.hpp"
+
+namespace {
+
+using ScanAmati::Image::Band;
+using ScanAmati::Image::Data;
+using ScanAmati::Image::run_jobs;
+using ScanAmati::Image::split_bands;
+
+const double smooth_sigma = 1.;
+const double sharpen_sigma = 2.;
+const double sharpen_amount = .8;
+
+const unsigned int tile_columns = 512; // columns pass tile width
+
+typedef std::pair< unsigned char, unsigned char> Comparator; // min, max
+typedef std::vector<Comparator> Network;
+
+// median of 9 wires ends in the wire 4
+const Comparator median9[] = {
+	Comparator( 1, 2), Comparator( 4, 5), Comparator( 7, 8),
+	Comparator( 0, 1), Comparator( 3, 4), Comparator( 6, 7),
+	Comparator( 1, 2), Comparator( 4, 5), Comparator( 7, 8),
+	Comparator( 0, 3), Comparator( 5, 8), Comparator( 4, 7),
+	Comparator( 3, 6), Comparator( 1, 4), Comparator( 2, 5),
+	Comparator( 4, 7), Comparator( 4, 2), Comparator( 6, 4),
+	Comparator( 4, 2)
+};
+
+inline
+gint16
+to_pixel(float value)
+{
+	value = std::floor(value + .5f);
+	return gint16(std::max( float(SHRT_MIN), std::min( value,
+		float(SHRT_MAX))));
+}
+
+inline
+int
+clamp_index( int index, int size)
+{
+	return std::max( 0, std::min( index, size - 1));
+}
+
+std::vector<float>
+gaussian_kernel(double sigma)
+{
+	int radius = std::max( 1, int(std::ceil(3. * sigma)));
+	std::vector<float> kernel(2 * radius + 1);
+
+	double sum = 0.;
+	for ( int i = -radius; i <= radius; ++i) {
+		double weight = std::exp(-i * i / (2. * sigma * sigma));
+		kernel[i + radius] = weight;
+		sum += weight;
+	}
+	for ( unsigned int i = 0; i < kernel.size(); ++i)
+		kernel[i] /= sum;
+	return kernel;
+}
+
+/**
+ * Batcher odd-even merge sort of n wires, n is a power of two.
+ */
+Network
+batcher_network(unsigned int n)
+{
+	Network network;
+	for ( unsigned int p = 1; p < n; p <<= 1)
+		for ( unsigned int k = p; k >= 1; k >>= 1)
+			for ( unsigned int j = k % p; j + k < n; j += 2 * k)
+				for ( unsigned int i = 0; i < std::min( k, n - j - k); ++i)
+					if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+						network.push_back(Comparator( i + j, i + j + k));
+	return network;
+}
+
+/**
+ * Comparators of the network the output wire depends on.
+ */
+Network
+prune_network( const Network& network, unsigned int output)
+{
+	std::vector<bool> needed( 256, false);
+	needed[output] = true;
+
+	Network result;
+	for ( Network::const_reverse_iterator iter = network.rbegin();
+		iter != network.rend(); ++iter) {
+		if (needed[iter->first] || needed[iter->second]) {
+			needed[iter->first] = true;
+			needed[iter->second] = true;
+			result.push_back(*iter);
+		}
+	}
+	std::reverse( result.begin(), result.end());
+	return result;
+}
+
+/**
+ * Median window as a sorting network. Wires past the window pixels hold
+ * the lowest and the highest pixel values in equal numbers (one more
+ * highest value for the odd padding), so the median of the pixels is
+ * the median of all the wires.
+ */
+struct MedianNetwork {
+	explicit MedianNetwork(unsigned int size);
+
+	unsigned int size; // window width and height
+	unsigned int pixels;
+	unsigned int lows; // wires of the lowest value after the pixels
+	unsigned int wires;
+	unsigned int output;
+	Network comparators;
+};
+
+MedianNetwork::MedianNetwork(unsigned int size)
+	:
+	size(size),
+	pixels(size * size),
+	lows(0),
+	wires(size * size),
+	output(size * size / 2)
+{
+	if (size == 3) {
+		comparators.assign( median9,
+			median9 + sizeof(median9) / sizeof(median9[0]));
+		return;
+	}
+
+	wires = 1;
+	while (wires < pixels)
+		wires <<= 1;
+	lows = (wires - pixels) / 2;
+	output = lows + pixels / 2;
+	comparators = prune_network( batcher_network(wires), output);
+}
+
+/**
+ * Rows and then columns pass of a gaussian kernel.
+ */
+class SeparableBlur {
+
+public:
+	SeparableBlur( const Data& image, double sigma);
+
+	void run(unsigned int threads);
+	const std::vector<float>& result() const { return blurred_; }
+
+private:
+	void blur_rows( unsigned int begin, unsigned int end);
+	void blur_columns( unsigned int begin, unsigned int end);
+
+	const Data& image_;
+	std::vector<float> kernel_;
+	std::vector<float> rows_; // rows pass output
+	std::vector<float> blurred_;
+};
+
+SeparableBlur::SeparableBlur( const Data& image, double sigma)
+	:
+	image_(image),
+	kernel_(gaussian_kernel(sigma)),
+	rows_( size_t(image.width()) * image.height()),
+	blurred_(rows_.size())
+{
+}
+
+void
+SeparableBlur::run(unsigned int threads)
+{
+	std::vector<Band> bands = split_bands( image_.height(), threads);
+
+	for ( int pass = 0; pass < 2; ++pass) {
+		void (SeparableBlur::*blur)( unsigned int, unsigned int) =
+			pass ? &SeparableBlur::blur_columns : &SeparableBlur::blur_rows;
+
+		std::vector< sigc::slot<void> > jobs;
+		for ( unsigned int i = 0; i < bands.size(); ++i)
+			jobs.push_back(sigc::bind( sigc::mem_fun( *this, blur),
+				bands[i].first, bands[i].second));
+		run_jobs(jobs);
+	}
+}
+
+void
+SeparableBlur::blur_rows( unsigned int begin, unsigned int end)
+{
+	int width = image_.width();
+	int radius = kernel_.size() / 2;
+	std::vector<float> padded(width + 2 * radius);
+
+	for ( unsigned int y = begin; y < end; ++y) {
+		const gint16* row = &image_.pixel( 0, y);
+		for ( int x = -radius; x < width + radius; ++x)
+			padded[x + radius] = row[clamp_index( x, width)];
+
+		float* out = &rows_[size_t(y) * width];
+		std::fill( out, out + width, 0.f);
+		for ( unsigned int k = 0; k < kernel_.size(); ++k) {
+			const float* in = &padded[k];
+			float weight = kernel_[k];
+			for ( int x = 0; x < width; ++x)
+				out[x] += weight * in[x];
+		}
+	}
+}
+
+void
+SeparableBlur::blur_columns( unsigned int begin, unsigned int end)
+{
+	int width = image_.width();
+	int height = image_.height();
+	int radius = kernel_.size() / 2;
+
+	for ( int left = 0; left < width; left += tile_columns) {
+		int columns = std::min( int(tile_columns), width - left);
+		for ( unsigned int y = begin; y < end; ++y) {
+			float* out = &blurred_[size_t(y) * width + left];
+			std::fill( out, out + columns, 0.f);
+			for ( unsigned int k = 0; k < kernel_.size(); ++k) {
+				int row = clamp_index( int(y) + int(k) - radius, height);
+				const float* in = &rows_[size_t(row) * width + left];
+				float weight = kernel_[k];
+				for ( int x = 0; x < columns; ++x)
+					out[x] += weight * in[x];
+			}
+		}
+	}
+}
+
+class MedianFilter {
+
+public:
+	MedianFilter( const Data& image, Data& result,
+		const MedianNetwork& network);
+
+	void filter_rows( unsigned int begin, unsigned int end);
+
+private:
+	const Data& image_;
+	Data& result_;
+	const MedianNetwork& network_;
+};
+
+MedianFilter::MedianFilter( const Data& image, Data& result,
+	const MedianNetwork& network)
+	:
+	image_(image),
+	result_(result),
+	network_(network)
+{
+}
+
+void
+MedianFilter::filter_rows( unsigned int begin, unsigned int end)
+{
+	int width = image_.width();
+	int height = image_.height();
+	int radius = network_.size / 2;
+
+	std::vector<gint16> padded(width + 2 * radius);
+	std::vector<gint16> wires( size_t(network_.wires) * width);
+
+	for ( unsigned int y = begin; y < end; ++y) {
+		gint16* wire = &wires[0];
+		for ( int dy = -radius; dy <= radius; ++dy) {
+			const gint16* row = &image_.pixel( 0,
+				clamp_index( int(y) + dy, height));
+			for ( int x = -radius; x < width + radius; ++x)
+				padded[x + radius] = row[clamp_index( x, width)];
+
+			for ( int dx = 0; dx < int(network_.size); ++dx, wire += width)
+				std::copy( &padded[dx], &padded[dx] + width, wire);
+		}
+
+		// the network mixes the padding wires with the pixels
+		for ( unsigned int i = network_.pixels; i < network_.wires;
+			++i, wire += width) {
+			gint16 value = (i < network_.pixels + network_.lows) ?
+				SHRT_MIN : SHRT_MAX;
+			std::fill( wire, wire + width, value);
+		}
+
+		for ( Network::const_iterator iter = network_.comparators.begin();
+			iter != network_.comparators.end(); ++iter) {
+			gint16* low = &wires[size_t(iter->first) * width];
+			gint16* high = &wires[size_t(iter->second) * width];
+			for ( int x = 0; x < width; ++x) {
+				gint16 a = low[x];
+				gint16 b = high[x];
+				low[x] = std::min( a, b);
+				high[x] = std::max( a, b);
+			}
+		}
+
+		const gint16* median = &wires[size_t(network_.output) * width];
+		std::copy( median, median + width, &result_.pixel( 0, y));
+	}
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace Image {
+
+DataSharedPtr
+gaussian_blur( const DataSharedPtr& image, double sigma,
+	unsigned int threads)
+{
+	if (!image || image->empty() || sigma <= 0.)
+		return DataSharedPtr();
+
+	SeparableBlur blur( *image, sigma);
+	blur.run(threads);
+
+	const std::vector<float>& blurred = blur.result();
+	DataSharedPtr result = Data::create( image->width(), image->height());
+	result->set_adc_bits(image->adc_bits());
+	gint16* pixel = result->data();
+	for ( size_t i = 0; i < blurred.size(); ++i)
+		pixel[i] = to_pixel(blurred[i]);
+	return result;
+}
+
+DataSharedPtr
+unsharp_mask( const DataSharedPtr& image, double sigma, double amount,
+	unsigned int threads)
+{
+	if (!image || image->empty() || sigma <= 0.)
+		return DataSharedPtr();
+
+	SeparableBlur blur( *image, sigma);
+	blur.run(threads);
+
+	const std::vector<float>& blurred = blur.result();
+	DataSharedPtr result = Data::create( image->width(), image->height());
+	result->set_adc_bits(image->adc_bits());
+	const gint16* source = image->data();
+	gint16* pixel = result->data();
+	float weight = amount;
+	for ( size_t i = 0; i < blurred.size(); ++i)
+		pixel[i] = to_pixel(source[i] + weight * (source[i] - blurred[i]));
+	return result;
+}
+
+DataSharedPtr
+median( const DataSharedPtr& image, unsigned int size, unsigned int threads)
+{
+	if (!image || image->empty() || (size != 3 && size != 5))
+		return DataSharedPtr();
+
+	MedianNetwork network(size);
+	DataSharedPtr result = Data::create( image->width(), image->height());
+	result->set_adc_bits(image->adc_bits());
+	MedianFilter median_filter( *image, *result, network);
+
+	std::vector<Band> bands = split_bands( image->height(), threads);
+	std::vector< sigc::slot<void> > jobs;
+	for ( unsigned int i = 0; i < bands.size(); ++i)
+		jobs.push_back(sigc::bind( sigc::mem_fun( median_filter,
+			&MedianFilter::filter_rows), bands[i].first, bands[i].second));
+	run_jobs(jobs);
+
+	return result;
+}
+
+DataSharedPtr
+filter( const DataSharedPtr& image, FilterType type, unsigned int threads)
+{
+	switch (type) {
+	case FILTER_MEDIAN_3:
+		return median( image, 3, threads);
+	case FILTER_MEDIAN_5:
+		return median( image, 5, threads);
+	case FILTER_SMOOTH:
+		return gaussian_blur( image, smooth_sigma, threads);
+	case FILTER_SHARPEN:
+		return unsharp_mask( image, sharpen_sigma, sharpen_amount, threads);
+	case FILTER_NONE:
+	default:
+		break;
+	}
+	return image;
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,58 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+#pragma once
+
+#include "data.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+enum FilterType {
+	FILTER_NONE,
+	FILTER_MEDIAN_3, // 3x3 median, single bad samples
+	FILTER_MEDIAN_5, // 5x5 median
+	FILTER_SMOOTH, // gaussian blur
+	FILTER_SHARPEN // unsharp mask
+};
+
+/** \brief Noise and sharpness filters of image data.
+ *
+ * Gaussian filters make the kernel once per call and run the rows pass
+ * and then the columns pass, the columns pass goes by tiles of columns
+ * so the rows under the kernel stay in the cache. Medians sort the
+ * window with a sorting network applied to whole rows at once, which
+ * the compiler turns into vector min and max instructions. All filters
+ * split the rows between several threads, 0 threads means one thread
+ * per processor. The source image is not changed, an empty pointer is
+ * returned for an empty image or wrong parameters.
+ */
+DataSharedPtr gaussian_blur( const DataSharedPtr& image, double sigma,
+	unsigned int threads = 0);
+DataSharedPtr unsharp_mask( const DataSharedPtr& image, double sigma,
+	double amount, unsigned int threads = 0);
+DataSharedPtr median( const DataSharedPtr& image, unsigned int size,
+	unsigned int threads = 0); /**< size is 3 or 5 */
+
+/** Filter with the default parameters of the type, FILTER_NONE
+ * returns the image itself. */
+DataSharedPtr filter( const DataSharedPtr& image, FilterType type,
+	unsigned int threads = 0);
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,78 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+/* files from src directory begin */
+#include "scanner/defines.hpp"
+/* files from src directory end */
+
+#include "flat_field.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+FlatField::FlatField(unsigned int width)
+	:
+	pedestals_( width, 0),
+	offsets_( width, 0)
+{
+}
+
+bool
+FlatField::set_pedestals(const DataVector& pedestals)
+{
+	if (pedestals.size() != width())
+		return false;
+
+	std::copy( pedestals.begin(), pedestals.end(), pedestals_.begin());
+	return true;
+}
+
+void
+FlatField::set_offset(gint16 offset)
+{
+	std::fill( offsets_.begin(), offsets_.end(), offset);
+}
+
+bool
+FlatField::apply(const DataSharedPtr& image) const
+{
+	if (!image || image->empty() || image->width() != width())
+		return false;
+
+	const unsigned int w = width();
+	const gint32* pedestals = &pedestals_[0];
+	const gint32* offsets = &offsets_[0];
+	const gint32 count_max = image->adc_count_max();
+
+	gint16* row = image->data();
+	for ( unsigned int k = 0; k < image->height(); ++k, row += w) {
+		for ( unsigned int i = 0; i < w; ++i) {
+			gint32 value = row[i] - pedestals[i] + offsets[i];
+			value = (value < SCANNER_ADC_COUNT_MIN) ? 0 : value;
+			value = (value > count_max) ? count_max : value;
+			row[i] = value;
+		}
+	}
+	return true;
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,54 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "data.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+/**
+ * Per strip pedestal correction of the chip frames:
+ * out = clamp(in - pedestal + offset, 0, ADC count max).
+ *
+ * The correction is a single integer pass over the frame which the
+ * compiler vectorizes.
+ */
+class FlatField {
+
+public:
+	FlatField() {}
+	explicit FlatField(unsigned int width);
+
+	bool empty() const { return pedestals_.empty(); }
+	unsigned int width() const { return pedestals_.size(); }
+
+	bool set_pedestals(const DataVector& pedestals);
+	void set_offset(gint16 offset);
+
+	bool apply(const DataSharedPtr& image) const;
+
+private:
+	std::vector<gint32> pedestals_;
+	std::vector<gint32> offsets_;
+};
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,156 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <sigc++/bind.h>
+#include <sigc++/functors/mem_fun.h>
+
+#include "bands.hpp"
+#include "integral_image.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+void
+IntegralImage::build( const DataSharedPtr& data, unsigned int threads)
+{
+	clear();
+
+	if (!data || data->empty())
+		return;
+
+	data_ = data;
+	width_ = data->width();
+	height_ = data->height();
+
+	// first row and column of the tables stay zero
+	sums_.assign( size_t(width_ + 1) * (height_ + 1), 0);
+	squares_.assign( sums_.size(), 0);
+
+	// prefix sums within rows, then down columns
+	for ( int pass = 0; pass < 2; ++pass) {
+		void (IntegralImage::*accumulate)( unsigned int, unsigned int) =
+			pass ? &IntegralImage::accumulate_columns :
+			&IntegralImage::accumulate_rows;
+		std::vector<Band> bands = split_bands( pass ? width_ : height_,
+			threads);
+
+		std::vector< sigc::slot<void> > jobs;
+		for ( unsigned int i = 0; i < bands.size(); ++i)
+			jobs.push_back(sigc::bind( sigc::mem_fun( *this, accumulate),
+				bands[i].first, bands[i].second));
+		run_jobs(jobs);
+	}
+}
+
+void
+IntegralImage::clear()
+{
+	data_.reset();
+	width_ = 0;
+	height_ = 0;
+	sums_.clear();
+	squares_.clear();
+}
+
+/**
+ * Rows [begin, end) of the image.
+ */
+void
+IntegralImage::accumulate_rows( unsigned int begin, unsigned int end)
+{
+	const unsigned int stride = width_ + 1;
+
+	for ( unsigned int j = begin; j < end; ++j) {
+		const gint16* row = data_->data() + size_t(j) * width_;
+		gint64* sum = &sums_[(j + 1) * stride];
+		gint64* square = &squares_[(j + 1) * stride];
+
+		gint64 s = 0, q = 0;
+		for ( unsigned int i = 0; i < width_; ++i) {
+			gint64 value = row[i];
+			s += value;
+			q += value * value;
+			sum[i + 1] = s;
+			square[i + 1] = q;
+		}
+	}
+}
+
+/**
+ * Columns [begin, end) of the image, the tables are walked by rows
+ * to keep the access sequential.
+ */
+void
+IntegralImage::accumulate_columns( unsigned int begin, unsigned int end)
+{
+	const unsigned int stride = width_ + 1;
+
+	for ( unsigned int j = 2; j <= height_; ++j) {
+		gint64* sum = &sums_[j * stride + 1];
+		gint64* square = &squares_[j * stride + 1];
+		const gint64* sum_above = sum - stride;
+		const gint64* square_above = square - stride;
+
+		for ( unsigned int i = begin; i < end; ++i) {
+			sum[i] += sum_above[i];
+			square[i] += square_above[i];
+		}
+	}
+}
+
+bool
+IntegralImage::statistics( int left, int top, int width, int height,
+	RoiStatistics& stats) const
+{
+	if (empty())
+		return false;
+
+	unsigned int x0 = CLAMP( left, 0, int(width_));
+	unsigned int y0 = CLAMP( top, 0, int(height_));
+	unsigned int x1 = CLAMP( left + width, 0, int(width_));
+	unsigned int y1 = CLAMP( top + height, 0, int(height_));
+
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	stats.count = (x1 - x0) * (y1 - y0);
+
+	double n = stats.count;
+	double s = sum( sums_, x0, y0, x1, y1);
+	double q = sum( squares_, x0, y0, x1, y1);
+
+	stats.mean = s / n;
+	stats.deviation = std::sqrt(std::max( 0., q / n - stats.mean * stats.mean));
+
+	// extremes are not additive, the rows of the rectangle are scanned
+	stats.min = data_->pixel( x0, y0);
+	stats.max = stats.min;
+	for ( unsigned int j = y0; j < y1; ++j) {
+		const gint16* row = data_->data() + size_t(j) * width_;
+		stats.min = std::min( stats.min, *std::min_element( row + x0, row + x1));
+		stats.max = std::max( stats.max, *std::max_element( row + x0, row + x1));
+	}
+	return true;
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,93 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <vector>
+
+#include "data.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+/** Statistics of pixels within a rectangle. */
+struct RoiStatistics {
+	RoiStatistics() : count(0), mean(0.), deviation(0.), min(0), max(0) {}
+
+	unsigned int count;
+	double mean;
+	double deviation; // standard deviation
+	gint16 min;
+	gint16 max;
+};
+
+/** \brief Summed-area tables of image data.
+ *
+ * Entry (x, y) of the tables holds the sum and the sum of squares of
+ * the pixels above and to the left of it, so the mean and the standard
+ * deviation of any rectangle take four lookups. The tables are built
+ * by several threads, first by row bands and then by column bands.
+ */
+class IntegralImage {
+
+public:
+	IntegralImage() : width_(0), height_(0) {}
+
+	void build( const DataSharedPtr& data, unsigned int threads = 0);
+	void clear();
+	bool empty() const { return !data_; }
+	const DataSharedPtr& data() const { return data_; }
+
+	/** \brief Statistics of [left, left + width) x [top, top + height).
+	 *
+	 * The rectangle is clipped by the image.
+	 * \return false if nothing is left of it.
+	 */
+	bool statistics( int left, int top, int width, int height,
+		RoiStatistics& stats) const;
+
+private:
+	void accumulate_rows( unsigned int begin, unsigned int end);
+	void accumulate_columns( unsigned int begin, unsigned int end);
+
+	gint64 sum( const std::vector<gint64>& table, unsigned int left,
+		unsigned int top, unsigned int right, unsigned int bottom) const;
+
+	DataSharedPtr data_;
+	unsigned int width_;
+	unsigned int height_;
+	std::vector<gint64> sums_; // (width + 1) x (height + 1)
+	std::vector<gint64> squares_;
+};
+
+inline
+gint64
+IntegralImage::sum( const std::vector<gint64>& table, unsigned int left,
+	unsigned int top, unsigned int right, unsigned int bottom) const
+{
+	const unsigned int stride = width_ + 1;
+
+	return table[bottom * stride + right] - table[top * stride + right] -
+		table[bottom * stride + left] + table[top * stride + left];
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
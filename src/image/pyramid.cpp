@@ -0,0 +1,89 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include "pyramid.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+void
+Pyramid::build( unsigned int width, unsigned int height,
+	const std::vector<guint8>& buffer, unsigned int min_size)
+{
+	levels_.clear();
+
+	if (!width || !height || buffer.size() < width * height)
+		return;
+
+	levels_.push_back(Level());
+
+	Level& base = levels_.back();
+	base.width = width;
+	base.height = height;
+	base.buffer.assign( buffer.begin(), buffer.begin() + width * height);
+
+	while (std::max( levels_.back().width, levels_.back().height) > min_size) {
+		Level level;
+		reduce( levels_.back(), level);
+		levels_.push_back(level);
+	}
+}
+
+/**
+ * Returns the smallest level that is still not coarser than the scale,
+ * so the level has to be reduced by no more than twice.
+ */
+unsigned int
+Pyramid::level_for_scale(double scale) const
+{
+	unsigned int n = 0;
+	while (n + 1 < levels_.size() && scale * (2 << n) <= 1.)
+		++n;
+
+	return n;
+}
+
+void
+Pyramid::reduce( const Level& from, Level& to)
+{
+	to.width = (from.width + 1) / 2;
+	to.height = (from.height + 1) / 2;
+	to.buffer.resize(to.width * to.height);
+
+	guint8* dest = &to.buffer[0];
+	for ( unsigned int j = 0; j < to.height; ++j) {
+		// odd sizes replicate the last row and column
+		const guint8* row0 = &from.buffer[2 * j * from.width];
+		const guint8* row1 = (2 * j + 1 < from.height) ?
+			row0 + from.width : row0;
+
+		for ( unsigned int i = 0; i < to.width; ++i) {
+			unsigned int x0 = 2 * i;
+			unsigned int x1 = (x0 + 1 < from.width) ? x0 + 1 : x0;
+
+			guint sum = row0[x0] + row0[x1] + row1[x0] + row1[x1];
+			*dest++ = static_cast<guint8>((sum + 2) >> 2);
+		}
+	}
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,66 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <vector>
+
+namespace ScanAmati {
+
+namespace Image {
+
+/** \brief Multi-resolution image pyramid.
+ *
+ * Level 0 is the 8-bit image buffer itself, every next level is
+ * the previous one reduced twice in each direction by a 2x2 box
+ * filter. The widgets render zoomed out images from the nearest
+ * level instead of rescaling the whole image.
+ */
+class Pyramid {
+
+public:
+	struct Level {
+		Level() : width(0), height(0) {}
+		guint8 pixel( unsigned int column, unsigned int row) const {
+			return buffer[row * width + column];
+		}
+
+		unsigned int width;
+		unsigned int height;
+		std::vector<guint8> buffer;
+	};
+
+	Pyramid() {}
+	void build( unsigned int width, unsigned int height,
+		const std::vector<guint8>& buffer, unsigned int min_size = 64);
+	void clear() { levels_.clear(); }
+	bool empty() const { return levels_.empty(); }
+	unsigned int levels() const { return levels_.size(); }
+	const Level& level(unsigned int n) const { return levels_[n]; }
+	unsigned int level_for_scale(double scale) const;
+
+private:
+	static void reduce( const Level& from, Level& to);
+
+	std::vector<Level> levels_;
+};
+
+} // namespace Image
+
+} // namespace ScanAmati
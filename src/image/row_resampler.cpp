@@ -0,0 +1,135 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "row_resampler.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+RowResampler::RowResampler()
+	:
+	source_(0)
+{
+}
+
+bool
+RowResampler::set_uniform( unsigned int source, unsigned int rows)
+{
+	if (!source || !rows)
+		return false;
+
+	std::vector<double> positions(rows);
+	double step = double(source) / rows;
+	for ( unsigned int i = 0; i < rows; ++i)
+		positions[i] = (i + .5) * step - .5;
+
+	return set_positions( source, positions);
+}
+
+bool
+RowResampler::set_positions( unsigned int source,
+	const std::vector<double>& positions)
+{
+	if (!source || positions.empty())
+		return false;
+
+	for ( unsigned int i = 1; i < positions.size(); ++i)
+		if (positions[i] < positions[i - 1])
+			return false;
+
+	source_ = source;
+	first_.assign( positions.size(), 0);
+	count_.assign( positions.size(), 0);
+	weights_.clear();
+
+	unsigned int last = positions.size() - 1;
+	for ( unsigned int i = 0; i <= last; ++i) {
+		// source rows between the neighbour output rows
+		double step = 1.;
+		if (last)
+			step = (i == 0) ? positions[1] - positions[0] :
+				(i == last) ? positions[last] - positions[last - 1] :
+				(positions[i + 1] - positions[i - 1]) / 2.;
+		double radius = std::max( 1., step);
+
+		double center = std::max( 0., std::min( positions[i],
+			double(source - 1)));
+		int begin = int(std::ceil(center - radius));
+		int end = int(std::floor(center + radius));
+		if (center - radius == begin)
+			++begin; // weight is zero at the tent edges
+		if (center + radius == end)
+			--end;
+		begin = std::max( begin, 0);
+		end = std::min( end, int(source - 1));
+
+		double sum = 0.;
+		std::vector<float>::size_type offset = weights_.size();
+		for ( int row = begin; row <= end; ++row) {
+			double weight = 1. - std::fabs(row - center) / radius;
+			weights_.push_back(weight);
+			sum += weight;
+		}
+		for ( std::vector<float>::size_type j = offset;
+			j < weights_.size(); ++j)
+			weights_[j] /= sum;
+
+		first_[i] = begin;
+		count_[i] = end - begin + 1;
+	}
+	return true;
+}
+
+DataSharedPtr
+RowResampler::apply(const DataSharedPtr& image) const
+{
+	if (!image || image->height() != source_ || first_.empty())
+		return DataSharedPtr();
+
+	unsigned int width = image->width();
+	DataSharedPtr result = Data::create( width, first_.size());
+	result->set_adc_bits(image->adc_bits());
+	std::vector<float> sums(width);
+
+	const float* weight = &weights_[0];
+	for ( unsigned int i = 0; i < first_.size(); ++i) {
+		std::fill( sums.begin(), sums.end(), 0.f);
+		for ( unsigned int j = 0; j < count_[i]; ++j, ++weight) {
+			const gint16* row = &image->pixel( 0, first_[i] + j);
+			float w = *weight;
+			for ( unsigned int k = 0; k < width; ++k)
+				sums[k] += w * row[k];
+		}
+
+		gint16* row = &result->pixel( 0, i);
+		for ( unsigned int k = 0; k < width; ++k) {
+			float value = std::floor(sums[k] + .5f);
+			row[k] = gint16(std::max( float(SHRT_MIN),
+				std::min( value, float(SHRT_MAX))));
+		}
+	}
+	return result;
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,73 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+#pragma once
+
+#include <vector>
+
+#include "data.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+/**
+ * Vertical resize of images through a table of row weights.
+ *
+ * The table is made once for the source height and the positions of
+ * the output rows, then applied to any number of images of that height.
+ * Every output row is a tent weighted sum of the source rows around its
+ * position, the tent is as wide as the source rows step between output
+ * rows, so rows of a slower part of the source are averaged and rows of
+ * a faster part are interpolated.
+ */
+class RowResampler {
+
+public:
+	RowResampler();
+
+	/** \brief Make the weights of an evenly spaced resize.
+	 *
+	 * \param source Rows of the source image.
+	 * \param rows   Rows of the output image.
+	 */
+	bool set_uniform( unsigned int source, unsigned int rows);
+
+	/** \brief Make the weights of the output rows positions.
+	 *
+	 * \param source    Rows of the source image.
+	 * \param positions Fractional source row of the center of every
+	 *                  output row, the positions must not decrease.
+	 */
+	bool set_positions( unsigned int source,
+		const std::vector<double>& positions);
+
+	unsigned int source_height() const { return source_; }
+	unsigned int height() const { return first_.size(); }
+
+	/** Resize the image, the image height must be the source height. */
+	DataSharedPtr apply(const DataSharedPtr& image) const;
+
+private:
+	std::vector<unsigned int> first_; // first source row of output row
+	std::vector<unsigned int> count_; // source rows of output row
+	std::vector<float> weights_; // count_ weights of every output row
+	unsigned int source_;
+};
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -15,16 +15,52 @@
  *      MA 02110-1301, USA.
  */
 
-#include "summary_data.hpp"
+#include <climits>
 
-// files from src directory begin
-#include "scanner/defines.hpp"
-// files from src directory end
+#include "summary_data.hpp"
 
 namespace ScanAmati {
 
 namespace Image {
 
+std::vector<guint8>&
+SummaryData::image_buffer()
+{
+	BufferSharedPtr& buf = std::tr1::get<1>(tuple_);
+	if (!buf)
+		buf.reset(new std::vector<guint8>);
+	else if (!buf.unique())
+		buf.reset(new std::vector<guint8>(*buf));
+	return *buf;
+}
+
+const std::vector<guint8>&
+SummaryData::image_buffer() const
+{
+	static const std::vector<guint8> empty;
+
+	const BufferSharedPtr& buf = std::tr1::get<1>(tuple_);
+	return (buf) ? *buf : empty;
+}
+
+size_t
+SummaryData::memory_size() const
+{
+	size_t size = 0;
+	if (raw_data())
+		size += raw_data()->width() * raw_data()->height() * sizeof(gint16);
+	size += image_buffer().size();
+	return size;
+}
+
+void
+SummaryData::clear()
+{
+	raw_data().reset();
+	std::tr1::get<1>(tuple_).reset();
+	chip_codes_.clear();
+}
+
 bool
 SummaryData::fill_image_buffer()
 {
@@ -32,12 +68,14 @@ SummaryData::fill_image_buffer()
 	const Image::DataSharedPtr& image = raw_data();
 	
 	if (image) {
-		std::vector<guint8>& buf = image_buffer();
-		buf.resize(image->width() * image->height());
+		BufferSharedPtr& ptr = std::tr1::get<1>(tuple_);
+		ptr.reset(new std::vector<guint8>(image->width() * image->height()));
+		std::vector<guint8>& buf = *ptr;
+		const double count_max = image->adc_count_max();
 		for ( const gint16* pos = image->begin(); pos != image->end(); ++pos)
 		{
 			ptrdiff_t i = pos - image->begin();
-			double value = double(UCHAR_MAX * *pos) / SCANNER_ADC_COUNT_MAX;
+			double value = double(UCHAR_MAX * *pos) / count_max;
 			buf[i] = static_cast<gint8>(value);
 		}
 		res = true;
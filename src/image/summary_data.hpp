@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <string>
 #include <tr1/tuple>
 
 #include "data.hpp"
@@ -26,23 +27,38 @@ namespace ScanAmati {
 	
 namespace Image {
 
+typedef std::tr1::shared_ptr< std::vector<guint8> > BufferSharedPtr;
+
 typedef std::tr1::tuple<
 	DataSharedPtr, // raw data
-	std::vector<guint8> // image buffer
+	BufferSharedPtr // image buffer
 > SummaryTuple;
 
+/**
+ * Raw image data and its 8-bit display buffer.
+ *
+ * Copies share both the raw data and the display buffer, the buffer
+ * is copied only when a copy asks for it to be writable.
+ */
 class SummaryData {
 public:
 	SummaryData() {}
 	SummaryData(const SummaryTuple& tuple) : tuple_(tuple) {}
 	DataSharedPtr& raw_data() { return std::tr1::get<0>(tuple_); }
 	const DataSharedPtr& raw_data() const { return std::tr1::get<0>(tuple_); }
-	std::vector<guint8>& image_buffer() { return std::tr1::get<1>(tuple_); }
-	std::vector<guint8> image_buffer() const { return std::tr1::get<1>(tuple_); }
+	std::vector<guint8>& image_buffer();
+	const std::vector<guint8>& image_buffer() const;
 	bool fill_image_buffer();
+	size_t memory_size() const;
+	void clear();
+
+	/** Codes of the chips the columns come from, empty if unknown. */
+	const std::string& chip_codes() const { return chip_codes_; }
+	void set_chip_codes(const std::string& codes) { chip_codes_ = codes; }
 
 protected:
 	SummaryTuple tuple_;
+	std::string chip_codes_;
 };
 
 } // namespace Image
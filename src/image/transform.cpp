@@ -0,0 +1,206 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include "transform.hpp"
+
+namespace {
+
+using namespace ScanAmati::Image;
+
+// 32 x 32 pixels of gint16, 2 KiB read and 2 KiB written per tile
+const unsigned int tile_size = 32;
+
+/**
+ * Writes src pixel (column, row) to dest row column and dest column row,
+ * each index is mirrored if the corresponding flag is set. Transposition
+ * and both quarter turns are the instances of this kernel.
+ */
+template <bool MirrorRows, bool MirrorColumns>
+void
+transpose_tiles( const gint16* src, unsigned int width, unsigned int height,
+	gint16* dest)
+{
+	for ( unsigned int r0 = 0; r0 < height; r0 += tile_size) {
+		unsigned int r1 = std::min( r0 + tile_size, height);
+
+		for ( unsigned int c0 = 0; c0 < width; c0 += tile_size) {
+			unsigned int c1 = std::min( c0 + tile_size, width);
+
+			for ( unsigned int c = c0; c < c1; ++c) {
+				unsigned int row = MirrorRows ? width - 1 - c : c;
+				gint16* out = dest + size_t(row) * height;
+				const gint16* in = src + c;
+
+				for ( unsigned int r = r0; r < r1; ++r) {
+					unsigned int column = MirrorColumns ? height - 1 - r : r;
+					out[column] = in[size_t(r) * width];
+				}
+			}
+		}
+	}
+}
+
+bool
+prepare( const DataSharedPtr& src, unsigned int width, unsigned int height,
+	DataSharedPtr& dest)
+{
+	if (!src || src->empty() || !width || !height)
+		return false;
+
+	// reuse the buffer of the previous result
+	if (dest && dest != src && dest.unique() &&
+		dest->width() == width && dest->height() == height) {
+		dest->set_adc_bits(src->adc_bits());
+		return true;
+	}
+
+	dest = Data::create( width, height);
+	dest->set_adc_bits(src->adc_bits());
+	return true;
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace Image {
+
+bool
+transpose( const DataSharedPtr& src, DataSharedPtr& dest)
+{
+	if (!src || !prepare( src, src->height(), src->width(), dest))
+		return false;
+
+	transpose_tiles< false, false>( src->data(), src->width(), src->height(),
+		dest->data());
+	return true;
+}
+
+bool
+rotate( const DataSharedPtr& src, RotationType rotation, DataSharedPtr& dest)
+{
+	if (!src)
+		return false;
+
+	unsigned int width = src->width();
+	unsigned int height = src->height();
+
+	if (rotation == ROTATE_180) {
+		if (!prepare( src, width, height, dest))
+			return false;
+		std::reverse_copy( src->begin(), src->end(), dest->begin());
+		return true;
+	}
+
+	if (!prepare( src, height, width, dest))
+		return false;
+
+	switch (rotation) {
+	case ROTATE_90:
+		transpose_tiles< false, true>( src->data(), width, height,
+			dest->data());
+		break;
+	case ROTATE_270:
+		transpose_tiles< true, false>( src->data(), width, height,
+			dest->data());
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+/**
+ * [left, left + width) x [top, top + height)
+ */
+bool
+crop( const DataSharedPtr& src, unsigned int left, unsigned int top,
+	unsigned int width, unsigned int height, DataSharedPtr& dest)
+{
+	if (!src || left + width > src->width() || top + height > src->height())
+		return false;
+
+	if (!prepare( src, width, height, dest))
+		return false;
+
+	for ( unsigned int i = 0; i < height; ++i) {
+		const gint16* row = src->data() + size_t(top + i) * src->width();
+		std::copy( row + left, row + left + width,
+			dest->data() + size_t(i) * width);
+	}
+	return true;
+}
+
+DataSharedPtr
+transpose(const DataSharedPtr& src)
+{
+	DataSharedPtr dest;
+	transpose( src, dest);
+	return dest;
+}
+
+DataSharedPtr
+rotate( const DataSharedPtr& src, RotationType rotation)
+{
+	DataSharedPtr dest;
+	rotate( src, rotation, dest);
+	return dest;
+}
+
+DataSharedPtr
+crop( const DataSharedPtr& src, unsigned int left, unsigned int top,
+	unsigned int width, unsigned int height)
+{
+	DataSharedPtr dest;
+	crop( src, left, top, width, height, dest);
+	return dest;
+}
+
+bool
+flip( const DataSharedPtr& data, FlipType type)
+{
+	if (!data || data->empty())
+		return false;
+
+	unsigned int width = data->width();
+	unsigned int height = data->height();
+
+	switch (type) {
+	case FLIP_HORIZONTAL:
+		for ( unsigned int i = 0; i < height; ++i) {
+			gint16* row = data->data() + size_t(i) * width;
+			std::reverse( row, row + width);
+		}
+		break;
+	case FLIP_VERTICAL:
+		for ( unsigned int i = 0; i < height / 2; ++i) {
+			gint16* upper = data->data() + size_t(i) * width;
+			gint16* lower = data->data() + size_t(height - 1 - i) * width;
+			std::swap_ranges( upper, upper + width, lower);
+		}
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+} // namespace Image
+
+} // namespace ScanAmati
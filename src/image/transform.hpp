@@ -0,0 +1,60 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "data.hpp"
+
+namespace ScanAmati {
+
+namespace Image {
+
+enum RotationType {
+	ROTATE_90, // clockwise
+	ROTATE_180,
+	ROTATE_270
+};
+
+enum FlipType {
+	FLIP_HORIZONTAL, // columns are reversed
+	FLIP_VERTICAL // rows are reversed
+};
+
+/** \brief Geometric transforms of image data.
+ *
+ * Transposition and quarter turns are done by square tiles which fit
+ * the L1 cache for both the read and the written rows. Functions with
+ * a destination argument reuse its pixels if it has the right size and
+ * is not shared, so repeated orientation changes do not allocate.
+ */
+bool transpose( const DataSharedPtr& src, DataSharedPtr& dest);
+bool rotate( const DataSharedPtr& src, RotationType rotation,
+	DataSharedPtr& dest);
+bool crop( const DataSharedPtr& src, unsigned int left, unsigned int top,
+	unsigned int width, unsigned int height, DataSharedPtr& dest);
+
+DataSharedPtr transpose(const DataSharedPtr& src);
+DataSharedPtr rotate( const DataSharedPtr& src, RotationType rotation);
+DataSharedPtr crop( const DataSharedPtr& src, unsigned int left,
+	unsigned int top, unsigned int width, unsigned int height);
+
+/** Flip in place. */
+bool flip( const DataSharedPtr& data, FlipType type);
+
+} // namespace Image
+
+} // namespace ScanAmati
@@ -0,0 +1,178 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <iostream>
+
+#include "global_strings.hpp"
+#include "application.hpp"
+#include "file.hpp"
+#include "file_loader.hpp"
+#include "image_store.hpp"
+
+namespace {
+
+const size_t default_memory_limit = 256 * 1024 * 1024;
+
+void
+store_image_data( const std::string&, ScanAmati::File& file,
+	ScanAmati::Image::SummaryData& data)
+{
+	data = file.image_data();
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+ImageHandle::ImageHandle(unsigned int id)
+	:
+	key_( new unsigned int(id), &ImageStore::release)
+{
+}
+
+ImageStore&
+ImageStore::instance()
+{
+	static ImageStore store;
+	return store;
+}
+
+ImageStore::ImageStore()
+	:
+	last_id_(0),
+	memory_size_(0),
+	memory_limit_(default_memory_limit)
+{
+	if (app.prefs.has_key( "Gui", conf_key_image_store_memory_size)) {
+		int limit = app.prefs.get<int>( "Gui",
+			conf_key_image_store_memory_size);
+		if (limit > 0)
+			memory_limit_ = limit;
+	}
+}
+
+void
+ImageStore::release(unsigned int* key)
+{
+	instance().remove(*key);
+	delete key;
+}
+
+ImageHandle
+ImageStore::add( const Image::SummaryData& data, const std::string& filename)
+{
+	unsigned int id = ++last_id_;
+
+	Entry& entry = entries_[id];
+	entry.data = data;
+	entry.filename = filename;
+	entry.size = data.memory_size();
+	entry.usage = usage_.insert( usage_.begin(), id);
+	memory_size_ += entry.size;
+
+	evict(id);
+	return ImageHandle(id);
+}
+
+bool
+ImageStore::get( const ImageHandle& handle, Image::SummaryData& data)
+{
+	EntryMap::iterator iter = entries_.find(handle.id());
+	if (iter == entries_.end())
+		return false;
+
+	Entry& entry = iter->second;
+	if (!entry.data.raw_data() && !reload(entry))
+		return false;
+
+	usage_.splice( usage_.begin(), usage_, entry.usage);
+	data = entry.data;
+
+	evict(handle.id());
+	return true;
+}
+
+void
+ImageStore::set_filename( const ImageHandle& handle,
+	const std::string& filename)
+{
+	EntryMap::iterator iter = entries_.find(handle.id());
+	if (iter != entries_.end())
+		iter->second.filename = filename;
+}
+
+void
+ImageStore::set_memory_limit(size_t bytes)
+{
+	memory_limit_ = bytes;
+	evict(0);
+}
+
+void
+ImageStore::remove(unsigned int id)
+{
+	EntryMap::iterator iter = entries_.find(id);
+	if (iter != entries_.end()) {
+		memory_size_ -= iter->second.size;
+		usage_.erase(iter->second.usage);
+		entries_.erase(iter);
+	}
+}
+
+bool
+ImageStore::reload(Entry& entry)
+{
+	Image::SummaryData data;
+	try {
+		FileLoader loader(entry.filename);
+		loader.signal_file_loaded().connect(sigc::bind(
+			sigc::ptr_fun(&store_image_data), sigc::ref(data)));
+		loader.load();
+	}
+	catch (const Exception& ex) {
+		std::cerr << ex.what() << std::endl;
+		return false;
+	}
+
+	if (!data.raw_data())
+		return false;
+
+	entry.data = data;
+	entry.size = data.memory_size();
+	memory_size_ += entry.size;
+	return true;
+}
+
+void
+ImageStore::evict(unsigned int keep)
+{
+	UsageList::reverse_iterator iter = usage_.rbegin();
+	for ( ; memory_size_ > memory_limit_ && iter != usage_.rend(); ++iter) {
+		if (*iter == keep)
+			continue;
+
+		Entry& entry = entries_[*iter];
+		if (entry.filename.empty() || !entry.data.raw_data())
+			continue;
+
+		entry.data.clear();
+		memory_size_ -= entry.size;
+		entry.size = 0;
+	}
+}
+
+} // namespace ScanAmati
@@ -0,0 +1,111 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "image/summary_data.hpp"
+
+namespace ScanAmati {
+
+class ImageStore;
+
+/**
+ * Reference to an image kept by the ImageStore.
+ *
+ * Handles are cheap to copy, the image is dropped from the store
+ * together with its last handle.
+ */
+class ImageHandle {
+
+public:
+	ImageHandle() {}
+	unsigned int id() const { return (key_) ? *key_ : 0; }
+	bool empty() const { return !key_; }
+
+private:
+	friend class ImageStore;
+	ImageHandle(unsigned int id);
+
+	std::tr1::shared_ptr<unsigned int> key_;
+};
+
+/**
+ * Images of the opened files and of the acquired data.
+ *
+ * Pixel data of the images which can be loaded from files again are
+ * released in least recently used order when the store grows over its
+ * memory limit, and reloaded when they are requested next time. Images
+ * without a file are always kept. The store is used from the GUI
+ * thread only.
+ */
+class ImageStore {
+
+public:
+	static ImageStore& instance();
+
+	ImageHandle add( const Image::SummaryData&,
+		const std::string& filename = std::string());
+
+	/** \brief Get image data.
+	 *
+	 * \param handle Image handle.
+	 * \param data   Image data, shares pixel buffers with the store.
+	 * \return false if the handle is empty or the image could
+	 * not be reloaded, true otherwise.
+	 */
+	bool get( const ImageHandle& handle, Image::SummaryData& data);
+	void set_filename( const ImageHandle&, const std::string&);
+
+	void set_memory_limit(size_t bytes);
+	size_t memory_limit() const { return memory_limit_; }
+	size_t memory_size() const { return memory_size_; }
+
+private:
+	typedef std::list<unsigned int> UsageList; // most recently used first
+
+	struct Entry {
+		Image::SummaryData data;
+		std::string filename;
+		size_t size; // memory size of the loaded data
+		UsageList::iterator usage;
+	};
+
+	typedef std::map< unsigned int, Entry> EntryMap;
+
+	friend class ImageHandle;
+
+	ImageStore();
+	ImageStore(const ImageStore&);
+	ImageStore& operator=(const ImageStore&);
+
+	static void release(unsigned int* key);
+	void remove(unsigned int id);
+	bool reload(Entry&);
+	void evict(unsigned int keep);
+
+	EntryMap entries_;
+	UsageList usage_;
+	unsigned int last_id_;
+	size_t memory_size_;
+	size_t memory_limit_;
+};
+
+} // namespace ScanAmati
@@ -48,11 +48,14 @@
 #include "dialogs/scanner_debug.hpp"
 #include "dialogs/store_dicom.hpp"
 #include "dialogs/conquest_archive.hpp"
+#include "dialogs/local_search.hpp"
 #include "dialogs/dicom_information.hpp"
 #include "dialogs/preferences.hpp"
 #include "dialogs/save_as.hpp"
 #include "dialogs/utils.hpp"
 
+#include "dicom/storage_server.hpp"
+#include "dicom/store_spool.hpp"
 #include "dicom/utils.hpp"
 
 #include "scanner/manager.hpp"
@@ -280,6 +283,8 @@ MainWindow::connect_signals()
 		*image_area_, &ImageArea::set_image_data));
 	files_view_->signal_images_cleaned().connect(sigc::mem_fun(
 		*image_area_, &ImageArea::clear_area));
+	image_area_->signal_roi_measured().connect(sigc::mem_fun(
+		*this, &MainWindow::on_roi_measured));
 	files_view_->signal_dicom_info_clicked().connect(sigc::mem_fun(
 		*info_notebook_, &InformationNotebook::on_dicom_info));
 	files_view_->signal_images_cleaned().connect(sigc::mem_fun(
@@ -308,6 +313,14 @@ MainWindow::connect_signals()
 			sigc::mem_fun( *this, &MainWindow::update_data_state));
 	}
 
+	// Studies pushed by other stations
+	DICOM::StorageServer::instance().signal_received().connect(
+		sigc::mem_fun( *this, &MainWindow::on_studies_received));
+
+	// Outgoing datasets waiting for their servers
+	DICOM::StoreSpool::instance().signal_changed().connect(
+		sigc::mem_fun( *this, &MainWindow::on_spool_changed));
+
 	// Initiation
 	Glib::signal_idle().connect(sigc::bind_return(
 		sigc::mem_fun( *this, &MainWindow::on_init), false));
@@ -320,6 +333,7 @@ MainWindow::on_file_open()
 		Gtk::FILE_CHOOSER_ACTION_OPEN);
 
 	dialog.set_transient_for(*this);
+	dialog.set_select_multiple(true);
 
 	// Add response buttons in the dialog:
 	dialog.add_button( Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
@@ -346,18 +360,23 @@ MainWindow::on_file_open()
 	switch (result) {
     case Gtk::RESPONSE_OK:
 		{
-			// Notice that this is a std::string, not a Glib::ustring.
-			std::string filename = dialog.get_filename();
+			// Notice that these are std::string, not Glib::ustring.
+			std::vector<std::string> filenames = dialog.get_filenames();
 
+			// pixels are read when an image is shown or has no cached icon
 			const Gtk::FileFilter* filter = dialog.get_filter();
-			try {
-				FileLoader loader( filename, filter);
-				loader.signal_file_loaded().connect(sigc::bind( sigc::mem_fun(
-					*files_view_, &FilesIconView::add_file), false));
-				loader.load();
-			}
-			catch (const Exception& ex) {
-				std::cerr << ex.what() << std::endl;
+			for ( std::vector<std::string>::const_iterator it =
+				filenames.begin(); it != filenames.end(); ++it) {
+				try {
+					FileLoader loader( *it, filter);
+					loader.signal_file_loaded().connect(sigc::bind(
+						sigc::mem_fun( *files_view_, &FilesIconView::add_file),
+						false));
+					loader.load(LOAD_INFO);
+				}
+				catch (const Exception& ex) {
+					std::cerr << ex.what() << std::endl;
+				}
 			}
 		}
 		break;
@@ -448,6 +467,18 @@ MainWindow::on_file_save_archive()
 	}
 }
 
+void
+MainWindow::on_files_save_archive_all()
+{
+	std::vector<std::string> filenames;
+	if (files_view_->get_filenames(filenames)) {
+		StoreDicomDialog *dialog = StoreDicomDialog::create(0);
+		dialog->set_files(filenames);
+		dialog->run();
+		delete dialog;
+	}
+}
+
 void
 MainWindow::on_image_find()
 {
@@ -464,6 +495,41 @@ MainWindow::on_image_find()
 		conquest_archive_dialog_->run();
 }
 
+void
+MainWindow::on_file_find_local()
+{
+	if (!local_search_dialog_) {
+		LocalSearchDialog* dialog = LocalSearchDialog::create();
+		if (dialog) {
+			dialog->signal_open_filename().connect(sigc::bind( sigc::mem_fun(
+				*this, &MainWindow::load_file), false));
+
+			local_search_dialog_.reset(dialog);
+		}
+	}
+	if (local_search_dialog_)
+		local_search_dialog_->run();
+}
+
+void
+MainWindow::on_studies_received()
+{
+	std::vector<DICOM::StorageServer::Study> studies =
+		DICOM::StorageServer::instance().take_studies();
+
+	for ( std::vector<DICOM::StorageServer::Study>::const_iterator study =
+		studies.begin(); study != studies.end(); ++study)
+		for ( std::vector<std::string>::const_iterator it =
+			study->filenames.begin(); it != study->filenames.end(); ++it)
+			load_file( *it, true);
+}
+
+void
+MainWindow::on_spool_changed()
+{
+	statusbar_->set_text(DICOM::StoreSpool::instance().metrics().summary());
+}
+
 void
 MainWindow::on_quit()
 {
@@ -668,11 +734,31 @@ void
 MainWindow::on_image_reconstruction(const boost::any& value)
 {
 	Scanner::SharedManager manager = Scanner::Manager::instance();
-	manager->run(RUN_IMAGE_RECONSTRUCTION);
+	manager->reconstruct(value);
+}
 
-	Scanner::Data* data = manager->get_data();
-	if (data)
-		data->run_image_reconstruction(value);
+void
+MainWindow::on_data_destripe(const Glib::RefPtr<Gtk::ToggleAction>& action)
+{
+	Scanner::DestripeType type = action->get_active() ?
+		Scanner::DESTRIPE_COLUMNS : Scanner::DESTRIPE_NONE;
+	on_image_reconstruction(type);
+}
+
+void
+MainWindow::on_data_motion(const Glib::RefPtr<Gtk::ToggleAction>& action)
+{
+	Scanner::MotionType type = action->get_active() ?
+		Scanner::MOTION_PROFILE : Scanner::MOTION_UNIFORM;
+	on_image_reconstruction(type);
+}
+
+void
+MainWindow::on_data_image_filter(
+	const Glib::RefPtr<Gtk::RadioAction>& action, Image::FilterType type)
+{
+	if (action->get_active())
+		on_image_reconstruction(type);
 }
 
 void
@@ -700,7 +786,7 @@ MainWindow::load_file( const std::string& filename, bool from_pacs)
 		FileLoader loader(filename);
 		loader.signal_file_loaded().connect(sigc::bind( sigc::mem_fun(
 			*files_view_, &FilesIconView::add_file), from_pacs));
-		loader.load();
+		loader.load(LOAD_INFO);
 	}
 	catch (const Exception& ex) {
 	}
@@ -775,8 +861,7 @@ void
 MainWindow::update_data_state()
 {
 	Scanner::SharedManager manager = Scanner::Manager::instance();
-	manager->stop(false); // stop loop thread
-	manager->join_data_thread();
+	manager->finish_reconstruction(); // stop loop thread
 	signal_scanner_image_ready_(); // send signal that image is ready
 }
 
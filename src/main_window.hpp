@@ -53,6 +53,10 @@ namespace DICOM {
 class SummaryInfo;
 } // namespace DICOM
 
+namespace Image {
+struct RoiStatistics;
+} // namespace Image
+
 namespace UI {
 
 struct ActionState;
@@ -70,6 +74,7 @@ class TemperatureMarginsDialog;
 class ImageAcquisitionDialog;
 class LiningAcquisitionDialog;
 class ConquestArchiveDialog;
+class LocalSearchDialog;
 
 class MainWindow : public Gtk::Window {
 
@@ -105,9 +110,13 @@ protected:
 	void on_file_save();
 	void on_file_save_as();
 	void on_file_save_archive();
+	void on_files_save_archive_all();
 	void on_preferences();
 	void on_temperature_margins();
 	void on_image_find();
+	void on_file_find_local();
+	void on_studies_received();
+	void on_spool_changed();
 	void on_image_acquisition();
 	void on_image_ready();
 	void on_printoperation_status_changed(
@@ -117,6 +126,10 @@ protected:
 	void on_print_preview(Gtk::PrintOperationAction);
 	void on_print_page_setup();
 	void on_image_reconstruction(const boost::any&);
+	void on_data_destripe(const Glib::RefPtr<Gtk::ToggleAction>&);
+	void on_data_motion(const Glib::RefPtr<Gtk::ToggleAction>&);
+	void on_data_image_filter( const Glib::RefPtr<Gtk::RadioAction>&,
+		Image::FilterType);
 	void on_lining_acquisition();
 	void on_write_lining();
 	void on_scanner_device(bool);
@@ -131,6 +144,7 @@ protected:
 	void on_file_view_state_type(FilesIconView::StateType);
 	void on_file_view_data_type();
 	void on_images_cleaned();
+	void on_roi_measured(const Image::RoiStatistics&);
 	void load_file( const std::string&, bool);
 	void update_scanner_state();
 	void update_data_state();
@@ -159,6 +173,7 @@ protected:
 	std::tr1::shared_ptr<LiningAcquisitionDialog> lining_acquisition_dialog_;
 	std::tr1::shared_ptr<ScannerDebugDialog> scanner_debug_dialog_;
 	std::tr1::shared_ptr<ConquestArchiveDialog> conquest_archive_dialog_;
+	std::tr1::shared_ptr<LocalSearchDialog> local_search_dialog_;
 
 	// Printing-related objects:
 	Glib::RefPtr<Gtk::PageSetup> page_setup_;
@@ -15,10 +15,14 @@
  *      MA 02110-1301, USA.
  */
 
+#include <iomanip>
+
 #include "application.hpp"
 #include "global_strings.hpp"
 
 #include "utils.hpp"
+#include "image/integral_image.hpp"
+#include "widgets/status_bar.hpp"
 
 #include "main_window.hpp"
 
@@ -119,6 +123,20 @@ MainWindow::on_images_cleaned()
 	set_title(_("ScanAmati"));
 }
 
+void
+MainWindow::on_roi_measured(const Image::RoiStatistics& stats)
+{
+	Glib::ustring msg = Glib::ustring::compose(
+		_("Region %1 px: mean %2, deviation %3, min %4, max %5, SNR %6"),
+		stats.count, Glib::ustring::format( std::fixed,
+		std::setprecision(1), stats.mean), Glib::ustring::format( std::fixed,
+		std::setprecision(1), stats.deviation), stats.min, stats.max,
+		Glib::ustring::format( std::fixed, std::setprecision(1),
+		stats.deviation > 0. ? stats.mean / stats.deviation : 0.));
+
+	statusbar_->set_text(msg);
+}
+
 void
 MainWindow::on_file_view_state_type(FilesIconView::StateType type)
 {
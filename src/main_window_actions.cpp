@@ -67,6 +67,11 @@ MainWindow::init_actions()
 		sigc::mem_fun( *this, &MainWindow::on_file_save_archive));
 	act->set_sensitive(false);
 
+	act = Gtk::Action::create( "action-file-find-local", Gtk::Stock::FIND,
+		_("Find _Local Studies..."), _("Find studies in the local files"));
+	action_group_->add( act, Gtk::AccelKey("<control><shift>f"),
+		sigc::mem_fun( *this, &MainWindow::on_file_find_local));
+
 	act = Gtk::Action::create( "preferences", Gtk::Stock::PREFERENCES,
 		_("ScanAmati Preferences..."), _("Edit global ScanAmati preferences"));
 	action_group_->add( act, Gtk::AccelKey("<control><shift>p"),
@@ -212,6 +217,49 @@ MainWindow::init_actions()
 
 	toggle_action->set_sensitive(app.extend);
 
+	toggle_action = Gtk::ToggleAction::create(
+		"action-measure-roi", Gtk::StockID(), _("Measure _Region"),
+		_("Show mean, deviation, minimum and maximum in a dragged rectangle"));
+
+	action_group_->add( toggle_action, sigc::bind(
+		sigc::mem_fun( *image_area_, &ImageArea::on_measure_roi),
+		toggle_action));
+
+	act = Gtk::Action::create( "action-view-filter", _("_Filter"));
+	action_group_->add(act);
+
+	Gtk::RadioButtonGroup group_view_filter; // Shown image filters
+	radio_act = Gtk::RadioAction::create( group_view_filter,
+		"radioaction-view-filter-none", Q_("Filter|None"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *image_area_, &ImageArea::on_view_filter),
+		radio_act, Image::FILTER_NONE));
+	radio_act->set_active(true);
+
+	radio_act = Gtk::RadioAction::create( group_view_filter,
+		"radioaction-view-filter-median-3", Q_("Filter|Median 3x3"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *image_area_, &ImageArea::on_view_filter),
+		radio_act, Image::FILTER_MEDIAN_3));
+
+	radio_act = Gtk::RadioAction::create( group_view_filter,
+		"radioaction-view-filter-median-5", Q_("Filter|Median 5x5"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *image_area_, &ImageArea::on_view_filter),
+		radio_act, Image::FILTER_MEDIAN_5));
+
+	radio_act = Gtk::RadioAction::create( group_view_filter,
+		"radioaction-view-filter-smooth", Q_("Filter|Smooth"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *image_area_, &ImageArea::on_view_filter),
+		radio_act, Image::FILTER_SMOOTH));
+
+	radio_act = Gtk::RadioAction::create( group_view_filter,
+		"radioaction-view-filter-sharpen", Q_("Filter|Sharpen"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *image_area_, &ImageArea::on_view_filter),
+		radio_act, Image::FILTER_SHARPEN));
+
 	act = Gtk::Action::create( "action-scanner", _("_Scanner"));
 	action_group_->add(act);
 
@@ -259,6 +307,12 @@ MainWindow::init_actions()
 		_("Clear All"));
 	action_group_->add( act, sigc::mem_fun( *files_view_, &FilesIconView::clear_all));
 
+	act = Gtk::Action::create( "action-files-save-archive-all",
+		Gtk::Stock::SAVE_AS, _("Save All to _Archive"),
+		_("Save all opened files to archive"));
+	action_group_->add( act,
+		sigc::mem_fun( *this, &MainWindow::on_files_save_archive_all));
+
 	act = Gtk::Action::create( "action-show-raw-data", Gtk::StockID(),
 		_("Show Raw Data"));
 	action_group_->add(act);
@@ -309,6 +363,54 @@ MainWindow::init_actions()
 		_("Best"));
 	action_group_->add(act);
 
+	toggle_action = Gtk::ToggleAction::create( "action-data-destripe",
+		Gtk::StockID(), _("_Destripe"),
+		_("Remove vertical stripes caused by the strips drift"));
+	action_group_->add( toggle_action, sigc::bind(
+		sigc::mem_fun( *this, &MainWindow::on_data_destripe),
+		toggle_action));
+
+	toggle_action = Gtk::ToggleAction::create( "action-data-motion",
+		Gtk::StockID(), _("Correct _Motion"),
+		_("Place rows by the speed of the scanner movement"));
+	action_group_->add( toggle_action, sigc::bind(
+		sigc::mem_fun( *this, &MainWindow::on_data_motion),
+		toggle_action));
+
+	action_group_->add(Gtk::Action::create( "action-data-noise-filter",
+		_("_Noise Filter")));
+
+	Gtk::RadioButtonGroup group_data_filter; // Reconstruction filters
+	radio_act = Gtk::RadioAction::create( group_data_filter,
+		"radioaction-data-filter-none", Q_("Filter|None"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *this, &MainWindow::on_data_image_filter),
+		radio_act, Image::FILTER_NONE));
+
+	radio_act = Gtk::RadioAction::create( group_data_filter,
+		"radioaction-data-filter-median-3", Q_("Filter|Median 3x3"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *this, &MainWindow::on_data_image_filter),
+		radio_act, Image::FILTER_MEDIAN_3));
+
+	radio_act = Gtk::RadioAction::create( group_data_filter,
+		"radioaction-data-filter-median-5", Q_("Filter|Median 5x5"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *this, &MainWindow::on_data_image_filter),
+		radio_act, Image::FILTER_MEDIAN_5));
+
+	radio_act = Gtk::RadioAction::create( group_data_filter,
+		"radioaction-data-filter-smooth", Q_("Filter|Smooth"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *this, &MainWindow::on_data_image_filter),
+		radio_act, Image::FILTER_SMOOTH));
+
+	radio_act = Gtk::RadioAction::create( group_data_filter,
+		"radioaction-data-filter-sharpen", Q_("Filter|Sharpen"));
+	action_group_->add( radio_act, sigc::bind(
+		sigc::mem_fun( *this, &MainWindow::on_data_image_filter),
+		radio_act, Image::FILTER_SHARPEN));
+
 	// popup menus
 	act = Gtk::Action::create( "popup-menu-palette", _("_Palette"));
 	action_group_->add(act);
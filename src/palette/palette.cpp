@@ -15,6 +15,12 @@
  *      MA 02110-1301, USA.
  */
 
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <medcon.h>
 
 #include "palette.hpp"
@@ -26,14 +32,14 @@ namespace Image {
 Palette*
 Palette::create(PaletteType type)
 {
-	Palette* palette = new Palette;
-	palette->fill(type);
-	return palette;
+	return new Palette(type);
 }
 
 void
 Palette::fill(PaletteType type)
 {
+	type_ = type;
+
 	switch (type) {
 	case PALETTE_INVERTED:
 		MdcInvertedScale(rgb_);
@@ -52,6 +58,52 @@ Palette::fill(PaletteType type)
 		MdcGrayScale(rgb_);
 		break;
 	}
+
+	for ( int i = 0; i < IMAGE_PALETTE_ENTRIES; ++i) {
+		unsigned char entry[4] = {
+			rgb_[3 * i + 0], rgb_[3 * i + 1], rgb_[3 * i + 2], 0xFF };
+		std::memcpy( rgba_ + i, entry, sizeof(entry));
+	}
+}
+
+/**
+ * Every pixel is written as a whole packed entry and the next pixel
+ * overwrites its alpha byte, only the last one is copied by bytes.
+ * With AVX2 eight entries are gathered at once and packed to 24 bytes.
+ */
+void
+Palette::expand( const unsigned char* src, unsigned char* dest,
+	size_t n) const
+{
+	size_t i = 0;
+
+#ifdef __AVX2__
+	// drop alpha bytes within each 128-bit lane: 4 pixels -> 12 bytes
+	const __m256i shuffle = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const int* table = reinterpret_cast<const int*>(rgba_);
+
+	// each step stores 28 bytes, keep the overlap within the buffer
+	for ( ; i + 10 <= n; i += 8, dest += 24) {
+		__m128i index = _mm_loadl_epi64(
+			reinterpret_cast<const __m128i*>(src + i));
+		__m256i pixels = _mm256_i32gather_epi32( table,
+			_mm256_cvtepu8_epi32(index), 4);
+		__m256i packed = _mm256_shuffle_epi8( pixels, shuffle);
+
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(dest),
+			_mm256_castsi256_si128(packed));
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(dest + 12),
+			_mm256_extracti128_si256( packed, 1));
+	}
+#endif
+
+	for ( ; i + 1 < n; ++i, dest += 3)
+		std::memcpy( dest, rgba_ + src[i], 4);
+
+	if (i < n)
+		std::memcpy( dest, rgba_ + src[i], 3);
 }
 
 } // namespace Image
@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace ScanAmati {
 
 namespace Image {
@@ -31,12 +34,30 @@ enum PaletteType {
 
 class Palette {
 public:
+	explicit Palette(PaletteType type = PALETTE_GRAYSCALE) { fill(type); }
 	static Palette* create(PaletteType type = PALETTE_GRAYSCALE);
 	void fill(PaletteType);
+	PaletteType type() const { return type_; }
 	unsigned char rgb(unsigned int i) const { return rgb_[i]; }
+	const uint32_t* rgba() const { return rgba_; } /**< packed RGBA entries */
+
+	/** \brief Expands palette indices into RGB triplets.
+	 * 
+	 * \param src  Palette indices (8-bit image buffer).
+	 * \param dest Destination buffer of 3 * n bytes.
+	 * \param n    Number of pixels.
+	 */
+	void expand( const unsigned char* src, unsigned char* dest,
+		size_t n) const;
+
 private:
-	enum SizeType { IMAGE_PALETTE_SIZE = 768 }; // 3 * 256
+	enum SizeType {
+		IMAGE_PALETTE_ENTRIES = 256,
+		IMAGE_PALETTE_SIZE = 768 // 3 * 256
+	};
+	PaletteType type_;
 	unsigned char rgb_[IMAGE_PALETTE_SIZE];
+	uint32_t rgba_[IMAGE_PALETTE_ENTRIES]; // R, G, B, 0xFF in memory order
 };
 
 } // namespace Image
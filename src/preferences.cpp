@@ -29,6 +29,7 @@ namespace {
 const char defaults[] = 
 "[ConQuest]\n"
 "localhost-server-directory=/var/www/cgi-bin\n"
+"query-cache-time=3600\n"
 "[Gui]\n"
 "window-height=600\n"
 "window-width=800\n"
@@ -36,6 +37,7 @@ const char defaults[] =
 "window-position-y=0\n"
 "window-hpaned-position=400\n"
 "window-vpaned-position=500\n"
+"image-store-memory-size=268435456\n"
 "image-acquisition-dialog-height=800\n"
 "image-acquisition-dialog-width=600\n"
 "image-acquisition-dialog-xray-high-voltage=40\n"
@@ -63,12 +65,29 @@ const char defaults[] =
 "conquest-archive-dialog-columns-width=322;219;80;64;99;315;120;320;\n"
 "dicom-informaion-dialog-height=500\n"
 "dicom-informaion-dialog-width=500\n"
+"[Network]\n"
+"association-idle-time=60\n"
+"store-associations=4\n"
+"spool-backoff-initial=10\n"
+"spool-backoff-maximum=600\n"
+"spool-max-attempts=20\n"
+"store-compression=jpeg-ls\n"
+"storage-scp-port=0\n"
+"storage-scp-associations=4\n"
+"storage-scp-calling-titles=\n"
+"[Files]\n"
+"dicom-compression=none\n"
+"retrieve-directory=\n"
+"[Index]\n"
+"directories=\n"
+"rescan-interval=300\n"
 "[APRMXXX]\n"
 "peltier-code=50\n"
 "chip-capacity=6.0\n"
 "temperature-control=true\n"
 "temperature-average=7.0\n"
-"temperature-spread=0.2\n";
+"temperature-spread=0.2\n"
+"movement-ramp=0.0\n";
 
 }
 
@@ -161,6 +180,13 @@ Preferences::has_group(const Glib::ustring& group) const
 	return keyfile_.has_group(group);
 }
 
+bool
+Preferences::has_key( const Glib::ustring& group,
+	const Glib::ustring& key) const
+{
+	return (keyfile_.has_group(group) && keyfile_.has_key( group, key));
+}
+
 Glib::ustring
 Preferences::get( const Glib::ustring& group_name,
 	const Glib::ustring& key, const Glib::ustring*) const
@@ -56,6 +56,7 @@ public:
 	void set( const Glib::ustring& group_name, const Glib::ustring& key,
 		Glib::ArrayHandle<int> values);
 	bool has_group(const Glib::ustring& group) const;
+	bool has_key( const Glib::ustring& group, const Glib::ustring& key) const;
 
 protected:
 	Glib::ustring get( const Glib::ustring& group_name,
@@ -17,9 +17,11 @@
 
 #include "adc_count.hpp"
 
-namespace {
+namespace ScanAmati {
+
+namespace Scanner {
 
-const guint8 rv[] = {
+const guint8 reversed_bits[256] = {
 	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30,
 	0xB0, 0x70, 0xF0, 0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98,
 	0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8, 0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64,
@@ -42,22 +44,6 @@ const guint8 rv[] = {
 	0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
 };
 
-} // namespace
-
-namespace ScanAmati {
-
-namespace Scanner {
-
-gint16
-AdcCount::pixel() const
-{
-#if SCANNER_ADC_RESOLUTION == 14
-	return (rv[byte.high] << 6) | (rv[byte.low] >> 2);
-#elif SCANNER_ADC_RESOLUTION == 12
-	return (rv[byte.high] << 4) | (rv[byte.low] >> 4);
-#endif
-}
-
 } // namespace Scanner
 
 } // namespace ScanAmati
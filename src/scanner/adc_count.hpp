@@ -23,25 +23,29 @@
 #include <glib.h>
 #endif
 
-#include "defines.hpp"
+#include "geometry.hpp"
 
 namespace ScanAmati {
 	
 namespace Scanner {
 
+extern const guint8 reversed_bits[256];
+
 union AdcCount {
 	AdcCount(guint16 v = 0) : value(v) {}
 	AdcCount( guint8 l = 0, guint8 h = 0) { byte.low = l; byte.high = h; }
 	guint16 temperature_code() const { return byte.high << 8 | byte.low; }
-	gint16 pixel() const;
-#if SCANNER_ADC_RESOLUTION == 14
-	bool data_bit() const { return byte.low & 0x80; }
-	bool chip_bit() const { return byte.low & 0x40; }
-#elif SCANNER_ADC_RESOLUTION == 12
-	bool data_bit() const { return byte.low & 0x40; }
-	bool chip_bit() const { return byte.low & 0x20; }
-	bool test_bit() const { return byte.low & 0x10; }
-#endif
+
+	template <typename G> gint16 pixel() const;
+	template <typename G> bool data_bit() const;
+	template <typename G> bool chip_bit() const;
+	template <typename G> bool test_bit() const;
+
+	gint16 pixel() const { return pixel<DefaultGeometry>(); }
+	bool data_bit() const { return data_bit<DefaultGeometry>(); }
+	bool chip_bit() const { return chip_bit<DefaultGeometry>(); }
+	bool test_bit() const { return test_bit<DefaultGeometry>(); }
+
 	guint16 value;
 	struct {
 		guint8 low;
@@ -49,6 +53,39 @@ union AdcCount {
 	} byte;
 };
 
+template <typename G>
+inline
+gint16
+AdcCount::pixel() const
+{
+	return (reversed_bits[byte.high] << G::high_shift) |
+		(reversed_bits[byte.low] >> G::low_shift);
+}
+
+template <typename G>
+inline
+bool
+AdcCount::data_bit() const
+{
+	return byte.low & G::data_bit;
+}
+
+template <typename G>
+inline
+bool
+AdcCount::chip_bit() const
+{
+	return byte.low & G::chip_bit;
+}
+
+template <typename G>
+inline
+bool
+AdcCount::test_bit() const
+{
+	return byte.low & G::test_bit;
+}
+
 } // namespace Scanner
 
 } // namespace ScanAmati
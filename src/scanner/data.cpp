@@ -29,6 +29,9 @@
 /* files from src directory begin */
 #include "global_strings.hpp"
 #include "application.hpp"
+#include "image/flat_field.hpp"
+#include "image/destripe.hpp"
+#include "image/row_resampler.hpp"
 /* files from src directory end */
 
 namespace {
@@ -52,6 +55,36 @@ not_null(bool value)
 	return value;
 }
 
+/**
+ * Fractional source row at the center of every output row, the source
+ * rows are at the positions of the movement.
+ */
+std::vector<double>
+source_rows( const std::vector<double>& positions, unsigned int rows)
+{
+	std::vector<double> result(rows);
+	if (positions.empty())
+		return result;
+
+	unsigned int last = positions.size() - 1;
+
+	unsigned int j = 0;
+	for ( unsigned int i = 0; i < rows; ++i) {
+		double pos = (i + .5) / rows;
+		while (j < last && positions[j + 1] <= pos)
+			++j;
+
+		if (pos <= positions.front())
+			result[i] = 0.;
+		else if (j == last)
+			result[i] = last;
+		else
+			result[i] = j + (pos - positions[j]) /
+				(positions[j + 1] - positions[j]);
+	}
+	return result;
+}
+
 } // namespace
 
 namespace ScanAmati {
@@ -61,7 +94,8 @@ namespace Scanner {
 Data::Data()
 	:
 	memory_(0),
-	assembly_(SCANNER_CHIPS),
+	geometry_(Scanner::geometry(default_geometry_type())),
+	assembly_(geometry_.chips),
 	data_offset_(0),
 	chip_offset_(0),
 	image_height_(IMAGE_HEIGHT),
@@ -70,11 +104,22 @@ Data::Data()
 	width_type_(WIDTH_FULL),
 	calibration_type_(CALIBRATION_GOOD),
 	intensity_type_(INTENSITY_ORIGINAL),
-	lining_count_(SCANNER_LINING_COUNT)
+	data_type_(DATA_RAW),
+	destripe_type_(DESTRIPE_NONE),
+	motion_type_(MOTION_UNIFORM),
+	image_filter_type_(Image::FILTER_NONE),
+	movement_(system_movements[1]),
+	movement_ramp_(0.),
+	lining_count_(SCANNER_LINING_COUNT),
+	thread_(0),
+	busy_(false),
+	cancel_(false),
+	quit_(false),
+	progress_(0.0)
 {
 	memory_ = new guint8[SCANNER_MEMORY_ALL];
 
-	const char* code = array_chip_codes;
+	const char* code = geometry_.chip_codes;
 
 	for ( AssemblyIter it = assembly_.begin(); it != assembly_.end(); ++it)
 		it->code = *code++;
@@ -82,23 +127,48 @@ Data::Data()
 
 Data::~Data()
 {
+	if (thread_) {
+		{
+			Glib::Mutex::Lock lock(jobs_mutex_);
+			quit_ = true;
+			cancel_ = true;
+			jobs_cond_.signal();
+		}
+		thread_->join();
+	}
 	delete [] memory_;
 }
 
-guint
-Data::chip_number(char code)
+void
+Data::set_geometry(GeometryType type)
 {
-	const char* start = array_chip_codes;
-	const char* end = array_chip_codes + SCANNER_CHIPS;
+	// the lining and bad strips are loaded after it too
+	wait_image_reconstruction();
 
-	const char* pos = std::find( start, end, code);
-	return (pos - array_chip_codes);
-}
+	if (type == geometry_.type)
+		return;
 
-char
-Data::chip_code(guint number)
-{
-	return (number < SCANNER_CHIPS) ? array_chip_codes[number] : 0;
+	geometry_ = Scanner::geometry(type);
+	assembly_ = AssemblyVector(geometry_.chips);
+
+	const char* code = geometry_.chip_codes;
+
+	for ( AssemblyIter it = assembly_.begin(); it != assembly_.end(); ++it)
+		it->code = *code++;
+
+	data_offset_ = 0;
+	chip_offset_ = 0;
+
+	decode_stage_.clear();
+	pedestal_stage_.clear();
+	resample_stage_.clear();
+	assemble_stage_.clear();
+	calibrate_stage_.clear();
+	strips_stage_.clear();
+	destripe_stage_.clear();
+	filter_stage_.clear();
+	levels_stage_.clear();
+	intensity_stage_.clear();
 }
 
 void
@@ -109,12 +179,12 @@ Data::width_iterators( WidthType width_type,
 	end = assembly_.end();
 	switch (width_type) {
 	case WIDTH_HALF:
-		begin += SCANNER_CHIPS_DROP_HALF;
-		end -= SCANNER_CHIPS_DROP_HALF;
+		begin += geometry_.chips / 4;
+		end -= geometry_.chips / 4;
 		break;
 	case WIDTH_QUARTER:
-		begin += SCANNER_CHIPS_DROP_QUARTER;
-		end -= SCANNER_CHIPS_DROP_QUARTER;
+		begin += geometry_.chips * 3 / 8;
+		end -= geometry_.chips * 3 / 8;
 		break;
 	case WIDTH_FULL:
 	default:
@@ -130,12 +200,12 @@ Data::width_iterators( WidthType width_type,
 	end = assembly_.end();
 	switch (width_type) {
 	case WIDTH_HALF:
-		begin += SCANNER_CHIPS_DROP_HALF;
-		end -= SCANNER_CHIPS_DROP_HALF;
+		begin += geometry_.chips / 4;
+		end -= geometry_.chips / 4;
 		break;
 	case WIDTH_QUARTER:
-		begin += SCANNER_CHIPS_DROP_QUARTER;
-		end -= SCANNER_CHIPS_DROP_QUARTER;
+		begin += geometry_.chips * 3 / 8;
+		end -= geometry_.chips * 3 / 8;
 		break;
 	case WIDTH_FULL:
 	default:
@@ -244,6 +314,12 @@ Data::load_bad_strips(const std::string& filename)
 	return true;
 }
 
+/**
+ * Chips, strips and ADC bit layout are constants of the geometry G
+ * in the decoding kernels below, decode() selects the instantiation
+ * for the connected scanner.
+ */
+template <typename G>
 void
 Data::preprocess(AcquireType acquire_type)
 {
@@ -260,74 +336,75 @@ Data::preprocess(AcquireType acquire_type)
 	}
 
 	// find data offset
-	for ( guint i = 0; i < SCANNER_STRIPS; ++i) {
-		if (AdcCount(AdcData_.counts[i]).data_bit()) {
+	for ( guint i = 0; i < G::strips; ++i) {
+		if (AdcCount(AdcData_.counts[i]).data_bit<G>()) {
 			data_offset_ = i;
 			break;
 		}
 	}
 
 	// find chip offset (data from memory)
-	std::vector<bool> row(SCANNER_STRIPS);
-	for ( int j = 0; j < SCANNER_STRIPS_PER_CHIP; ++j) {
-		for ( int i = 0; i < SCANNER_CHIPS; ++i) {
-			int dest = i * SCANNER_STRIPS_PER_CHIP + j; // row pos
-			int src = j * SCANNER_CHIPS + i + data_offset_; // memory pos
+	std::vector<bool> row(G::strips);
+	for ( int j = 0; j < G::strips_per_chip; ++j) {
+		for ( int i = 0; i < G::chips; ++i) {
+			int dest = i * G::strips_per_chip + j; // row pos
+			int src = j * G::chips + i + data_offset_; // memory pos
 
-			row[dest] = AdcCount(AdcData_.counts[src]).chip_bit();
+			row[dest] = AdcCount(AdcData_.counts[src]).chip_bit<G>();
 		}
 	}
 
 	std::vector<bool>::const_reverse_iterator pos = std::find_if( row.rbegin(),
 		row.rend(), not_null);
 
-	chip_offset_ = (pos - row.rbegin()) / SCANNER_STRIPS_PER_CHIP;
+	chip_offset_ = (pos - row.rbegin()) / G::strips_per_chip;
 	chip_offset_ += 1;
 }
 
+template <typename G>
 Image::DataSharedPtr
 Data::image_from_memory(AcquireType acquire) const
 {
 	Image::DataSharedPtr image;
 
-	unsigned int rows = IMAGE_ROWS;
+	unsigned int rows = ((SCANNER_MEMORY >> 1) / G::strips) - 2;
 
 	switch (acquire) {
 	case ACQUIRE_IMAGE:
-		rows = (((memory_size_ >> 1) / SCANNER_STRIPS) - 2);
+		rows = (((memory_size_ >> 1) / G::strips) - 2);
 		break;
 	case ACQUIRE_IMAGE_PEDESTALS:
 	case ACQUIRE_LINING_PEDESTALS:
-		rows = (((SCANNER_MEMORY_PART >> 1) / SCANNER_STRIPS) - 2);
+		rows = (((SCANNER_MEMORY_PART >> 1) / G::strips) - 2);
 		break;
 	default:
 		break;
 	}
 
-	image = Image::Data::create( SCANNER_STRIPS, rows);
+	image = Image::Data::create( G::strips, rows);
+	image->set_adc_bits(G::adc_bits);
 
 	// data from memory
 	for ( unsigned int k = 0; k < rows; ++k) {
-		for ( unsigned int j = 0; j < SCANNER_STRIPS_PER_CHIP; ++j) {
-			for ( unsigned int i = 0; i < SCANNER_CHIPS; ++i) {
-				unsigned int dest = i * SCANNER_STRIPS_PER_CHIP + j + // column
-					k * SCANNER_STRIPS; // row
-				unsigned int src = j * SCANNER_CHIPS + i + // column
-					k * SCANNER_STRIPS + data_offset_; // row
-
-				image->pixel(dest) = AdcCount(AdcData_.counts[src]).pixel();
+		const guint16* counts = AdcData_.counts + k * G::strips + data_offset_;
+		gint16* dest = image->begin() + k * G::strips;
+
+		for ( unsigned int j = 0; j < G::strips_per_chip; ++j) {
+			for ( unsigned int i = 0; i < G::chips; ++i) {
+				dest[i * G::strips_per_chip + j] = // column
+					AdcCount(counts[j * G::chips + i]).pixel<G>();
 			}
 		}
 	}
 
 	// Shift first strip for the first four assembly
-	for ( unsigned int i = 0; i < SCANNER_CHIPS; ++i) {
-		// skip assembly [4, 15]
+	for ( unsigned int i = 0; i < G::chips; ++i) {
+		// skip assembly [4, chips)
 		if (i > 3)
 			continue;
 
-		unsigned int from = i * SCANNER_STRIPS_PER_CHIP;
-		unsigned int to = (i + 1) * SCANNER_STRIPS_PER_CHIP;
+		unsigned int from = i * G::strips_per_chip;
+		unsigned int to = (i + 1) * G::strips_per_chip;
 		Image::DataSharedPtr data = image->get_vertical_part( from, to);
 		data->shift_columns();
 		image->set_vertical_part( data, from, to);
@@ -336,54 +413,80 @@ Data::image_from_memory(AcquireType acquire) const
 	return image;
 }
 
+template <typename G>
 std::vector<Image::DataSharedPtr>
 Data::form_assembly_array(const Image::DataSharedPtr& image) const
 {
 	// assembly array
-	std::vector<Image::DataSharedPtr> array(SCANNER_CHIPS);
+	std::vector<Image::DataSharedPtr> array(G::chips);
 
 	// drop service strips
 	guint i = 0;
 	std::vector<Image::DataSharedPtr>::iterator it;
 	for ( it = array.begin(); it != array.end(); ++it, ++i) {
-		int from = i * SCANNER_STRIPS_PER_CHIP;
-		int to = i * SCANNER_STRIPS_PER_CHIP + IMAGE_STRIPS_PER_CHIP;
+		int from = i * G::strips_per_chip;
+		int to = i * G::strips_per_chip + G::image_strips_per_chip;
 		*it = image->get_vertical_part( from, to);
 	}
 
 	// rotate to the start of the frame
-	if (chip_offset_ != SCANNER_CHIPS) {
-		guint offset = SCANNER_CHIPS - chip_offset_;
+	if (chip_offset_ != G::chips) {
+		guint offset = G::chips - chip_offset_;
 		std::rotate( array.begin(), array.begin() + offset, array.end());
 	}
 
 	return array;
 }
 
-void
-Data::reconstruct( AcquireType acquire, guint8 arg)
+template <typename G>
+std::vector<Image::DataSharedPtr>
+Data::decode(AcquireType acquire)
 {
 	// preprocess
-	preprocess(acquire);
+	preprocess<G>(acquire);
 
 	// forms raw image
-	Image::DataSharedPtr image = image_from_memory(acquire);
+	Image::DataSharedPtr image = image_from_memory<G>(acquire);
+
+	if (acquire == ACQUIRE_IMAGE) {
+		std::ofstream file("/tmp/raw_image.raw");
+		file << image;
+		file.close();
+	}
 
-	// drop service strips, rotate to the start of the frame, write to assembly
-	std::vector<Image::DataSharedPtr> array = form_assembly_array(image);
+	// drop service strips, rotate to the start of the frame
+	return form_assembly_array<G>(image);
+}
 
+std::vector<Image::DataSharedPtr>
+Data::decode(AcquireType acquire)
+{
+	switch (geometry_.type) {
+	case GEOMETRY_16_CHIPS_12_BITS:
+		return decode< GeometryTraits< 16, 12> >(acquire);
+	case GEOMETRY_12_CHIPS_14_BITS:
+		return decode< GeometryTraits< 12, 14> >(acquire);
+	case GEOMETRY_12_CHIPS_12_BITS:
+		return decode< GeometryTraits< 12, 12> >(acquire);
+	case GEOMETRY_16_CHIPS_14_BITS:
+	default:
+		return decode< GeometryTraits< 16, 14> >(acquire);
+	}
+}
+
+void
+Data::reconstruct( AcquireType acquire, guint8 arg)
+{
 	switch (acquire) {
 	case ACQUIRE_IMAGE:
-		{
-			std::ofstream file("/tmp/raw_image.raw");
-			file << image;
-			file.close();
-		}
-		reconstruct_image(array);
+		run_image_reconstruction(boost::any());
 		break;
 	case ACQUIRE_IMAGE_PEDESTALS:
 	case ACQUIRE_LINING_PEDESTALS:
-		reconstruct_pedestals( acquire, array, arg);
+		// the worker reads the pedestals and the decoding offsets
+		wait_image_reconstruction();
+		reconstruct_pedestals( acquire, decode(acquire), arg);
+		pedestal_stage_.clear();
 		break;
 	default:
 		break;
@@ -425,25 +528,59 @@ Data::reconstruct_pedestals( AcquireType acquire,
 	}
 }
 
-void
-Data::reconstruct_image(const std::vector<Image::DataSharedPtr>& array)
+std::vector<Image::DataSharedPtr>
+Data::subtract_pedestals(const std::vector<Image::DataSharedPtr>& array) const
 {
-	// copy array data to assembly vector
+	DataArray result(array);
+
 	guint i = 0;
-	AssemblyIter it;
+	AssemblyConstIter it;
 	for ( it = assembly_.begin(); it != assembly_.end(); ++it, ++i) {
 		if (it->pedestals.size()) {
-			array[i]->subtract_row(it->pedestals);
-			array[i]->add_value(lining_count_);
-			array[i]->normalize();
+			// pedestals, lining count and clamping in one pass
+			Image::FlatField field(array[i]->width());
+			field.set_pedestals(it->pedestals);
+			field.set_offset(lining_count_);
+
+			// decoded frames are kept by the previous stage
+			result[i] = Image::Data::create_from_shared(array[i]);
+			field.apply(result[i]);
+		}
+	}
+	return result;
+}
+
+std::vector<Image::DataSharedPtr>
+Data::resample(const std::vector<Image::DataSharedPtr>& array)
+{
+	DataArray result(array.size());
+	const unsigned int& rows = image_height_;
+
+	// the rows weights are shared by the chips of the same height
+	Image::RowResampler resampler;
+
+	guint i = 0;
+	AssemblyIter it;
+	for ( it = assembly_.begin(); it != assembly_.end(); ++it, ++i) {
+		if (cancelled())
+			break;
+
+		if (motion_type_ == MOTION_PROFILE) {
+			unsigned int height = array[i]->height();
+			if (resampler.source_height() != height)
+				resampler.set_positions( height, source_rows(
+					row_positions( movement_, movement_ramp_, height), rows));
+			result[i] = resampler.apply(array[i]);
+			it->raw_data = result[i];
+			continue;
 		}
 
-		const unsigned int& rows = image_height_;
 		// resize Image
-		Magick::Image image( IMAGE_STRIPS_PER_CHIP, array[i]->height(), "I",
+		const unsigned int& columns = geometry_.image_strips_per_chip;
+		Magick::Image image( columns, array[i]->height(), "I",
 			Magick::ShortPixel, array[i]->data());
 
-		Magick::Geometry geom( IMAGE_STRIPS_PER_CHIP, rows);
+		Magick::Geometry geom( columns, rows);
 		geom.aspect(true);
 		image.filterType(filter_type_);
 //#if (MagickLibVersion >= 0x660 && MagickLibVersion <= 0x669) 
@@ -453,173 +590,396 @@ Data::reconstruct_image(const std::vector<Image::DataSharedPtr>& array)
 //#endif
 
 		const Magick::PixelPacket* pixel = image.getConstPixels( 0, 0,
-			IMAGE_STRIPS_PER_CHIP, rows);
+			columns, rows);
+
+		result[i] = Image::Data::create( columns, rows);
+		result[i]->set_adc_bits(geometry_.adc_bits);
+		for ( unsigned int j = 0; j < columns * rows; ++j)
+			result[i]->pixel(j) = pixel++->red; // pixel->red; ++pixel;
+
+		it->raw_data = result[i];
+	}
+	return result;
+}
+
+/**
+ * Stages run in order decode, pedestals, resample, assemble, calibrate,
+ * strips, destripe, filter, levels and intensity. A stage is skipped if
+ * its cached output was made with the current parameters and no stage
+ * before it has been made again, so changing the pixel intensity or the
+ * levels recomputes only the tail of the chain.
+ */
+bool
+Data::reconstruct_stages()
+{
+	const double stages = 10.;
+	bool dirty = false;
+
+	set_progress(0.);
+	if (!decode_stage_.valid(memory_size_)) {
+		DataArray array = decode(ACQUIRE_IMAGE);
+		if (cancelled())
+			return false;
+		decode_stage_.set( memory_size_, array);
+		dirty = true;
+	}
+
+	set_progress(1. / stages);
+	if (dirty || !pedestal_stage_.valid(lining_count_)) {
+		DataArray array = subtract_pedestals(decode_stage_.value());
+		if (cancelled())
+			return false;
+		pedestal_stage_.set( lining_count_, array);
+		dirty = true;
+	}
+
+	set_progress(2. / stages);
+	ResampleKey resample_key( filter_type_, image_height_, motion_type_);
+	if (dirty || !resample_stage_.valid(resample_key)) {
+		DataArray array = resample(pedestal_stage_.value());
+		if (cancelled())
+			return false;
+		resample_stage_.set( resample_key, array);
+		dirty = true;
+	}
+
+	set_progress(3. / stages);
+	if (dirty || !assemble_stage_.valid(width_type_)) {
+		assemble_stage_.set( width_type_, form_image(width_type_));
+		dirty = true;
+	}
+
+	if (!assemble_stage_.value()) {
+		image_data_ = Image::SummaryData();
+		return true;
+	}
+
+	set_progress(4. / stages);
+	CalibrateKey calibrate_key( data_type_, calibration_type_);
+	if (dirty || !calibrate_stage_.valid(calibrate_key)) {
+		Image::DataSharedPtr image = assemble_stage_.value();
+		if (data_type_ == DATA_CALIBRATED)
+			image = calibrate( image, form_bad_strips(width_type_),
+				calibration_type_);
+		if (cancelled())
+			return false;
+		calibrate_stage_.set( calibrate_key, image);
+		dirty = true;
+	}
+
+	set_progress(5. / stages);
+	if (dirty || !strips_stage_.valid(data_type_)) {
+		Image::DataSharedPtr image = calibrate_stage_.value();
+		if (data_type_ == DATA_CALIBRATED)
+			image = repair_strips( image, form_bad_strips(width_type_));
+		if (cancelled())
+			return false;
+		strips_stage_.set( data_type_, image);
+		dirty = true;
+	}
+
+	set_progress(6. / stages);
+	if (dirty || !destripe_stage_.valid(destripe_type_)) {
+		Image::DataSharedPtr image = strips_stage_.value();
+		if (destripe_type_ == DESTRIPE_COLUMNS)
+			image = destripe(image);
+		if (cancelled())
+			return false;
+		destripe_stage_.set( destripe_type_, image);
+		dirty = true;
+	}
 
-		it->raw_data = Image::Data::create( IMAGE_STRIPS_PER_CHIP, rows);
-		for ( unsigned int i = 0; i < IMAGE_STRIPS_PER_CHIP * rows; ++i)
-			it->raw_data->pixel(i) = pixel++->red; // pixel->red; ++pixel;
+	set_progress(7. / stages);
+	if (dirty || !filter_stage_.valid(image_filter_type_)) {
+		Image::DataSharedPtr image = Image::filter( destripe_stage_.value(),
+			image_filter_type_);
+		if (cancelled())
+			return false;
+		filter_stage_.set( image_filter_type_, image);
+		dirty = true;
 	}
+
+	set_progress(8. / stages);
+	if (dirty || !levels_stage_.valid(levels_)) {
+		Image::DataSharedPtr image = filter_stage_.value();
+		if (levels_.size() == 3) {
+			image = Image::Data::create_from_shared(image);
+			image->set_levels( levels_[0], levels_[1], levels_[2]);
+		}
+		if (cancelled())
+			return false;
+		levels_stage_.set( levels_, image);
+		dirty = true;
+	}
+
+	set_progress(9. / stages);
+	if (dirty || !intensity_stage_.valid(intensity_type_)) {
+		// intensity changes the pixels, keep the levels output intact
+		Image::DataSharedPtr image = levels_stage_.value();
+		if (intensity_type_ != INTENSITY_ORIGINAL)
+			image = Image::Data::create_from_shared(image);
+		if (!fill_image_data( image, intensity_type_))
+			return false;
+		intensity_stage_.set( intensity_type_, image_data_);
+	}
+
+	image_data_ = intensity_stage_.value();
+	set_progress(1.);
+	return true;
 }
 
 void
 Data::run_image_reconstruction(const boost::any& arg)
 {
-	sigc::slot<void> slot;
+	ReconstructionJob job;
 
 	if (arg.type() == typeid(PixelIntensityType)) {
 		PixelIntensityType intensity =
 			boost::any_cast<PixelIntensityType>(arg);
-		slot = sigc::bind(
-			sigc::mem_fun( *this, &Data::reconstruct_image_intensity),
+		job.type = JOB_INTENSITY;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_intensity_type),
 			intensity);
 	}
 	else if (arg.type() == typeid(Magick::FilterTypes)) {
 		Magick::FilterTypes filter =
 			boost::any_cast<Magick::FilterTypes>(arg);
-		slot = sigc::bind(
-			sigc::mem_fun( *this, &Data::reconstruct_image_filter),
+		job.type = JOB_FILTER;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_filter_type),
 			filter);
 	}
 	else if (arg.type() == typeid(std::vector<double>)) {
 		std::vector<double> lvl =
 			boost::any_cast< std::vector<double> >(arg);
-		slot = sigc::bind(
-			sigc::mem_fun( *this, &Data::reconstruct_image_levels),
+		job.type = JOB_LEVELS;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_levels),
 			lvl);
 	}
 	else if (arg.type() == typeid(WidthType)) {
 		WidthType width = boost::any_cast<WidthType>(arg);
-		slot = sigc::bind(
-			sigc::mem_fun( *this, &Data::reconstruct_image_width),
+		job.type = JOB_WIDTH;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_width_type),
 			width);
 	}
 	else if (arg.type() == typeid(DataType)) {
 		DataType data_type = boost::any_cast<DataType>(arg);
-		slot = sigc::bind(
-			sigc::mem_fun( *this, &Data::reconstruct_image_data),
+		job.type = JOB_DATA;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_data_type),
 			data_type);
 	}
+	else if (arg.type() == typeid(DestripeType)) {
+		DestripeType destripe = boost::any_cast<DestripeType>(arg);
+		job.type = JOB_DESTRIPE;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_destripe_type),
+			destripe);
+	}
+	else if (arg.type() == typeid(MotionType)) {
+		MotionType motion = boost::any_cast<MotionType>(arg);
+		job.type = JOB_MOTION;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_motion_type),
+			motion);
+	}
+	else if (arg.type() == typeid(Image::FilterType)) {
+		Image::FilterType filter = boost::any_cast<Image::FilterType>(arg);
+		job.type = JOB_IMAGE_FILTER;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_image_filter_type),
+			filter);
+	}
 	else if (arg.type() == typeid(CalibrationType)) {
 		CalibrationType accuracy = boost::any_cast<CalibrationType>(arg);
-		slot = sigc::bind(
-			sigc::mem_fun( *this, &Data::reconstruct_image_calibration),
+		job.type = JOB_CALIBRATION;
+		job.apply = sigc::bind(
+			sigc::mem_fun( *this, &Data::set_calibration_type),
 			accuracy);
 	}
+	else {
+		job.type = JOB_IMAGE;
+		job.apply = sigc::mem_fun( *this, &Data::set_new_image);
+	}
+
+	Glib::Mutex::Lock lock(jobs_mutex_);
+
+	std::deque<ReconstructionJob>::iterator iter;
+	for ( iter = jobs_.begin(); iter != jobs_.end(); ++iter) {
+		if (iter->type == job.type)
+			break;
+	}
+	if (iter != jobs_.end())
+		iter->apply = job.apply; // newer parameter supersedes queued one
 	else
-		slot = sigc::mem_fun( *this, &Data::reconstruct_image_from_scratch);
+		jobs_.push_back(job);
+
+	// the running jobs are superseded too
+	cancel_ = busy_;
+	busy_ = true;
 
-	thread_ = Glib::Thread::create( slot, true);
+	if (!thread_)
+		thread_ = Glib::Thread::create(
+			sigc::mem_fun( *this, &Data::run_worker), true);
+	jobs_cond_.signal();
 }
 
 void
-Data::reconstruct_image_from_scratch()
+Data::cancel_image_reconstruction()
 {
-	reconstruct( ACQUIRE_IMAGE, 0);
+	Glib::Mutex::Lock lock(jobs_mutex_);
+	jobs_.clear();
+	cancel_ = true;
+}
 
-	Image::DataSharedPtr image = form_image(width_type_);
-	if (image) {
-		std::vector<guint> bs = form_bad_strips(width_type_);
-//		Image::DataSharedPtr result = calibrate( image, bs, calibration_type_);
-//		calibrated_image_ = result->get_horizontal_part( 0, margins[0].end);
-//		image->normalize();
-//		calibrated_image_ = image;
-//		image->fix_strips(bs);
-		fill_image_data( image, intensity_type_);
-	}
+/**
+ * Drop the queued jobs, cancel the running one and wait for the worker
+ * to become idle. Called before the scanner memory, the assembly or the
+ * stages are changed outside the worker thread.
+ */
+void
+Data::wait_image_reconstruction()
+{
+	Glib::Mutex::Lock lock(jobs_mutex_);
+	jobs_.clear();
+	cancel_ = busy_;
+	while (busy_)
+		idle_cond_.wait(jobs_mutex_);
+}
+
+bool
+Data::busy() const
+{
+	Glib::Mutex::Lock lock(jobs_mutex_);
+	return busy_;
+}
+
+double
+Data::progress() const
+{
+	Glib::Mutex::Lock lock(jobs_mutex_);
+	return progress_;
+}
+
+bool
+Data::cancelled() const
+{
+	Glib::Mutex::Lock lock(jobs_mutex_);
+	return cancel_;
+}
 
-	signal_complete_();
+void
+Data::set_progress(double progress)
+{
+	Glib::Mutex::Lock lock(jobs_mutex_);
+	progress_ = progress;
 }
 
+/**
+ * Reconstruction worker, it runs all queued jobs at once: the job
+ * parameters are set in the queue order and the stages are made
+ * only once for them.
+ */
 void
-Data::reconstruct_image_filter(Magick::FilterTypes filter)
+Data::run_worker()
 {
-/*	filter_type_ = filter;
+	while (1) {
+		std::deque<ReconstructionJob> jobs;
+		{
+			Glib::Mutex::Lock lock(jobs_mutex_);
+			while (!quit_ && jobs_.empty()) {
+				busy_ = false;
+				idle_cond_.broadcast();
+				jobs_cond_.wait(jobs_mutex_);
+			}
+			if (quit_)
+				break;
 
-	reconstruct( ACQUIRE_IMAGE, 0);
+			jobs.swap(jobs_);
+			busy_ = true;
+			cancel_ = false;
+		}
+
+		for ( std::deque<ReconstructionJob>::iterator iter = jobs.begin();
+			iter != jobs.end(); ++iter)
+			iter->apply();
 
-	Image::DataSharedPtr image = form_image(width_type_);
-	if (image) {		
-		std::vector<guint> bs = form_bad_strips(width_type_);
-//		Image::DataSharedPtr result = calibrate( image, bs, calibration_type_);
-//		calibrated_image_ = result->get_horizontal_part( 0, margins[0].end);
-		image->normalize();
-		calibrated_image_ = image;
-		form_image_tuple( calibrated_image_, intensity_type_);
+		if (reconstruct_stages()) {
+			{
+				// the image is readable unless new jobs have come
+				Glib::Mutex::Lock lock(jobs_mutex_);
+				busy_ = !jobs_.empty();
+			}
+			OFLOG_DEBUG( app.log, "Image reconstruction has been finished");
+			signal_complete_();
+		}
+		else
+			OFLOG_DEBUG( app.log, "Image reconstruction has been cancelled");
 	}
-*/
-	signal_complete_();
 }
 
 void
-Data::reconstruct_image_intensity(PixelIntensityType intensity)
+Data::set_new_image()
 {
-/*	intensity_type_ = intensity;
-	Image::DataSharedPtr image =
-		Image::Data::create_from_shared(calibrated_image_);
-	if (image)
-		form_image_tuple( image, intensity);
+	// new data in memory, nothing from the previous image is valid
+	decode_stage_.clear();
+	levels_.clear();
+}
 
-*/	signal_complete_();
+void
+Data::set_filter_type(Magick::FilterTypes filter)
+{
+	filter_type_ = filter;
 }
 
 void
-Data::reconstruct_image_levels(std::vector<double> levels)
+Data::set_intensity_type(PixelIntensityType intensity)
 {
-/*	Image::DataSharedPtr image =
-		Image::Data::create_from_shared(calibrated_image_);
-	
-	if (image) {
-		image->set_levels( levels[0], levels[1], levels[2]);
-		form_image_tuple( image, intensity_type_);
-	}
-*/	signal_complete_();
+	intensity_type_ = intensity;
 }
 
 void
-Data::reconstruct_image_calibration(CalibrationType accuracy)
+Data::set_levels(std::vector<double> levels)
 {
-/*	calibration_type_ = accuracy;
-	Image::DataSharedPtr image = form_image(width_type_);
-	if (image) {		
-		std::vector<guint> bs = form_bad_strips(width_type_);
-		calibrated_image_ = calibrate( image, bs, accuracy);
-		form_image_tuple( calibrated_image_, intensity_type_);
-	}
-*/	signal_complete_();
+	levels_ = levels;
 }
 
 void
-Data::reconstruct_image_width(WidthType width)
+Data::set_calibration_type(CalibrationType accuracy)
 {
-/*	width_type_ = width;
-	Image::DataSharedPtr image = form_image(width);
-	if (image) {		
-		std::vector<guint> bs = form_bad_strips(width);
-		calibrated_image_ = calibrate( image, bs, calibration_type_);
-		form_image_tuple( calibrated_image_, intensity_type_);
-	}
-*/	signal_complete_();
+	calibration_type_ = accuracy;
 }
 
 void
-Data::reconstruct_image_data(DataType data_type)
+Data::set_width_type(WidthType width)
 {
-/*	Image::DataSharedPtr image;
-	switch (data_type) {
-	case DATA_RAW:
-		image = form_image(width_type_);
-		break;
-	case DATA_CALIBRATED:
-		image = calibrated_image_;
-		break;
-	default:
-		break;
-	}
-	if (image) {
-		fill_image_data( image, INTENSITY_ORIGINAL);
-	}
-*/
-	signal_complete_();
+	width_type_ = width;
+}
+
+void
+Data::set_data_type(DataType data_type)
+{
+	data_type_ = data_type;
+}
+
+void
+Data::set_destripe_type(DestripeType destripe)
+{
+	destripe_type_ = destripe;
+}
+
+void
+Data::set_motion_type(MotionType motion)
+{
+	motion_type_ = motion;
+}
+
+void
+Data::set_image_filter_type(Image::FilterType filter)
+{
+	image_filter_type_ = filter;
 }
 
 void
@@ -663,12 +1023,34 @@ Data::calibrate( const Image::DataSharedPtr& raw,
 	calib.expand( begin, end);
 */
 	clear = calib.calibrate(raw);
+	return clear;
+}
+
+Image::DataSharedPtr
+Data::repair_strips( const Image::DataSharedPtr& image,
+	const std::vector<guint>& bs) const
+{
+	Image::DataSharedPtr clear = Image::Data::create_from_shared(image);
 
 	clear->fix_strips(bs);
 	clear->normalize();
 	return clear;
 }
 
+Image::DataSharedPtr
+Data::destripe(const Image::DataSharedPtr& image) const
+{
+	Image::Destriper destriper;
+
+	if (!destriper.estimate(image))
+		return image;
+
+	Image::DataSharedPtr clear = Image::Data::create_from_shared(image);
+	destriper.apply(clear);
+	clear->normalize();
+	return clear;
+}
+
 Image::DataSharedPtr
 Data::form_image(WidthType width_type)
 {
@@ -678,20 +1060,22 @@ Data::form_image(WidthType width_type)
 	width_iterators( width_type, begin, end);
 
 	if (check_image_data( begin, end)) {
-		unsigned int width = (end - begin) * SCANNER_STRIPS_PER_CHIP_REAL;
+		const unsigned int& columns = geometry_.image_strips_per_chip;
+		unsigned int width = (end - begin) * columns;
 		image = Image::Data::create( width, image_height_);
+		image->set_adc_bits(geometry_.adc_bits);
 
 		for ( AssemblyConstIter it = begin; it != end; ++it) {
 			guint i = it - begin;
-			int from = i * IMAGE_STRIPS_PER_CHIP;
-			int to = (i + 1) * IMAGE_STRIPS_PER_CHIP;
+			int from = i * columns;
+			int to = (i + 1) * columns;
 			image->set_vertical_part( it->raw_data, from, to);
 		}
 	}
 	return image;
 }
 
-void
+bool
 Data::fill_image_data( Image::DataSharedPtr& image,
 	PixelIntensityType intensity_type)
 {
@@ -702,6 +1086,9 @@ Data::fill_image_data( Image::DataSharedPtr& image,
 
 	for ( gint16* pos = image->begin(); pos != image->end(); ++pos) {
 		ptrdiff_t i = pos - image->begin();
+		if (!(i % image->width()) && cancelled())
+			return false;
+
 		switch (intensity_type) {
 		case INTENSITY_LOGARITHMIC:
 			{
@@ -709,20 +1096,20 @@ Data::fill_image_data( Image::DataSharedPtr& image,
 				double mx = log(max + 1);
 				double value = (log(*pos + 1) - mn) / (mx - mn);
 				buf[i] = static_cast<guint8>(UCHAR_MAX * value);
-				*pos = static_cast<gint16>(SCANNER_ADC_COUNT_MAX * value);
+				*pos = static_cast<gint16>(geometry_.adc_count_max * value);
 			}
 			break;
 		case INTENSITY_LINEAR:
 			{
 				double value = double(*pos - min) / (max - min);
 				buf[i] = static_cast<guint8>(UCHAR_MAX * value);
-				*pos = static_cast<gint16>(SCANNER_ADC_COUNT_MAX * value);
+				*pos = static_cast<gint16>(geometry_.adc_count_max * value);
 			}
 			break;
 		case INTENSITY_ORIGINAL:
 		default:
 			{
-				double value = double(UCHAR_MAX * *pos) / SCANNER_ADC_COUNT_MAX;
+				double value = double(UCHAR_MAX * *pos) / geometry_.adc_count_max;
 				buf[i] = static_cast<guint8>(value);
 			}
 			break;
@@ -730,6 +1117,8 @@ Data::fill_image_data( Image::DataSharedPtr& image,
 	}
 	image_data_.raw_data() = image;
 	image_data_.image_buffer() = buf;
+	image_data_.set_chip_codes(form_chip_codes(width_type_));
+	return true;
 }
 
 std::vector<guint>
@@ -740,15 +1129,15 @@ Data::form_bad_strips(WidthType width_type) const
 	AssemblyConstIter begin, end;
 	width_iterators( width_type, begin, end);
 
-	unsigned int start = chip_number(begin->code);
+	unsigned int start = geometry_.chip_number(begin->code);
 	for ( AssemblyConstIter iter = begin; iter != end; ++iter) {
-		unsigned int pos = chip_number(iter->code);
+		unsigned int pos = geometry_.chip_number(iter->code);
 		pos -= start;
 
 		const std::vector<guint>& ref = iter->bad_strips;
 		std::vector<guint>::const_iterator it;
 		for ( it = ref.begin(); it != ref.end(); ++it) {
-			unsigned int strip = pos * SCANNER_STRIPS_PER_CHIP_REAL + *it;
+			unsigned int strip = pos * geometry_.image_strips_per_chip + *it;
 			strips.push_back(strip);
 		}
 	}
@@ -756,6 +1145,19 @@ Data::form_bad_strips(WidthType width_type) const
 	return strips;
 }
 
+std::string
+Data::form_chip_codes(WidthType width_type) const
+{
+	AssemblyConstIter begin, end;
+	width_iterators( width_type, begin, end);
+
+	std::string codes;
+	for ( AssemblyConstIter iter = begin; iter != end; ++iter)
+		codes += iter->code;
+
+	return codes;
+}
+
 void
 Data::calculate_lining(guint8 accuracy)
 {
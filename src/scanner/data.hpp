@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <deque>
 #include <tr1/tuple>
 
 #include <glibmm/thread.h>
@@ -25,6 +26,13 @@
 #include <Magick++/Include.h>
 
 #include "assemble.hpp"
+#include "geometry.hpp"
+#include "movement.hpp"
+#include "stage.hpp"
+
+/* files from src directory begin */
+#include "image/filter.hpp"
+/* files from src directory end */
 
 namespace boost {
 class any;
@@ -64,12 +72,44 @@ enum AcquireType {
 	ACQUIRE_LINING_PEDESTALS
 };
 
+enum DestripeType {
+	DESTRIPE_NONE,
+	DESTRIPE_COLUMNS // column gains and offsets from the rows content
+};
+
+enum MotionType {
+	MOTION_UNIFORM,
+	MOTION_PROFILE // rows positions from the movement speed
+};
+
 enum PixelIntensityType {
 	INTENSITY_ORIGINAL,
 	INTENSITY_LINEAR,
 	INTENSITY_LOGARITHMIC
 };
 
+enum ReconstructionJobType {
+	JOB_IMAGE, // new image in the scanner memory
+	JOB_FILTER,
+	JOB_INTENSITY,
+	JOB_LEVELS,
+	JOB_CALIBRATION,
+	JOB_WIDTH,
+	JOB_DATA,
+	JOB_DESTRIPE,
+	JOB_MOTION,
+	JOB_IMAGE_FILTER
+};
+
+/**
+ * Reconstruction request, the slot sets the parameter of the job type.
+ * A queued job is replaced by a newer job of the same type.
+ */
+struct ReconstructionJob {
+	ReconstructionJobType type;
+	sigc::slot<void> apply;
+};
+
 typedef std::pair< WidthType, CalibrationType> WidthCalibrationPair;
 typedef std::pair< guint8, gint16> LiningPair;
 
@@ -81,23 +121,40 @@ public:
 	virtual ~Data();
 	Glib::Dispatcher& signal_complete() { return signal_complete_; }
 	void run_image_reconstruction(const boost::any& arg);
+	void cancel_image_reconstruction();
+	bool busy() const;
+	double progress() const;
 	Image::SummaryData get_summary_data() { return image_data_; }
 	void set_chip_lining( char chip_code, const std::vector<guint8>& lining);
 	void set_lining(const std::map< char, std::vector<guint8> >& lining);
 	AssemblyConstIter begin_assemble() { return assembly_.begin(); }
 	AssemblyConstIter end_assemble() { return assembly_.end(); }
 
-	static guint chip_number(char code);
-	static char chip_code(guint number);
+	/** Chips and ADC layout of the connected scanner. */
+	const Geometry& geometry() const { return geometry_; }
+	guint chip_number(char code) const { return geometry_.chip_number(code); }
+	char chip_code(guint number) const { return geometry_.chip_code(number); }
 
 private:
-	void reconstruct_image_from_scratch();
-	void reconstruct_image_intensity(PixelIntensityType intensity);
-	void reconstruct_image_calibration(CalibrationType accuracy);
-	void reconstruct_image_levels(std::vector<double> levels);
-	void reconstruct_image_filter(Magick::FilterTypes filter);
-	void reconstruct_image_width(WidthType width);
-	void reconstruct_image_data(DataType data_type);
+	void run_worker();
+	void wait_image_reconstruction();
+	bool cancelled() const;
+	void set_progress(double progress);
+
+	void set_new_image();
+	void set_intensity_type(PixelIntensityType intensity);
+	void set_calibration_type(CalibrationType accuracy);
+	void set_levels(std::vector<double> levels);
+	void set_filter_type(Magick::FilterTypes filter);
+	void set_width_type(WidthType width);
+	void set_data_type(DataType data_type);
+	void set_destripe_type(DestripeType destripe);
+	void set_motion_type(MotionType motion);
+	void set_image_filter_type(Image::FilterType filter);
+
+	/** Chips and ADC layout of the connected scanner, set before
+	 * the lining and bad strips of the scanner are loaded. */
+	void set_geometry(GeometryType type);
 
 	bool load_bad_strips(const std::string& filename);
 	bool save_lining(const std::string& filename) const;
@@ -106,10 +163,21 @@ private:
 	void reconstruct( AcquireType acquire, guint8 arg);
 	void reconstruct_pedestals( AcquireType acquire,
 		const std::vector<Image::DataSharedPtr>& array, guint8 arg);
-	void reconstruct_image(const std::vector<Image::DataSharedPtr>& array);
+	bool reconstruct_stages();
+
+	std::vector<Image::DataSharedPtr> decode(AcquireType acquire);
+	template <typename G>
+	std::vector<Image::DataSharedPtr> decode(AcquireType acquire);
+	std::vector<Image::DataSharedPtr> subtract_pedestals(
+		const std::vector<Image::DataSharedPtr>& array) const;
+	std::vector<Image::DataSharedPtr> resample(
+		const std::vector<Image::DataSharedPtr>& array);
 
+	template <typename G>
 	void preprocess(AcquireType acquire_type);
+	template <typename G>
 	Image::DataSharedPtr image_from_memory(AcquireType acquire) const;
+	template <typename G>
 	std::vector<Image::DataSharedPtr> form_assembly_array(
 		const Image::DataSharedPtr& image) const;
 
@@ -120,9 +188,10 @@ private:
 		const CodeCountsMap& map) const;
 
 	std::vector<guint> form_bad_strips(WidthType) const;
+	std::string form_chip_codes(WidthType) const;
 	Image::DataSharedPtr form_image(WidthType width_type = WIDTH_FULL);
 
-	void fill_image_data( Image::DataSharedPtr& raw_image,
+	bool fill_image_data( Image::DataSharedPtr& raw_image,
 		PixelIntensityType intensity);
 
 	bool check_image_data( AssemblyConstIter begin,
@@ -131,6 +200,9 @@ private:
 	Image::DataSharedPtr calibrate( const Image::DataSharedPtr& raw,
 		const std::vector<guint>& bad_strips,
 		CalibrationType calibration_type = CALIBRATION_ROUGH);
+	Image::DataSharedPtr repair_strips( const Image::DataSharedPtr& image,
+		const std::vector<guint>& bad_strips) const;
+	Image::DataSharedPtr destripe(const Image::DataSharedPtr& image) const;
 
 	void width_iterators( WidthType width_type, AssemblyConstIter& begin,
 		AssemblyConstIter& end) const;
@@ -140,6 +212,7 @@ private:
 	void clear();
 
 	guint8* memory_;
+	Geometry geometry_;
 	AssemblyVector assembly_;
 
 	guint data_offset_;
@@ -151,9 +224,54 @@ private:
 	WidthType width_type_;
 	CalibrationType calibration_type_;
 	PixelIntensityType intensity_type_;
+	DataType data_type_;
+	DestripeType destripe_type_;
+	MotionType motion_type_;
+	Image::FilterType image_filter_type_; // noise or sharpness filter
+	Movement movement_; // of the last image acquisition
+	double movement_ramp_; // acceleration time of the scanner array
+	std::vector<double> levels_; // lower, upper and gamma or empty
 	gint16 lining_count_;
 
+	// Reconstruction stages, each stage is made again only if its
+	// parameters or the output of a previous stage have been changed.
+	typedef std::vector<Image::DataSharedPtr> DataArray;
+	struct ResampleKey {
+		ResampleKey() : filter(), height(0), motion(MOTION_UNIFORM) {}
+		ResampleKey( Magick::FilterTypes f, unsigned int h, MotionType m)
+			: filter(f), height(h), motion(m) {}
+		bool operator==(const ResampleKey& key) const {
+			return filter == key.filter && height == key.height &&
+				motion == key.motion;
+		}
+
+		Magick::FilterTypes filter;
+		unsigned int height;
+		MotionType motion;
+	};
+	typedef std::pair< DataType, CalibrationType> CalibrateKey;
+
+	Stage< size_t, DataArray> decode_stage_; // chip frames from memory
+	Stage< gint16, DataArray> pedestal_stage_; // pedestals subtracted
+	Stage< ResampleKey, DataArray> resample_stage_; // resized to image height
+	Stage< WidthType, Image::DataSharedPtr> assemble_stage_; // chips joined
+	Stage< CalibrateKey, Image::DataSharedPtr> calibrate_stage_;
+	Stage< DataType, Image::DataSharedPtr> strips_stage_; // bad strips fixed
+	Stage< DestripeType, Image::DataSharedPtr> destripe_stage_;
+	Stage< Image::FilterType, Image::DataSharedPtr> filter_stage_;
+	Stage< std::vector<double>, Image::DataSharedPtr> levels_stage_;
+	Stage< PixelIntensityType, Image::SummaryData> intensity_stage_;
+
+	// reconstruction worker
 	Glib::Thread* thread_;
+	mutable Glib::Mutex jobs_mutex_;
+	Glib::Cond jobs_cond_;
+	Glib::Cond idle_cond_; // the worker has no jobs
+	std::deque<ReconstructionJob> jobs_;
+	bool busy_; // jobs are being run
+	bool cancel_; // stop at the next cancellation point
+	bool quit_; // worker thread exit
+	double progress_;
 	Glib::Dispatcher signal_complete_;
 	Image::SummaryData image_data_;
 	union RawData {
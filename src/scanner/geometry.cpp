@@ -0,0 +1,127 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+/* files from src directory begin */
+#include "global_strings.hpp"
+/* files from src directory end */
+
+#include "geometry.hpp"
+
+namespace {
+
+using namespace ScanAmati::Scanner;
+
+template <typename G>
+Geometry
+make_geometry( GeometryType type, const char* chip_codes)
+{
+	Geometry geometry;
+	geometry.type = type;
+	geometry.chips = G::chips;
+	geometry.strips_per_chip = G::strips_per_chip;
+	geometry.image_strips_per_chip = G::image_strips_per_chip;
+	geometry.strips = G::strips;
+	geometry.adc_bits = G::adc_bits;
+	geometry.adc_count_max = G::adc_count_max;
+	geometry.chip_codes = chip_codes;
+	return geometry;
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace Scanner {
+
+unsigned int
+Geometry::chip_number(char code) const
+{
+	const char* pos = std::find( chip_codes, chip_codes + chips, code);
+	return (pos - chip_codes);
+}
+
+char
+Geometry::chip_code(unsigned int number) const
+{
+	return (number < chips) ? chip_codes[number] : 0;
+}
+
+Geometry
+geometry(GeometryType type)
+{
+	switch (type) {
+	case GEOMETRY_16_CHIPS_12_BITS:
+		return make_geometry< GeometryTraits< 16, 12> >( type,
+			array_chip_codes_16);
+	case GEOMETRY_12_CHIPS_14_BITS:
+		return make_geometry< GeometryTraits< 12, 14> >( type,
+			array_chip_codes_12);
+	case GEOMETRY_12_CHIPS_12_BITS:
+		return make_geometry< GeometryTraits< 12, 12> >( type,
+			array_chip_codes_12);
+	case GEOMETRY_16_CHIPS_14_BITS:
+	default:
+		return make_geometry< GeometryTraits< 16, 14> >(
+			GEOMETRY_16_CHIPS_14_BITS, array_chip_codes_16);
+	}
+}
+
+GeometryType
+default_geometry_type()
+{
+	GeometryType type = GEOMETRY_16_CHIPS_14_BITS;
+	geometry_type( SCANNER_CHIPS, SCANNER_ADC_RESOLUTION, type);
+	return type;
+}
+
+bool
+geometry_type( unsigned int chips, unsigned int adc_bits,
+	GeometryType& type)
+{
+	if (chips == 16 && adc_bits == 14)
+		type = GEOMETRY_16_CHIPS_14_BITS;
+	else if (chips == 16 && adc_bits == 12)
+		type = GEOMETRY_16_CHIPS_12_BITS;
+	else if (chips == 12 && adc_bits == 14)
+		type = GEOMETRY_12_CHIPS_14_BITS;
+	else if (chips == 12 && adc_bits == 12)
+		type = GEOMETRY_12_CHIPS_12_BITS;
+	else
+		return false;
+
+	return true;
+}
+
+std::string
+image_chip_codes(unsigned int width)
+{
+	typedef GeometryTraits< 16, SCANNER_ADC_RESOLUTION> Widest;
+
+	unsigned int chips = width / Widest::image_strips_per_chip;
+	if (!chips || chips % 2 || chips > Widest::chips ||
+		width % Widest::image_strips_per_chip)
+		return std::string();
+
+	const char* begin = array_chip_codes_16 + (Widest::chips - chips) / 2;
+	return std::string( begin, begin + chips);
+}
+
+} // namespace Scanner
+
+} // namespace ScanAmati
@@ -0,0 +1,127 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <config.h>
+
+#include <string>
+
+#ifdef HAVE_GLIB_2_0
+#include <glib.h>
+#endif
+
+#include "defines.hpp"
+
+namespace ScanAmati {
+
+namespace Scanner {
+
+enum GeometryType {
+	GEOMETRY_16_CHIPS_14_BITS,
+	GEOMETRY_16_CHIPS_12_BITS,
+	GEOMETRY_12_CHIPS_14_BITS,
+	GEOMETRY_12_CHIPS_12_BITS
+};
+
+/**
+ * Position of the marker bits in the low byte of an ADC count and
+ * the shifts of the bit reversed bytes forming the pixel value.
+ */
+template <unsigned int Bits>
+struct AdcLayout;
+
+template <>
+struct AdcLayout<14> {
+	enum {
+		data_bit = 0x80,
+		chip_bit = 0x40,
+		test_bit = 0x00, // not present
+		high_shift = 6,
+		low_shift = 2
+	};
+};
+
+template <>
+struct AdcLayout<12> {
+	enum {
+		data_bit = 0x40,
+		chip_bit = 0x20,
+		test_bit = 0x10,
+		high_shift = 4,
+		low_shift = 4
+	};
+};
+
+/**
+ * Detector geometry known at compile time, the decoding kernels are
+ * instantiated for each supported geometry so that loop bounds and bit
+ * masks are constants.
+ */
+template <unsigned int Chips, unsigned int Bits>
+struct GeometryTraits : public AdcLayout<Bits> {
+	enum {
+		chips = Chips,
+		strips_per_chip = SCANNER_STRIPS_PER_CHIP,
+		service_strips_per_chip = SCANNER_DROP_STRIPS_PER_CHIP,
+		image_strips_per_chip = strips_per_chip - service_strips_per_chip,
+		strips = strips_per_chip * chips,
+		adc_bits = Bits,
+		adc_count_max = (1 << Bits) - 1
+	};
+};
+
+typedef GeometryTraits< SCANNER_CHIPS, SCANNER_ADC_RESOLUTION> DefaultGeometry;
+
+/** Detector geometry of the connected scanner. */
+struct Geometry {
+	GeometryType type;
+	unsigned int chips;
+	unsigned int strips_per_chip;
+	unsigned int image_strips_per_chip;
+	unsigned int strips;
+	unsigned int adc_bits;
+	gint16 adc_count_max;
+	const char* chip_codes; // chips codes in the frame order
+
+	/** Index of the chip code or chips if there is no such chip. */
+	unsigned int chip_number(char code) const;
+	char chip_code(unsigned int number) const;
+};
+
+Geometry geometry(GeometryType type);
+GeometryType default_geometry_type();
+
+/** \brief Geometry type of a detector.
+ *
+ * \return false if there is no such geometry.
+ */
+bool geometry_type( unsigned int chips, unsigned int adc_bits,
+	GeometryType& type);
+
+/** \brief Codes of the chips an image of the width is formed of.
+ *
+ * The chips are taken from the middle of the detector as the width
+ * types do, the codes of the 12 chips detector are the middle codes of
+ * the 16 chips one.
+ * \return empty string if the width is not an even number of chips.
+ */
+std::string image_chip_codes(unsigned int width);
+
+} // namespace Scanner
+
+} // namespace ScanAmati
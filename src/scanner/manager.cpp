@@ -49,6 +49,7 @@ Manager::Manager()
 	thread_back_(0),
 	thread_run_(0),
 	stop_(false),
+	reconstruction_loop_(false),
 	regulator_(10),
 	fd_(-1)
 {
@@ -76,6 +77,7 @@ Manager::run( RunType run_type, const AcquisitionParameters& params)
 			sigc::mem_fun( *this, &Manager::run_background), true);
 		break;
 	case RUN_IMAGE_ACQUISITION:
+		data_.wait_image_reconstruction();
 		data_.width_type_ = params.width_type;
 		data_.calibration_type_ = params.calibration_type;
 		data_.intensity_type_ = params.intensity_type;
@@ -91,6 +93,7 @@ Manager::run( RunType run_type, const AcquisitionParameters& params)
 			params);
 		break;
 	case RUN_LINING_ACQUISITION:
+		data_.wait_image_reconstruction();
 		data_.lining_count_ = params.lining_count;
 		slot = sigc::bind(
 			sigc::mem_fun( *this, &Manager::run_lining_acquisition),
@@ -226,6 +229,30 @@ Manager::run_commands(const AcquisitionParameters& params)
 	}
 }
 
+/**
+ * Queue an image reconstruction job, see Data::run_image_reconstruction().
+ * One status loop is run for all jobs until the image is complete.
+ */
+void
+Manager::reconstruct(const boost::any& arg)
+{
+	if (!reconstruction_loop_) {
+		run(RUN_IMAGE_RECONSTRUCTION);
+		reconstruction_loop_ = true;
+	}
+	data_.run_image_reconstruction(arg);
+}
+
+/**
+ * Stop the status loop unless more reconstruction jobs have been queued.
+ */
+void
+Manager::finish_reconstruction()
+{
+	if (reconstruction_loop_ && !data_.busy())
+		stop(false);
+}
+
 void
 Manager::stop(bool stop_everything)
 {
@@ -237,8 +264,11 @@ Manager::stop(bool stop_everything)
 
 	// Here we block to truly wait for the run thread to complete
 	join_run_thread();
+	reconstruction_loop_ = false;
 
 	if (stop_everything) {
+		data_.cancel_image_reconstruction();
+
 		OFLOG_DEBUG( app.log, "Stop everything has been initiated");
 		{
 			Glib::Mutex::Lock lock(mutex_);
@@ -308,6 +338,7 @@ Manager::run_initiation()
 		handshake();
 
 		std::string scanner_id = id();
+		data_.set_geometry(State::load_geometry(scanner_id));
 
 		if (check_scanner_temperature_file(scanner_id)) {
 			std::string filename = get_temperature_file(scanner_id);
@@ -340,8 +371,9 @@ Manager::run_initiation()
 			write_command(com);
 			{
 				Glib::Mutex::Lock lock(mutex_);
-				int i = Data::chip_number(it->code);
-				state_.manager_state_.progress_ = double(i + 1) / SCANNER_CHIPS;
+				int i = it - data_.assembly_.begin();
+				state_.manager_state_.progress_ =
+					double(i + 1) / data_.assembly_.size();
 			}
 			signal_update_();
 			Glib::usleep(1000);
@@ -499,7 +531,7 @@ Manager::run_lining_acquisition(const AcquisitionParameters& params)
 		try {
 			for ( std::vector<char>::const_iterator it = chips.begin();
 				it != chips.end(); ++it) {
-				int j = Data::chip_number(*it);
+				int j = data_.chip_number(*it);
 				Command* com = Commands::create( *it, v);
 				write_command(com);
 			}
@@ -599,8 +631,9 @@ Manager::run_image_acquisition(const AcquisitionParameters& params)
 		write_command(com);
 		{
 			Glib::Mutex::Lock lock(mutex_);
-			int i = Data::chip_number(it->code);
-			state_.manager_state_.progress_ = double(i + 1) / SCANNER_CHIPS;
+			int i = data_.chip_number(it->code);
+			state_.manager_state_.progress_ = double(i + 1) /
+				data_.geometry().chips;
 		}
 		Glib::usleep(1000);
 	}
@@ -676,6 +709,7 @@ Manager::run_reconstruction_loop()
 			Glib::Mutex::Lock lock(mutex_);
 			if (stop_)
 				break;
+			state_.manager_state_.progress_ = data_.progress();
 		}
 
 		signal_update_();
@@ -803,6 +837,10 @@ Manager::acquisition_start( const AcquisitionParameters& params, AcquireType acq
 {
 	Command* com = 0;
 	size_t size;
+
+	// the worker decodes from the memory being filled
+	data_.wait_image_reconstruction();
+
 	switch (acquire) {
 	case ACQUIRE_IMAGE_PEDESTALS:
 	case ACQUIRE_LINING_PEDESTALS:
@@ -818,6 +856,7 @@ Manager::acquisition_start( const AcquisitionParameters& params, AcquireType acq
 		size = params.acquisition.memory_size;
 		data_.memory_size_ = params.acquisition.memory_size;
 		data_.image_height_ = params.acquisition.image_height;
+		data_.movement_ = params.acquisition.movement_forward;
 		break;
 	default:
 		break;
@@ -1193,6 +1232,7 @@ Manager::load_preferences(const std::string& id)
 	regulator_.set_margins( state_.temperature_average_,
 		state_.temperature_spread_);
 	regulator_.temperature_codes_[1] = state_.peltier_code_;
+	data_.movement_ramp_ = state_.movement_ramp_;
 }
 
 void
@@ -1248,18 +1288,6 @@ Manager::join_run_thread()
 		OFLOG_DEBUG( app.log, "Run thread == 0");
 }
 
-void
-Manager::join_data_thread()
-{
-	if (data_.thread_) {
-		data_.thread_->join();
-		data_.thread_ = 0;
-		OFLOG_DEBUG( app.log, "Data thread has been joined");
-	}
-	else
-		OFLOG_DEBUG( app.log, "Data thread == 0");
-}
-
 bool
 Manager::io_handler(Glib::IOCondition io_condition)
 {
@@ -1280,12 +1308,19 @@ Manager::get_state()
 	return state;
 }
 
+Geometry
+Manager::geometry()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	return Scanner::geometry(state_.geometry());
+}
+
 std::vector<guint>
 Manager::current_broken_strips() const
 {
 	std::vector<guint> strips;
 
-	if (!data_.thread_)
+	if (!data_.busy())
 		strips = data_.form_bad_strips(data_.width_type_);
 
 	return strips;
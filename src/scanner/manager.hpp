@@ -61,16 +61,18 @@ public:
 		const AcquisitionParameters& params = AcquisitionParameters());
 
 	void stop(bool stop_everything = false);
+	void reconstruct(const boost::any& arg);
+	void finish_reconstruction();
 	Glib::Dispatcher& signal_update();
 	State get_state();
-	Data* get_data() { return (data_.thread_) ? 0 : &data_; }
-	const Data* get_data() const { return (data_.thread_) ? 0 : &data_; }
+	Geometry geometry(); /**< of the connected scanner */
+	Data* get_data() { return (data_.busy()) ? 0 : &data_; }
+	const Data* get_data() const { return (data_.busy()) ? 0 : &data_; }
 	bool run_thread_state() const { return static_cast<bool>(thread_run_); }
 	std::vector<Command*> get_lining_commands() const;
 	bool set_temperature_control(bool control);
 	bool set_temperature_margins( double temperature, double spread);
 	void join_run_thread();
-	void join_data_thread();
 	std::vector<guint> current_broken_strips() const;
 
 protected:
@@ -123,6 +125,7 @@ protected:
 	Glib::Mutex mutex_; // state mutex
 
 	bool stop_;
+	bool reconstruction_loop_; // status loop of the image reconstruction
 	Data data_;
 	State state_;
 	TemperatureRegulator regulator_;
@@ -15,5 +15,39 @@
  *      MA 02110-1301, USA.
  */
 
+#include <algorithm>
 
 #include "movement.hpp"
+
+namespace ScanAmati {
+
+namespace Scanner {
+
+std::vector<double>
+row_positions( const Movement& movement, double ramp, unsigned int rows)
+{
+	std::vector<double> positions(rows);
+	if (!rows)
+		return positions;
+
+	// trapezoid of the speed, the covered length is 1
+	const double& time = movement.time;
+	ramp = std::max( 0., std::min( ramp, time / 2.));
+	double speed = 1. / (time - ramp);
+
+	for ( unsigned int i = 0; i < rows; ++i) {
+		double t = (i + .5) * time / rows;
+		if (t < ramp)
+			positions[i] = speed * t * t / (2. * ramp);
+		else if (t > time - ramp)
+			positions[i] = 1. - speed * (time - t) * (time - t) /
+				(2. * ramp);
+		else
+			positions[i] = speed * (t - ramp / 2.);
+	}
+	return positions;
+}
+
+} // namespace Scanner
+
+} // namespace ScanAmati
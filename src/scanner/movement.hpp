@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <vector>
+
 namespace ScanAmati {
 
 namespace Scanner {
@@ -64,6 +66,21 @@ const struct Movement {
 	{ } // Terminating entry
 };
 
+/** \brief Positions of the rows acquired during the movement.
+ *
+ * Rows are acquired at a constant rate over the movement time while the
+ * array speeds up and slows down over the ramp time at both ends, the
+ * position is the fraction of the movement length at the center of
+ * every row.
+ *
+ * The controller does not report its acceleration, the ramp time is
+ * measured for every scanner and kept in its preferences. With no
+ * ramp the array moves at a constant speed and the rows are evenly
+ * spaced.
+ */
+std::vector<double> row_positions( const Movement& movement, double ramp,
+	unsigned int rows);
+
 } // namespace Scanner
 
 } // namespace ScanAmati
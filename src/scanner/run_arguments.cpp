@@ -15,10 +15,6 @@
  *      MA 02110-1301, USA.
  */
 
-/* files from src directory begin */
-#include "global_strings.hpp"
-/* files from src directory end */
-
 #include "defines.hpp"
 
 #include "run_arguments.hpp"
@@ -32,8 +28,7 @@ RunArguments::RunArguments()
 	with_acquisition(true),
 	with_exposure(true),
 	movement_type(MOVEMENT_BOTH),
-	acquisition(),
-	chip_codes( array_chip_codes, array_chip_codes + SCANNER_CHIPS)
+	acquisition()
 {
 }
 
@@ -42,8 +37,7 @@ RunArguments::RunArguments(Command* com)
 	with_acquisition(true),
 	with_exposure(true),
 	movement_type(MOVEMENT_BOTH),
-	acquisition(),
-	chip_codes( array_chip_codes, array_chip_codes + SCANNER_CHIPS)
+	acquisition()
 {
 	commands.push_back(CommandSharedPtr(com));
 }
@@ -53,8 +47,7 @@ RunArguments::RunArguments(const std::vector<Command*>& coms)
 	with_acquisition(true),
 	with_exposure(true),
 	movement_type(MOVEMENT_BOTH),
-	acquisition(),
-	chip_codes( array_chip_codes, array_chip_codes + SCANNER_CHIPS)
+	acquisition()
 {
 	for ( std::vector<Command*>::const_iterator it = coms.begin();
 		it != coms.end(); ++it) {
@@ -66,6 +59,13 @@ RunArguments::~RunArguments()
 {
 }
 
+void
+RunArguments::set_all_chips(const Geometry& geometry)
+{
+	chip_codes.assign( geometry.chip_codes,
+		geometry.chip_codes + geometry.chips);
+}
+
 } // namespace Scanner
 
 } // namespace ScanAmati
@@ -22,6 +22,7 @@
 
 #include "acquisition.hpp"
 #include "commands.hpp"
+#include "geometry.hpp"
 
 namespace ScanAmati {
 
@@ -33,11 +34,13 @@ struct RunArguments {
 	RunArguments(unsigned int focal_distance);
 	RunArguments(Command* com);
 	RunArguments(const std::vector<Command*>& coms);
+	/** Address every chip of the geometry. */
+	void set_all_chips(const Geometry& geometry);
 	bool with_acquisition;
 	bool with_exposure;
 	MovementType movement_type;
 	Acquisition acquisition;
-	std::vector<char> chip_codes;
+	std::vector<char> chip_codes; // of the connected scanner, none by default
 	std::vector<CommandSharedPtr> commands;
 };
 
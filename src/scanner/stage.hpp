@@ -0,0 +1,67 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+namespace ScanAmati {
+
+namespace Scanner {
+
+/**
+ * Cached output of a reconstruction stage together with
+ * the parameters the output was made with.
+ */
+template <typename Key, typename Value>
+class Stage {
+
+public:
+	Stage() : key_(), value_(), valid_(false) {}
+
+	/** Output is valid and was made with the key parameters. */
+	bool valid(const Key& key) const { return valid_ && (key_ == key); }
+	const Value& value() const { return value_; }
+	void set( const Key& key, const Value& value);
+	void clear();
+
+private:
+	Key key_;
+	Value value_;
+	bool valid_;
+};
+
+template <typename Key, typename Value>
+inline
+void
+Stage<Key, Value>::set( const Key& key, const Value& value)
+{
+	key_ = key;
+	value_ = value;
+	valid_ = true;
+}
+
+template <typename Key, typename Value>
+inline
+void
+Stage<Key, Value>::clear()
+{
+	value_ = Value();
+	valid_ = false;
+}
+
+} // namespace Scanner
+
+} // namespace ScanAmati
@@ -15,6 +15,8 @@
  *      MA 02110-1301, USA.
  */
 
+#include <iostream>
+
 /* files from src directory begin */
 #include "global_strings.hpp"
 #include "application.hpp"
@@ -34,6 +36,11 @@ State::save(const std::string& id) const
 	app.prefs.set( id, conf_key_state_temperature_control, temperature_control_);
 	app.prefs.set( id, conf_key_state_temperature_average, temperature_average_);
 	app.prefs.set( id, conf_key_state_temperature_spread, temperature_spread_);
+	app.prefs.set( id, conf_key_state_movement_ramp, movement_ramp_);
+
+	Geometry geom = Scanner::geometry(geometry_);
+	app.prefs.set( id, conf_key_state_chips, int(geom.chips));
+	app.prefs.set( id, conf_key_state_adc_resolution, int(geom.adc_bits));
 }
 
 bool
@@ -50,10 +57,31 @@ State::load(const std::string& id)
 		conf_key_state_temperature_average);
 	temperature_spread_ = app.prefs.get<double>( group,
 		conf_key_state_temperature_spread);
+	movement_ramp_ = app.prefs.has_key( group, conf_key_state_movement_ramp) ?
+		app.prefs.get<double>( group, conf_key_state_movement_ramp) : 0.;
+	geometry_ = load_geometry(id);
 
 	return app.prefs.has_group(id);
 }
 
+GeometryType
+State::load_geometry(const std::string& id)
+{
+	GeometryType type = default_geometry_type();
+
+	if (!app.prefs.has_key( id, conf_key_state_chips) ||
+		!app.prefs.has_key( id, conf_key_state_adc_resolution))
+		return type;
+
+	int chips = app.prefs.get<int>( id, conf_key_state_chips);
+	int bits = app.prefs.get<int>( id, conf_key_state_adc_resolution);
+
+	if (!geometry_type( chips, bits, type))
+		std::cerr << "Unknown geometry of scanner " << id << std::endl;
+
+	return type;
+}
+
 void
 State::what_todo( Glib::ustring& what, Glib::ustring& todo) const
 {
@@ -21,6 +21,7 @@
 #include <glibmm/ustring.h>
 #include "manager_state.hpp"
 #include "builtin_chip_capacities.hpp"
+#include "geometry.hpp"
 #include "temperature_regulator.hpp"
 
 namespace ScanAmati {
@@ -40,11 +41,13 @@ public:
 	void temperature_margins( double& average, double& spread) const;
 	guint8 peltier_code() const { return peltier_code_; }
 	bool temperature_control() const { return temperature_control_; }
+	GeometryType geometry() const { return geometry_; }
 	void what_todo( Glib::ustring& what, Glib::ustring& todo) const;
 
 private:
 	void save(const std::string& id) const;
 	bool load(const std::string& id);
+	static GeometryType load_geometry(const std::string& id);
 
 	ManagerState manager_state_;
 	std::string id_;
@@ -53,8 +56,10 @@ private:
 	double temperature_; // current temperature
 	double temperature_average_;
 	double temperature_spread_;
+	double movement_ramp_; // measured acceleration time, seconds
 	guint8 peltier_code_;
 	bool temperature_control_;
+	GeometryType geometry_;
 	Glib::ustring what_;
 	Glib::ustring todo_;
 };
@@ -69,8 +74,10 @@ State::State()
 	temperature_(0.),
 	temperature_average_(SCANNER_DEFAULT_TEMPERATURE_AVERAGE),
 	temperature_spread_(SCANNER_DEFAULT_TEMPERATURE_SPREAD),
+	movement_ramp_(0.),
 	peltier_code_(UCHAR_MAX),
-	temperature_control_(true)
+	temperature_control_(true),
+	geometry_(default_geometry_type())
 {
 }
 
@@ -55,6 +55,34 @@ get_dicom_servers_file()
   return (get_rc_dir() + G_DIR_SEPARATOR_S + dicom_servers_file);
 }
 
+std::string
+get_thumbnails_dir()
+{
+  return (Glib::get_user_cache_dir() + G_DIR_SEPARATOR_S + rc_dir
+  	+ G_DIR_SEPARATOR_S + thumbnails_dir);
+}
+
+std::string
+get_spool_dir()
+{
+  return (Glib::get_user_data_dir() + G_DIR_SEPARATOR_S + rc_dir
+  	+ G_DIR_SEPARATOR_S + spool_dir);
+}
+
+std::string
+get_index_file()
+{
+  return (Glib::get_user_cache_dir() + G_DIR_SEPARATOR_S + rc_dir
+  	+ G_DIR_SEPARATOR_S + index_file);
+}
+
+std::string
+get_received_dir()
+{
+  return (Glib::get_user_data_dir() + G_DIR_SEPARATOR_S + rc_dir
+  	+ G_DIR_SEPARATOR_S + received_dir);
+}
+
 std::string
 get_lining_file(const std::string& id)
 {
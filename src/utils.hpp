@@ -30,6 +30,26 @@ std::string get_rc_file();
 
 std::string get_dicom_servers_file();
 
+/**
+ * Thumbnails cache directory.
+ */
+std::string get_thumbnails_dir();
+
+/**
+ * Outgoing DICOM queue directory.
+ */
+std::string get_spool_dir();
+
+/**
+ * Local files index.
+ */
+std::string get_index_file();
+
+/**
+ * Directory of the studies pushed to the storage SCP.
+ */
+std::string get_received_dir();
+
 /** \brief Checks scanner id directory.
  * 
  * Check if scanner id directory exists and has all required files.
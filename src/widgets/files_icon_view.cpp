@@ -19,27 +19,12 @@
 #include <fstream>
 #include <gtkmm/menu.h>
 
-#include <Magick++.h>
-
 // files from src directory begin
 #include "palette/palette.hpp"
 // files from src directory end
 
 #include "files_icon_view.hpp"
 
-namespace {
-
-void
-destroy_pixbuf(const guint8* data)
-{
-	delete [] data;
-	data = 0;
-}
-
-Gdk::Pixbuf::SlotDestroyData destroy_slot = sigc::ptr_fun(&destroy_pixbuf);
-	
-} // namespace
-
 namespace ScanAmati {
 
 namespace UI {
@@ -65,6 +50,8 @@ FilesIconView::~FilesIconView()
 void
 FilesIconView::connect_signals()
 {
+	thumbnailer_.signal_ready().connect(sigc::mem_fun(
+		*this, &FilesIconView::on_icon_ready));
 }
 
 bool
@@ -107,7 +94,8 @@ FilesIconView::on_selection_changed()
 			current_path_ = *iter;
 			Gtk::TreeModel::Row row = *liststore_icons_->get_iter(*iter);
 
-			const Image::SummaryData& image = row[model_columns.image_data];
+			Image::SummaryData image;
+			ImageStore::instance().get( row[model_columns.image], image);
 			const DICOM::SummaryInfo& info = row[model_columns.dicom_info];
 
 			signal_image_data_clicked_(image);
@@ -131,6 +119,35 @@ FilesIconView::init_ui()
 	set_pixbuf_column(model_columns.icon);
 	set_text_column(model_columns.label);
 	set_tooltip_column(2);
+
+	empty_icon_ = Gdk::Pixbuf::create( Gdk::COLORSPACE_RGB, true, 8, 64, 64);
+	empty_icon_->fill(0x00000000);
+}
+
+void
+FilesIconView::request_icon( const Gtk::TreeRow& row,
+	const Image::SummaryData& data, const std::string& filename)
+{
+	unsigned int id = thumbnailer_.add( data, filename, 64);
+	pending_icons_[id] = Gtk::TreeRowReference( liststore_icons_,
+		liststore_icons_->get_path(row));
+}
+
+void
+FilesIconView::on_icon_ready( unsigned int id,
+	Glib::RefPtr<Gdk::Pixbuf> icon)
+{
+	std::map< unsigned int, Gtk::TreeRowReference>::iterator iter =
+		pending_icons_.find(id);
+	if (iter == pending_icons_.end())
+		return;
+
+	// The row may have been removed in the meantime.
+	if (iter->second.is_valid() && icon) {
+		Gtk::TreeRow row = *liststore_icons_->get_iter(iter->second.get_path());
+		row[model_columns.icon] = icon;
+	}
+	pending_icons_.erase(iter);
 }
 
 void
@@ -139,32 +156,31 @@ FilesIconView::add_file( const std::string& filename,
 {
 	Image::SummaryData& data = file.image_data();
 	DICOM::SummaryInfo& info = file.dicom_info();
-	Glib::RefPtr<Gdk::Pixbuf> icon = create_icon_pixbuf(
-		data.raw_data(), data.image_buffer(), 64);
 
 	Gtk::TreeRow row = *(liststore_icons_->append());
-	row[model_columns.icon] = icon;
+	row[model_columns.icon] = empty_icon_;
 	row[model_columns.label] = info.get_label_text();
 	row[model_columns.tooltip_label] = info.get_tooltip_text();
 	row[model_columns.filename] = filename;
 	row[model_columns.dicom_info] = info;
-	row[model_columns.image_data] = data;
+	row[model_columns.image] = ImageStore::instance().add( data, filename);
 	row[model_columns.state] = (from_pacs) ? STATE_PACS_DATA : STATE_FILE_DATA;
+
+	request_icon( row, data, filename);
 }
 
 void
 FilesIconView::add_image_data(const Image::SummaryData& image_data)
 {
-	Glib::RefPtr<Gdk::Pixbuf> icon = create_icon_pixbuf(
-		image_data.raw_data(), image_data.image_buffer(), 64);
-
 	Gtk::TreeRow row = *(liststore_icons_->append());
-	row[model_columns.icon] = icon;
+	row[model_columns.icon] = empty_icon_;
 	row[model_columns.tooltip_label] = "";
 	row[model_columns.filename] = "";
 	row[model_columns.dicom_info] = new_dicom_info_;
-	row[model_columns.image_data] = image_data;
+	row[model_columns.image] = ImageStore::instance().add(image_data);
 	row[model_columns.state] = STATE_NEW_DATA;
+
+	request_icon( row, image_data);
 }
 
 bool
@@ -174,9 +190,8 @@ FilesIconView::get_current_data( Image::SummaryData& data,
 	bool res = false;
 	if (!current_path_.empty()) {
 		Gtk::TreeRow row = *(liststore_icons_->get_iter(current_path_));
-		data = row[model_columns.image_data];
+		res = ImageStore::instance().get( row[model_columns.image], data);
 		info = row[model_columns.dicom_info];
-		res = true;
 	}
 	return res;
 }
@@ -200,7 +215,9 @@ FilesIconView::get_current_data(DICOM::Dataset& dataset)
 
 	if (!current_path_.empty()) {
 		Gtk::TreeRow row = *(liststore_icons_->get_iter(current_path_));
-		const Image::SummaryData& data = row[model_columns.image_data];
+		Image::SummaryData data;
+		if (!ImageStore::instance().get( row[model_columns.image], data))
+			return false;
 
 		DcmDataset* set = &dataset;
 		DICOM::SummaryInfo info = row[model_columns.dicom_info];
@@ -224,6 +241,19 @@ FilesIconView::get_current_filename(std::string& filename)
 	return res;
 }
 
+bool
+FilesIconView::get_filenames(std::vector<std::string>& filenames)
+{
+	filenames.clear();
+	Gtk::TreeModel::Children rows = liststore_icons_->children();
+	for ( Gtk::TreeIter iter = rows.begin(); iter != rows.end(); ++iter) {
+		std::string filename = (*iter)[model_columns.filename];
+		if (!filename.empty())
+			filenames.push_back(filename);
+	}
+	return !filenames.empty();
+}
+
 void
 FilesIconView::remove_current()
 {
@@ -243,6 +273,7 @@ FilesIconView::change_current_filename(const std::string& filename)
 	Gtk::TreeRow row = *(liststore_icons_->get_iter(current_path_));
 	row[model_columns.filename] = filename;
 	row[model_columns.state] = STATE_FILE_SAVED;
+	ImageStore::instance().set_filename( row[model_columns.image], filename);
 	signal_state_type_clicked_(STATE_FILE_SAVED);
 }
 
@@ -257,6 +288,8 @@ FilesIconView::change_current_dicom_info(const DICOM::SummaryInfo& info)
 void
 FilesIconView::clear_all()
 {
+	thumbnailer_.cancel();
+	pending_icons_.clear();
 	liststore_icons_->clear();
 	current_path_.clear();
 	pointer_path_.clear();
@@ -275,40 +308,6 @@ FilesIconView::set_palette(const Image::Palette*)
 {
 }
 
-Glib::RefPtr<Gdk::Pixbuf>
-FilesIconView::create_icon_pixbuf( const Image::DataSharedPtr& img,
-	const std::vector<guint8>& buf, unsigned int icon_size)
-{
-	Glib::RefPtr<Gdk::Pixbuf> pixbuf;
-
-	if (img) {
-		Magick::Image icon( img->width(), img->height(), "I",
-			Magick::CharPixel, &buf[0]);
-		Glib::ustring str = Glib::ustring::compose( "%1x%1\>",
-			Glib::ustring::format(icon_size));
-
-		Magick::Geometry geom(str.c_str());
-		icon.filterType(Magick::CubicFilter);
-#if (MagickLibVersion >= 0x660 && MagickLibVersion <= 0x669) 
-		icon.resize(geom);
-#else
-		icon.scale(geom);
-#endif
-
-		unsigned int w = icon.columns();
-		unsigned int h = icon.rows();
-		const Magick::PixelPacket* pixel = icon.getConstPixels( 0, 0, w, h);
-		guint8* d = new guint8[3 * w * h];
-		for ( unsigned int i = 0; i < w * h; ++i) {
-			guint8 pix = UCHAR_MAX * (double(pixel++->red) / USHRT_MAX);
-			d[3 * i + 0] = d[3 * i + 1] = d[3 * i + 2] = pix;
-		}
-		pixbuf = Gdk::Pixbuf::create_from_data( d, Gdk::COLORSPACE_RGB,
-			false, 8, w, h, 3 * w, destroy_slot);
-	}
-	return pixbuf;
-}
-
 sigc::signal< void, const Image::SummaryData&>
 FilesIconView::signal_image_data_clicked()
 {
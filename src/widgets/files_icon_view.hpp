@@ -17,14 +17,21 @@
 
 #pragma once
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include <gtkmm/liststore.h>
 #include <gtkmm/builder.h>
 #include <gtkmm/iconview.h>
 
 // files from src directory begin
 #include "file.hpp"
+#include "image_store.hpp"
 // files from src directory end
 
+#include "thumbnailer.hpp"
+
 namespace Gtk {
 class Menu;
 }
@@ -63,6 +70,7 @@ public:
 	void remove_current();
 	void clear_all();
 	bool get_current_filename(std::string& filename);
+	bool get_filenames(std::vector<std::string>& filenames);
 	bool get_current_data( Image::SummaryData& data,
 		DICOM::SummaryInfo& dicom_summary);
 	bool get_current_data(DICOM::SummaryInfo& dicom_summary);
@@ -80,14 +88,13 @@ protected:
 	virtual bool on_motion_notify_event(GdkEventMotion*);
 	virtual void on_item_activated(const Gtk::TreeModel::Path&);
 	virtual void on_selection_changed();
-	Glib::RefPtr<Gdk::Pixbuf> create_icon_pixbuf(
-		const Image::DataSharedPtr&,
-		const std::vector<guint8>&,
-		unsigned int size = 64);
+	void on_icon_ready( unsigned int id, Glib::RefPtr<Gdk::Pixbuf>);
 
 	// Methods:
 	void init_ui();
 	void connect_signals();
+	void request_icon( const Gtk::TreeRow&, const Image::SummaryData&,
+		const std::string& filename = std::string());
 
 	// Members:
 	Glib::RefPtr<Gtk::Builder> builder_;
@@ -105,7 +112,7 @@ protected:
 			add(tooltip_label);
 			add(filename);
 			add(dicom_info);
-			add(image_data);
+			add(image);
 			add(state);
 		}
 
@@ -114,11 +121,14 @@ protected:
 		Gtk::TreeModelColumn<Glib::ustring> tooltip_label;
 		Gtk::TreeModelColumn<std::string> filename;
 		Gtk::TreeModelColumn<DICOM::SummaryInfo> dicom_info;
-		Gtk::TreeModelColumn<Image::SummaryData> image_data;
+		Gtk::TreeModelColumn<ImageHandle> image;
 		Gtk::TreeModelColumn<StateType> state;
 	} model_columns;
 
 	DICOM::SummaryInfo new_dicom_info_;
+	Thumbnailer thumbnailer_;
+	Glib::RefPtr<Gdk::Pixbuf> empty_icon_; // shown until the icon is ready
+	std::map< unsigned int, Gtk::TreeRowReference> pending_icons_;
 
 	// Signals:
 	sigc::signal< void, const Image::SummaryData&> signal_image_data_clicked_;
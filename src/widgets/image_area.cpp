@@ -15,6 +15,7 @@
  *      MA 02110-1301, USA.
  */
 
+#include <climits>
 #include <iostream>
 #include <gdkmm/cursor.h>
 #include <gtkmm/menu.h>
@@ -30,21 +31,12 @@
 
 namespace {
 
-const char* const chip_strings[SCANNER_CHIPS] = {
-#if SCANNER_CHIPS == 16
-	"0", "1", "2", "3",
-	"4", "5", "6", "7",
-	"8", "9", "A", "B",
-	"C", "D", "E", "F"
-#elif SCANNER_CHIPS == 12
-	"2", "3", "4", "5",
-	"6", "7", "8", "9",
-	"A", "B", "C", "D"
-#endif
-};
-
 Gdk::Color gray("gray");
 
+const int numbers_layer_height = 48; // chip numbers band at the image top
+
+const ScanAmati::Image::Palette grayscale(ScanAmati::Image::PALETTE_GRAYSCALE);
+
 void
 destroy_pixbuf(const guint8* data)
 {
@@ -78,6 +70,13 @@ ImageArea::ImageArea( BaseObjectType* cobject,
 	scale_(1.0),
 	zoom_(ZOOM_HEIGHT),
 	margins_(false),
+	measure_(false),
+	roi_drag_(false),
+	roi_x0_(0),
+	roi_y0_(0),
+	roi_x1_(0),
+	roi_y1_(0),
+	view_filter_(Image::FILTER_NONE),
 	palette_(0),
 	menu_(0)
 {
@@ -90,23 +89,45 @@ ImageArea::~ImageArea()
 {
 }
 
+/**
+ * Only the exposed part of the image is drawn: the tiles under the
+ * exposed rectangle and the cached overlay layers clipped by it.
+ */
 bool
 ImageArea::on_expose_event(GdkEventExpose* event)
 {
 	// This is where we draw on the window
 	Glib::RefPtr<Gdk::Window> window = get_window();
 
-	if (window) {
-		if (pixmap_) {
-			window->draw_drawable( get_style()->get_black_gc(),
-				pixmap_,
-				pos_x_,
-				pos_y_,
-				x_offset_,
-				y_offset_,
-				vis_width_,
-				vis_height_);
-		}
+	if (!window || pyramid_.empty())
+		return false;
+
+	// exposed part of the image (window coordinates)
+	int x0 = MAX( event->area.x, x_offset_);
+	int y0 = MAX( event->area.y, y_offset_);
+	int x1 = MIN( event->area.x + event->area.width, x_offset_ + vis_width_);
+	int y1 = MIN( event->area.y + event->area.height,
+		y_offset_ + vis_height_);
+
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	int vx, vy;
+	view_origin( vx, vy);
+
+	// same part within the scaled image
+	int x = x0 - x_offset_ + vx;
+	int y = y0 - y_offset_ + vy;
+
+	draw_tiles( window, x, y, x1 - x0, y1 - y0);
+
+	if (margins_ || !broken_strips_.empty() || measure_) {
+		Cairo::RefPtr<Cairo::Context> cr = window->create_cairo_context();
+		cr->rectangle( x0, y0, x1 - x0, y1 - y0);
+		cr->clip();
+		cr->translate( x_offset_ - vx, y_offset_ - vy);
+
+		draw_overlays(cr);
 	}
 
 	return false;
@@ -121,6 +142,13 @@ ImageArea::on_motion_notify_event(GdkEventMotion* event)
 		else
 			window->set_cursor();
 	}
+
+	if (roi_drag_) {
+		image_position( event->x, event->y, roi_x1_, roi_y1_);
+		measure_roi();
+		queue_draw();
+		return true;
+	}
 	return false;
 }
 
@@ -128,7 +156,7 @@ bool
 ImageArea::on_enter_notify_event(GdkEventCrossing*)
 {
 	if (Glib::RefPtr<Gdk::Window> window = get_window()) {
-		if (pixbuf_)
+		if (!pyramid_.empty())
 			window->set_cursor(Gdk::Cursor(Gdk::HAND2));
 	}
 	return false;
@@ -151,21 +179,42 @@ ImageArea::on_button_press_event(GdkEventButton* event)
 		menu_->popup( event->button, event->time);
 		res = true;
 	}
+	else if ((event->type == GDK_BUTTON_PRESS) && (event->button == 1) &&
+		measure_ && !pyramid_.empty()) {
+		image_position( event->x, event->y, roi_x0_, roi_y0_);
+		roi_x1_ = roi_x0_;
+		roi_y1_ = roi_y0_;
+		roi_drag_ = true;
+		queue_draw();
+		res = true;
+	}
 	return res;
 }
 
+bool
+ImageArea::on_button_release_event(GdkEventButton* event)
+{
+	if (!roi_drag_ || event->button != 1)
+		return false;
+
+	image_position( event->x, event->y, roi_x1_, roi_y1_);
+	roi_drag_ = false;
+	measure_roi();
+	queue_draw();
+	return true;
+}
+
 void
 ImageArea::on_zoom(ZoomType type)
 {
 	zoom_ = type;
 
-	if (pixbuf_) {
+	if (!pyramid_.empty()) {
 		Gtk::Allocation wa = get_allocation();
 
 		update_scale( wa.get_width(), wa.get_height());
-		update_pixbuf();
 		update_image_visible_margins( wa.get_width(), wa.get_height());
-		update_pixmap();
+		invalidate_overlays();
 
 		signal_scale_(scale_);
 		get_window()->invalidate_rect( wa, false);
@@ -175,8 +224,8 @@ ImageArea::on_zoom(ZoomType type)
 void
 ImageArea::update_image_visible_margins( int width, int height)
 {
-	vis_width_ = MIN( width, pixbuf_->get_width()); // image region width
-	vis_height_ = MIN( height, pixbuf_->get_height()); // image region height
+	vis_width_ = MIN( width, width_); // image region width
+	vis_height_ = MIN( height, height_); // image region height
 
 	x_offset_ = (width - vis_width_) / 2.;
 	y_offset_ = (height - vis_height_) / 2.;
@@ -215,6 +264,12 @@ ImageArea::signal_scale_changed()
 	return signal_scale_;
 }
 
+sigc::signal< void, const Image::RoiStatistics&>
+ImageArea::signal_roi_measured()
+{
+	return signal_roi_;
+}
+
 void
 ImageArea::on_realize()
 {
@@ -252,92 +307,246 @@ ImageArea::get_image_size( int& width, int& height) const
 	}
 }
 
+Glib::RefPtr<Gdk::Pixbuf>
+ImageArea::get_tile( int column, int row)
+{
+	TileKey key = { scale_, current_palette().type(), column, row };
+
+	Glib::RefPtr<Gdk::Pixbuf> tile = tiles_.find(key);
+	if (!tile) {
+		tile = render_tile( column, row);
+		tiles_.insert( key, tile);
+	}
+	return tile;
+}
+
+/**
+ * Renders the tile of the scaled image from the nearest pyramid level,
+ * the level is never reduced more than twice, so bilinear
+ * interpolation is good enough.
+ */
+Glib::RefPtr<Gdk::Pixbuf>
+ImageArea::render_tile( int column, int row) const
+{
+	const int size = TileCache::TILE_SIZE;
+
+	int x = column * size; // tile position within the scaled image
+	int y = row * size;
+	int w = MIN( size, width_ - x);
+	int h = MIN( size, height_ - y);
+
+	unsigned int n = pyramid_.level_for_scale(scale_);
+	const Image::Pyramid::Level& level = pyramid_.level(n);
+	double factor = scale_ * (1 << n); // level to the scaled image
+
+	// level region with a border pixel for the interpolation
+	int x0 = MAX( 0, int(floor(x / factor)) - 1);
+	int y0 = MAX( 0, int(floor(y / factor)) - 1);
+	int x1 = MIN( int(level.width), int(ceil((x + w) / factor)) + 1);
+	int y1 = MIN( int(level.height), int(ceil((y + h) / factor)) + 1);
+
+	Glib::RefPtr<Gdk::Pixbuf> source = Gdk::Pixbuf::create(
+		Gdk::COLORSPACE_RGB, false, 8, x1 - x0, y1 - y0);
+	fill_rgb( level, x0, y0, source);
+
+	Glib::RefPtr<Gdk::Pixbuf> tile = Gdk::Pixbuf::create(
+		Gdk::COLORSPACE_RGB, false, 8, w, h);
+	source->scale( tile, 0, 0, w, h, x0 * factor - x, y0 * factor - y,
+		factor, factor, Gdk::INTERP_BILINEAR);
+
+	return tile;
+}
+
 void
-ImageArea::update_pixbuf()
+ImageArea::fill_rgb( const Image::Pyramid::Level& level, int x, int y,
+	const Glib::RefPtr<Gdk::Pixbuf>& pixbuf) const
 {
-	Glib::RefPtr<Gdk::Pixbuf> pixbuf = Gdk::Pixbuf::create_from_data(
-		&buf_[0], Gdk::COLORSPACE_RGB, false, 8,
-		image_width_, image_height_, 3 * image_width_);
+	const Image::Palette& palette = current_palette();
 
-	switch (zoom_) {
-	case ZOOM_HEIGHT:
-	case ZOOM_WIDTH:
-	case ZOOM_200:
-	case ZOOM_300:
-		pixbuf_ = pixbuf->scale_simple( width_, height_, Gdk::INTERP_HYPER);
-		break;
-	case ZOOM_100:
-	default:
-		pixbuf_ = pixbuf;
-		break;
+	int w = pixbuf->get_width();
+	int h = pixbuf->get_height();
+	int rowstride = pixbuf->get_rowstride();
+
+	for ( int j = 0; j < h; ++j) {
+		guint8* dest = pixbuf->get_pixels() + j * rowstride;
+		const guint8* src = &level.buffer[(y + j) * level.width + x];
+
+		palette.expand( src, dest, w);
 	}
 }
 
+const Image::Palette&
+ImageArea::current_palette() const
+{
+	return (palette_) ? *palette_ : grayscale;
+}
+
+/**
+ * Top left corner of the visible part within the scaled image.
+ */
 void
-ImageArea::update_pixmap()
+ImageArea::view_origin( int& x, int& y) const
 {
-	int w, h;
-	switch (zoom_) {
-	case ZOOM_HEIGHT:
-	case ZOOM_WIDTH:
-	case ZOOM_200:
-	case ZOOM_300:
-		w = width_;
-		h = height_;
-		break;
-	case ZOOM_100:
-	default:
-		w = image_width_;
-		h = image_height_;
-		break;
+	x = MAX( 0, MIN( pos_x_, width_ - vis_width_));
+	y = MAX( 0, MIN( pos_y_, height_ - vis_height_));
+}
+
+/**
+ * Draws the [x, x + width) x [y, y + height) part of the scaled image,
+ * only the tiles within the part are touched.
+ */
+void
+ImageArea::draw_tiles( const Glib::RefPtr<Gdk::Window>& window,
+	int x, int y, int width, int height)
+{
+	const int size = TileCache::TILE_SIZE;
+
+	int vx, vy;
+	view_origin( vx, vy);
+
+	for ( int row = y / size; row * size < y + height; ++row) {
+		for ( int column = x / size; column * size < x + width; ++column) {
+			Glib::RefPtr<Gdk::Pixbuf> tile = get_tile( column, row);
+
+			int src_x = MAX( 0, x - column * size);
+			int src_y = MAX( 0, y - row * size);
+			int w = MIN( tile->get_width() - src_x,
+				x + width - column * size - src_x);
+			int h = MIN( tile->get_height() - src_y,
+				y + height - row * size - src_y);
+
+			int dest_x = x_offset_ + column * size + src_x - vx;
+			int dest_y = y_offset_ + row * size + src_y - vy;
+
+			window->draw_pixbuf( get_style()->get_black_gc(), tile,
+				src_x, src_y, dest_x, dest_y, w, h,
+				Gdk::RGB_DITHER_NONE, 0, 0);
+		}
 	}
+}
 
-	pixmap_ = Gdk::Pixmap::create( get_window(), w, h, -1);
-	pixmap_->draw_pixbuf( get_style()->get_black_gc(), pixbuf_,
-		0, 0, 0, 0, w, h, Gdk::RGB_DITHER_NONE, 0, 0);
+/**
+ * Composites the overlay layers, the context is in the scaled image
+ * coordinates and is already clipped by the exposed area.
+ */
+void
+ImageArea::draw_overlays(Cairo::RefPtr<Cairo::Context>& context)
+{
+	update_overlays();
+
+	if (margins_ && margins_layer_) {
+		// vertical lines are stored as one row repeated down the image
+		Cairo::RefPtr<Cairo::SurfacePattern> pattern =
+			Cairo::SurfacePattern::create(margins_layer_);
+		pattern->set_extend(Cairo::EXTEND_REPEAT);
+		pattern->set_filter(Cairo::FILTER_NEAREST);
+
+		context->save();
+		context->rectangle( 0, 0, width_, height_);
+		context->clip();
+		context->set_source(pattern);
+		context->paint();
+
+		context->set_source( numbers_layer_, 0, 0);
+		context->paint();
+
+		// top and bottom borders
+		context->set_source_rgb( .337, .612, .117); // green
+		context->rectangle( 0, 0, width_, 1);
+		context->rectangle( 0, height_ - 1, width_, 1);
+		context->fill();
+		context->restore();
+	}
+	if (!broken_strips_.empty() && broken_strips_layer_) {
+		Cairo::RefPtr<Cairo::SurfacePattern> pattern =
+			Cairo::SurfacePattern::create(broken_strips_layer_);
+		pattern->set_extend(Cairo::EXTEND_REPEAT);
+		pattern->set_filter(Cairo::FILTER_NEAREST);
+
+		context->save();
+		context->rectangle( 0, 0, width_, height_);
+		context->clip();
+		context->set_source(pattern);
+		context->paint();
+		context->restore();
+	}
+	if (measure_)
+		draw_roi(context);
+}
 
-	if (margins_) {
-		Cairo::RefPtr<Cairo::Context> cr = pixmap_->create_cairo_context();
+/**
+ * Builds missing overlay layers for the current scale. Margins and
+ * broken strips are vertical lines over the whole image height, so
+ * their layers are a single row of the scaled image width.
+ */
+void
+ImageArea::update_overlays()
+{
+	if (width_ <= 0 || height_ <= 0)
+		return;
+
+	if (margins_ && !margins_layer_) {
+		margins_layer_ = Cairo::ImageSurface::create( Cairo::FORMAT_ARGB32,
+			width_, 1);
+		Cairo::RefPtr<Cairo::Context> cr =
+			Cairo::Context::create(margins_layer_);
 		cr->set_source_rgb( .337, .612, .117); // green
-		cr->rectangle( 0, 0, w, h);
-		cr->clip();
-		cr->save();
+		draw_margins( cr, width_, 1);
+		cr->stroke();
 
-		draw_margins( cr, w, h);
+		numbers_layer_ = Cairo::ImageSurface::create( Cairo::FORMAT_ARGB32,
+			width_, MIN( height_, numbers_layer_height));
+		cr = Cairo::Context::create(numbers_layer_);
+		cr->set_source_rgb( .337, .612, .117); // green
 		draw_numbers(cr);
-
-		cr->restore();
-		cr->stroke();
 	}
-	if (!broken_strips_.empty()) {
-		Cairo::RefPtr<Cairo::Context> cr = pixmap_->create_cairo_context();
+	if (!broken_strips_.empty() && !broken_strips_layer_) {
+		broken_strips_layer_ = Cairo::ImageSurface::create(
+			Cairo::FORMAT_ARGB32, width_, 1);
+		Cairo::RefPtr<Cairo::Context> cr =
+			Cairo::Context::create(broken_strips_layer_);
 		cr->set_source_rgb( .9, .1, .1); // red
-		cr->rectangle( 0, 0, w, h);
-		cr->clip();
-		cr->save();
-
-		draw_broken_strips( cr, h);
-		cr->restore();
+		draw_broken_strips( cr, 1);
 		cr->stroke();
 	}
 }
 
+void
+ImageArea::invalidate_overlays()
+{
+	margins_layer_.clear();
+	numbers_layer_.clear();
+	broken_strips_layer_.clear();
+}
+
 bool
 ImageArea::on_configure_event(GdkEventConfigure* event)
 {
-	if (pixbuf_) {
+	if (!pyramid_.empty())
 		update_image_visible_margins( event->width, event->height);
-		update_pixmap();
-	}
+
 	return true;
 }
 
 void
 ImageArea::set_scroll_to( int x, int y)
 {
+	Glib::RefPtr<Gdk::Window> window = get_window();
+
+	int vx, vy;
+	view_origin( vx, vy);
+
 	pos_x_ = x;
 	pos_y_ = y;
-	queue_draw();
+
+	if (window && !pyramid_.empty()) {
+		// move the drawn image, only the uncovered part is exposed
+		int nx, ny;
+		view_origin( nx, ny);
+		window->scroll( vx - nx, vy - ny);
+	}
+	else
+		queue_draw();
 }
 
 void
@@ -345,41 +554,27 @@ ImageArea::set_palette(const Image::Palette* palette)
 {
 	palette_ = palette;
 
-	if (pixbuf_) {
-
-		for ( int i = 0; i < image_height_ * image_width_; i++) {
-			guint8 pix = buf_color_[i];
-			if (palette_) {
-				buf_[3 * i + 0] = palette_->rgb(3 * pix + 0);
-				buf_[3 * i + 1] = palette_->rgb(3 * pix + 1);
-				buf_[3 * i + 2] = palette_->rgb(3 * pix + 2);
-			}
-			else
-				buf_[3 * i + 0] = buf_[3 * i + 1] = buf_[3 * i + 2] = pix;
-		}
-
-		Gtk::Allocation wa = get_allocation();
-
-		update_scale( wa.get_width(), wa.get_height());
-		update_pixbuf();
-		update_image_visible_margins( wa.get_width(), wa.get_height());
-		update_pixmap();
-
+	// tiles are cached per palette type, nothing to recolor here
+	if (!pyramid_.empty())
 		queue_draw();
-	}
 }
 
 void
 ImageArea::set_image_data(const Image::SummaryData& data)
 {
-	buf_color_ = data.image_buffer();
 	const Image::DataSharedPtr& image = data.raw_data();
 
 	if (image) {
 		image_height_ = image->height();
 		image_width_ = image->width();
 
-		update_image_data();
+		clear_roi();
+		raw_data_ = image;
+		if (measure_)
+			integral_.build(raw_data_);
+
+		image_data_ = data;
+		show_image_buffer();
 	}
 	else {
 		clear_area();
@@ -387,44 +582,86 @@ ImageArea::set_image_data(const Image::SummaryData& data)
 }
 
 void
-ImageArea::update_image_data()
+ImageArea::update_image_data(const std::vector<guint8>& buffer)
 {
-	buf_.resize(3 * image_height_ * image_width_);
-
-	for ( int i = 0; i < image_height_ * image_width_; i++) {
-		guint8 pix = buf_color_[i];
-		if (palette_) {
-			buf_[3 * i + 0] = palette_->rgb(3 * pix + 0);
-			buf_[3 * i + 1] = palette_->rgb(3 * pix + 1);
-			buf_[3 * i + 2] = palette_->rgb(3 * pix + 2);
-		}
-		else
-			buf_[3 * i + 0] = buf_[3 * i + 1] = buf_[3 * i + 2] = pix;
-	}
+	pyramid_.build( image_width_, image_height_, buffer);
+	tiles_.clear();
 
 	Gtk::Allocation wa = get_allocation();
 
 	update_scale( wa.get_width(), wa.get_height());
-	update_pixbuf();
 	update_image_visible_margins( wa.get_width(), wa.get_height());
-	update_pixmap();
+	invalidate_overlays();
 
 	signal_scale_(scale_);
 	get_window()->invalidate_rect( wa, false);
 }
 
+void
+ImageArea::show_image_buffer()
+{
+	if (view_filter_ == Image::FILTER_NONE)
+		update_image_data(static_cast<const Image::SummaryData&>(
+			image_data_).image_buffer());
+	else
+		update_image_data(filtered_buffer());
+}
+
+std::vector<guint8>
+ImageArea::filtered_buffer() const
+{
+	const std::vector<guint8>& buffer = image_data_.image_buffer();
+	if (buffer.size() != size_t(image_width_) * image_height_)
+		return buffer;
+
+	Image::DataSharedPtr image = Image::Data::create( image_width_,
+		image_height_);
+	std::copy( buffer.begin(), buffer.end(), image->data());
+	image = Image::filter( image, view_filter_);
+
+	std::vector<guint8> result(buffer.size());
+	const gint16* pixel = image->data();
+	for ( size_t i = 0; i < result.size(); ++i)
+		result[i] = CLAMP( pixel[i], 0, UCHAR_MAX);
+	return result;
+}
+
+/**
+ * The filter runs on the display buffer of the shown image, so it works
+ * for images of any source and keeps the levels the buffer was made with.
+ * The raw data and the region measurement are not changed.
+ */
+void
+ImageArea::on_view_filter( const Glib::RefPtr<Gtk::RadioAction>& action,
+	Image::FilterType type)
+{
+	if (!action->get_active() || type == view_filter_)
+		return;
+
+	view_filter_ = type;
+	if (!pyramid_.empty())
+		show_image_buffer();
+}
+
 void
 ImageArea::draw_margins( Cairo::RefPtr<Cairo::Context>& context,
 	int width, int height)
 {
 	context->set_line_width(3.);
 
-	// Draw margins:
-	for ( int i = 1; i < SCANNER_CHIPS; i++) {
-		context->move_to( i * IMAGE_STRIPS_PER_CHIP * scale_, 0);
+	// Draw margins between the chips the image is formed of:
+	const std::string& codes = image_data_.chip_codes();
+	for ( unsigned int i = 1; i < codes.size(); i++) {
+		double strips = double(i * image_width_) / codes.size();
+		context->move_to( strips * scale_, 0);
 		context->rel_line_to( 0, height);
 	}
-	context->rectangle( 0, 0, width, height);
+
+	// left and right borders, top and bottom are drawn by draw_overlays
+	context->move_to( 0, 0);
+	context->rel_line_to( 0, height);
+	context->move_to( width, 0);
+	context->rel_line_to( 0, height);
 }
 
 void
@@ -436,16 +673,18 @@ ImageArea::draw_numbers(Cairo::RefPtr<Cairo::Context>& context)
 		Cairo::FONT_WEIGHT_NORMAL);
 	context->set_font_size(20.);
 	
-	for ( int i = 0; i < SCANNER_CHIPS; i++) {
-		context->get_text_extents( chip_strings[i], extents);
+	const std::string& codes = image_data_.chip_codes();
+	for ( unsigned int i = 0; i < codes.size(); i++) {
+		std::string text( 1, codes[i]);
+		context->get_text_extents( text, extents);
 
-		int sx = i * IMAGE_STRIPS_PER_CHIP * scale_;
+		int sx = double(i * image_width_) / codes.size() * scale_;
 		sx += extents.width + extents.x_bearing;
 		sx -= 0.5 * i;
 		int sy = 3 * extents.height + extents.y_bearing;
 
 		context->move_to( sx, sy);
-		context->show_text(chip_strings[i]);
+		context->show_text(text);
 	}
 }
 
@@ -465,8 +704,8 @@ void
 ImageArea::on_draw_margins(const Glib::RefPtr<Gtk::ToggleAction>& action)
 {
 	margins_ = action->get_active();
-	if (pixbuf_) {
-		update_pixmap();
+	if (!pyramid_.empty()) {
+		invalidate_overlays();
 		queue_draw();
 	}
 }
@@ -474,7 +713,7 @@ ImageArea::on_draw_margins(const Glib::RefPtr<Gtk::ToggleAction>& action)
 void
 ImageArea::on_draw_broken_strips(const Glib::RefPtr<Gtk::ToggleAction>& action)
 {
-	if (pixbuf_) {
+	if (!pyramid_.empty()) {
 		if (action->get_active()) {
 			Scanner::SharedManager manager = Scanner::Manager::instance();
 			broken_strips_ = manager->current_broken_strips();
@@ -482,11 +721,84 @@ ImageArea::on_draw_broken_strips(const Glib::RefPtr<Gtk::ToggleAction>& action)
 		else
 			broken_strips_.clear();
 
-		update_pixmap();
+		invalidate_overlays();
 		queue_draw();
 	}
 }
 
+/**
+ * The tables are built for the shown image when measuring is turned on
+ * and then for every next image until it is turned off.
+ */
+void
+ImageArea::on_measure_roi(const Glib::RefPtr<Gtk::ToggleAction>& action)
+{
+	measure_ = action->get_active();
+	clear_roi();
+
+	if (measure_ && raw_data_)
+		integral_.build(raw_data_);
+	else
+		integral_.clear();
+
+	queue_draw();
+}
+
+void
+ImageArea::draw_roi(Cairo::RefPtr<Cairo::Context>& context)
+{
+	if (roi_x0_ == roi_x1_ || roi_y0_ == roi_y1_)
+		return;
+
+	context->save();
+	context->set_line_width(1.);
+	context->set_source_rgb( .95, .85, .1); // yellow
+	context->rectangle( MIN( roi_x0_, roi_x1_) * scale_ + .5,
+		MIN( roi_y0_, roi_y1_) * scale_ + .5,
+		ABS(roi_x1_ - roi_x0_) * scale_, ABS(roi_y1_ - roi_y0_) * scale_);
+	context->stroke();
+	context->restore();
+}
+
+/**
+ * Position of the window point (x, y) in the image pixels.
+ */
+void
+ImageArea::image_position( double x, double y, int& column, int& row) const
+{
+	int vx, vy;
+	view_origin( vx, vy);
+
+	column = static_cast<int>((x - x_offset_ + vx) / scale_);
+	row = static_cast<int>((y - y_offset_ + vy) / scale_);
+
+	column = CLAMP( column, 0, image_width_);
+	row = CLAMP( row, 0, image_height_);
+}
+
+void
+ImageArea::measure_roi()
+{
+	Image::RoiStatistics stats;
+
+	int left = MIN( roi_x0_, roi_x1_);
+	int top = MIN( roi_y0_, roi_y1_);
+
+	if (integral_.statistics( left, top, ABS(roi_x1_ - roi_x0_),
+		ABS(roi_y1_ - roi_y0_), stats))
+		signal_roi_(stats);
+}
+
+void
+ImageArea::clear_roi()
+{
+	roi_drag_ = false;
+	roi_x0_ = 0;
+	roi_y0_ = 0;
+	roi_x1_ = 0;
+	roi_y1_ = 0;
+}
+
 void
 ImageArea::clear_area()
 {
@@ -504,10 +816,14 @@ ImageArea::clear_area()
 	zoom_ = ZOOM_HEIGHT;
 	margins_ = false;
 
-	pixbuf_.reset();
-	pixmap_.reset();
-	buf_.clear();
-	buf_color_.clear();
+	pyramid_.clear();
+	tiles_.clear();
+	invalidate_overlays();
+
+	clear_roi();
+	integral_.clear();
+	raw_data_.reset();
+	image_data_.clear();
 
 	modify_bg( Gtk::STATE_NORMAL, gray);
 
@@ -517,9 +833,14 @@ ImageArea::clear_area()
 Glib::RefPtr<Gdk::Pixbuf>
 ImageArea::get_pixbuf() const
 {
-	return Gdk::Pixbuf::create_from_data( &buf_[0],
-		Gdk::COLORSPACE_RGB, false, 8,
-		image_width_, image_height_, 3 * image_width_);
+	Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+
+	if (!pyramid_.empty()) {
+		pixbuf = Gdk::Pixbuf::create( Gdk::COLORSPACE_RGB, false, 8,
+			image_width_, image_height_);
+		fill_rgb( pyramid_.level(0), 0, 0, pixbuf);
+	}
+	return pixbuf;
 }
 
 void
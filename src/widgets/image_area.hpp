@@ -24,8 +24,13 @@
 
 // files from src directory begin
 #include "image/summary_data.hpp"
+#include "image/pyramid.hpp"
+#include "image/integral_image.hpp"
+#include "image/filter.hpp"
 // files from src directory end
 
+#include "tile_cache.hpp"
+
 namespace Gtk {
 class Menu;
 }
@@ -56,6 +61,9 @@ public:
 	void on_zoom(ZoomType);
 	void on_draw_margins(const Glib::RefPtr<Gtk::ToggleAction>&);
 	void on_draw_broken_strips(const Glib::RefPtr<Gtk::ToggleAction>&);
+	void on_measure_roi(const Glib::RefPtr<Gtk::ToggleAction>&);
+	void on_view_filter( const Glib::RefPtr<Gtk::RadioAction>&,
+		Image::FilterType);
 	void set_broken_strips(const std::vector<guint>& strips);
 	void clear_area();
 	void get_image_size( int& width, int& height) const;
@@ -64,6 +72,7 @@ public:
 	void set_image_data(const Image::SummaryData& data);
 
 	sigc::signal< void, double> signal_scale_changed();
+	sigc::signal< void, const Image::RoiStatistics&> signal_roi_measured();
 	void set_scroll_to( int, int);
 	void set_popup_menu(Gtk::Menu*);
 
@@ -72,6 +81,7 @@ protected:
 	virtual void on_realize();
 	virtual bool on_expose_event(GdkEventExpose*);
 	virtual bool on_button_press_event(GdkEventButton*);
+	virtual bool on_button_release_event(GdkEventButton*);
 //	virtual bool on_scroll_event(GdkEventScroll*);
 	virtual bool on_motion_notify_event(GdkEventMotion*);
 	virtual bool on_leave_notify_event(GdkEventCrossing*);
@@ -80,18 +90,34 @@ protected:
 //	virtual void on_size_allocate(Gtk::Allocation&);
 
 private:
-	void update_image_data();
-	void update_pixbuf();
-	void update_pixmap();
+	void update_image_data(const std::vector<guint8>&);
+	void show_image_buffer();
+	std::vector<guint8> filtered_buffer() const;
+	void view_origin( int& x, int& y) const;
+	void draw_tiles( const Glib::RefPtr<Gdk::Window>&, int x, int y,
+		int width, int height);
+	void draw_overlays(Cairo::RefPtr<Cairo::Context>&);
+	void update_overlays();
+	void invalidate_overlays();
+	Glib::RefPtr<Gdk::Pixbuf> get_tile( int column, int row);
+	Glib::RefPtr<Gdk::Pixbuf> render_tile( int column, int row) const;
+	void fill_rgb( const Image::Pyramid::Level&, int x, int y,
+		const Glib::RefPtr<Gdk::Pixbuf>&) const;
+	const Image::Palette& current_palette() const;
 	void update_image_visible_margins( int width, int height);
 	void update_scale( int width, int height);
 	void draw_margins( Cairo::RefPtr<Cairo::Context>&, int, int);
 	void draw_numbers( Cairo::RefPtr<Cairo::Context>&);
 	void draw_broken_strips( Cairo::RefPtr<Cairo::Context>&, int);
+	void draw_roi(Cairo::RefPtr<Cairo::Context>&);
 	bool pointer_within_image(const GdkEventMotion*) const;
+	void image_position( double x, double y, int& column, int& row) const;
+	void measure_roi();
+	void clear_roi();
 
 	// Signals
 	sigc::signal< void, double> signal_scale_;
+	sigc::signal< void, const Image::RoiStatistics&> signal_roi_;
 
 	int pos_x_; // x scroll position
 	int pos_y_; // y scroll position
@@ -110,15 +136,31 @@ private:
 
 	double scale_; // image scale (1.0 is actual scale)
 
-	Glib::RefPtr<Gdk::Pixbuf> pixbuf_;
-	Glib::RefPtr<Gdk::Pixmap> pixmap_;
+	Image::Pyramid pyramid_; // image levels for the zoomed out views
+	TileCache tiles_; // rendered tiles of the scaled image
+
+	// overlay layers for the current scale, built on demand
+	Cairo::RefPtr<Cairo::ImageSurface> margins_layer_;
+	Cairo::RefPtr<Cairo::ImageSurface> numbers_layer_;
+	Cairo::RefPtr<Cairo::ImageSurface> broken_strips_layer_;
 
 	ZoomType zoom_;
 	bool margins_;
 	std::vector<guint> broken_strips_;
 
-	std::vector<guint8> buf_;
-	std::vector<guint8> buf_color_;
+	// region of interest measurement, corners in image pixels
+	Image::IntegralImage integral_; // built when measuring is on
+	Image::DataSharedPtr raw_data_;
+	bool measure_;
+	bool roi_drag_;
+	int roi_x0_;
+	int roi_y0_;
+	int roi_x1_;
+	int roi_y1_;
+
+	// shown image, the view filter runs on its display buffer
+	Image::SummaryData image_data_;
+	Image::FilterType view_filter_;
 
 	const Image::Palette* palette_;
 	Gtk::Menu* menu_;
@@ -16,6 +16,7 @@
  */
 
 #include <vector>
+#include <algorithm>
 #include <climits>
 #include <gtkmm/menu.h>
 
@@ -51,18 +52,16 @@ PaletteArea::on_expose_event(GdkEventExpose* event)
 
 	if (window) {
 		std::vector<guint8> data(3 * height * WIDTH);
+		std::vector<guint8> index(WIDTH);
 
-		for ( int pix = 0, i = height; i > 0; i--) {
+		for ( int pix = 0, i = height; i > 0; i--, pix += WIDTH) {
 			guint8 a = (UCHAR_MAX * i) / height;
-			for ( int j = 0; j < WIDTH; j++, pix++) {
-				if (palette_) {
-					data[pix * 3 + 0] = palette_->rgb(3 * a + 0);
-					data[pix * 3 + 1] = palette_->rgb(3 * a + 1);
-					data[pix * 3 + 2] = palette_->rgb(3 * a + 2);
-				}
-				else
-					data[pix * 3 + 0] = data[pix * 3 + 1] = data[pix * 3 + 2] = a;
+			if (palette_) {
+				std::fill( index.begin(), index.end(), a);
+				palette_->expand( &index[0], &data[3 * pix], WIDTH);
 			}
+			else
+				std::fill( &data[3 * pix], &data[3 * (pix + WIDTH)], a);
 		}
 
 		Glib::RefPtr<Gdk::Pixbuf> pixbuf = Gdk::Pixbuf::create_from_data(
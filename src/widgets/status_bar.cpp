@@ -137,7 +137,7 @@ Statusbar::update_scanner_state(const Scanner::State& state)
 		set_text(_("Image reconstruction in progress..."));
 		switch (mstate.process()) {
 		case PROCESS_START:
-			set_pulse_progress();
+			set_progress(mstate.progress());
 			break;
 		case PROCESS_FINISH:
 		default:
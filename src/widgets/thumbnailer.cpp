@@ -0,0 +1,328 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <climits>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <glibmm/checksum.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include <Magick++.h>
+
+// files from src directory begin
+#include "global_strings.hpp"
+#include "file.hpp"
+#include "file_loader.hpp"
+#include "utils.hpp"
+// files from src directory end
+
+#include "thumbnailer.hpp"
+
+namespace {
+
+const unsigned int max_workers = 4;
+
+void
+store_image_data( const std::string&, ScanAmati::File& file,
+	ScanAmati::Image::SummaryData& data)
+{
+	data = file.image_data();
+}
+
+} // namespace
+
+namespace ScanAmati {
+
+namespace UI {
+
+Thumbnailer::Thumbnailer(unsigned int workers)
+	:
+	last_id_(0),
+	use_cache_(false),
+	stop_(false)
+{
+	std::string dir = get_thumbnails_dir();
+	use_cache_ = !g_mkdir_with_parents( dir.c_str(), 0700);
+
+	if (!workers) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		workers = (cpus > 0) ? cpus : 1;
+		if (workers > max_workers)
+			workers = max_workers;
+	}
+
+	signal_done_.connect(sigc::mem_fun( *this, &Thumbnailer::on_icon_done));
+
+	sigc::slot<void> slot = sigc::mem_fun( *this, &Thumbnailer::run_worker);
+	for ( unsigned int i = 0; i < workers; ++i)
+		threads_.push_back(Glib::Thread::create( slot, true));
+}
+
+Thumbnailer::~Thumbnailer()
+{
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		stop_ = true;
+		requests_.clear();
+		cond_.broadcast();
+	}
+
+	for ( std::vector<Glib::Thread*>::iterator iter = threads_.begin();
+		iter != threads_.end(); ++iter)
+		(*iter)->join();
+}
+
+unsigned int
+Thumbnailer::add( const Image::SummaryData& data,
+	const std::string& filename, unsigned int size)
+{
+	Glib::Mutex::Lock lock(mutex_);
+	requests_.push_back(Request());
+
+	Request& request = requests_.back();
+	request.id = ++last_id_;
+	request.size = size;
+	request.filename = filename;
+	request.data = data;
+	cond_.signal();
+
+	return request.id;
+}
+
+void
+Thumbnailer::cancel()
+{
+	Glib::Mutex::Lock lock(mutex_);
+	requests_.clear();
+	icons_.clear();
+}
+
+void
+Thumbnailer::run_worker()
+{
+	while (true) {
+		Request request;
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			while (!stop_ && requests_.empty())
+				cond_.wait(mutex_);
+			if (stop_)
+				break;
+
+			request = requests_.front();
+			requests_.pop_front();
+		}
+
+		Icon icon;
+		icon.id = request.id;
+		icon.width = icon.height = 0;
+		create_icon( request, icon);
+
+		{
+			Glib::Mutex::Lock lock(mutex_);
+			if (stop_)
+				break;
+			icons_.push_back(Icon());
+			icons_.back().id = icon.id;
+			icons_.back().width = icon.width;
+			icons_.back().height = icon.height;
+			icons_.back().rgb.swap(icon.rgb);
+		}
+		signal_done_();
+	}
+}
+
+void
+Thumbnailer::on_icon_done()
+{
+	std::deque<Icon> icons;
+	{
+		Glib::Mutex::Lock lock(mutex_);
+		icons.swap(icons_);
+	}
+
+	for ( std::deque<Icon>::const_iterator iter = icons.begin();
+		iter != icons.end(); ++iter) {
+		Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+		if (!iter->rgb.empty()) {
+			pixbuf = Gdk::Pixbuf::create( Gdk::COLORSPACE_RGB, false, 8,
+				iter->width, iter->height);
+
+			guint8* dest = pixbuf->get_pixels();
+			const guint8* src = &iter->rgb[0];
+			int stride = pixbuf->get_rowstride();
+			for ( unsigned int row = 0; row < iter->height; ++row) {
+				std::copy( src, src + 3 * iter->width, dest);
+				src += 3 * iter->width;
+				dest += stride;
+			}
+		}
+		signal_ready_( iter->id, pixbuf);
+	}
+}
+
+void
+Thumbnailer::create_icon( const Request& request, Icon& icon)
+{
+	std::string cache;
+	if (use_cache_ && !request.filename.empty()) {
+		cache = cache_filename( request.filename, request.size);
+		if (!cache.empty() && read_cache( cache, icon))
+			return;
+	}
+
+	// files opened without their pixels are loaded on a cache miss only
+	Image::SummaryData data = request.data;
+	if (!data.raw_data() && !request.filename.empty())
+		data = load_image(request.filename);
+
+	const Image::DataSharedPtr& img = data.raw_data();
+	const std::vector<guint8>& buffer = data.image_buffer();
+	if (!img || buffer.empty())
+		return;
+
+	try {
+		Magick::Image image( img->width(), img->height(), "I",
+			Magick::CharPixel, &buffer[0]);
+		Glib::ustring str = Glib::ustring::compose( "%1x%1\>",
+			Glib::ustring::format(request.size));
+
+		Magick::Geometry geom(str.c_str());
+		image.filterType(Magick::CubicFilter);
+#if (MagickLibVersion >= 0x660 && MagickLibVersion <= 0x669) 
+		image.resize(geom);
+#else
+		image.scale(geom);
+#endif
+
+		unsigned int w = image.columns();
+		unsigned int h = image.rows();
+		const Magick::PixelPacket* pixel = image.getConstPixels( 0, 0, w, h);
+
+		icon.width = w;
+		icon.height = h;
+		icon.rgb.resize(3 * w * h);
+		for ( unsigned int i = 0; i < w * h; ++i) {
+			guint8 pix = UCHAR_MAX * (double(pixel++->red) / USHRT_MAX);
+			icon.rgb[3 * i + 0] = icon.rgb[3 * i + 1] = icon.rgb[3 * i + 2] = pix;
+		}
+	}
+	catch (const Magick::Exception&) {
+		icon.rgb.clear();
+		return;
+	}
+
+	if (!cache.empty())
+		write_cache( cache, icon);
+}
+
+Image::SummaryData
+Thumbnailer::load_image(const std::string& filename)
+{
+	Image::SummaryData data;
+	try {
+		FileLoader loader(filename);
+		loader.signal_file_loaded().connect(sigc::bind(
+			sigc::ptr_fun(&store_image_data), sigc::ref(data)));
+		loader.load();
+	}
+	catch (const Exception&) {
+	}
+	return data;
+}
+
+std::string
+Thumbnailer::cache_filename( const std::string& filename, unsigned int size)
+{
+	struct stat buf;
+	if (g_stat( filename.c_str(), &buf))
+		return std::string();
+
+	std::string path = filename;
+	if (!Glib::path_is_absolute(path))
+		path = Glib::build_filename( Glib::get_current_dir(), filename);
+
+	std::ostringstream key;
+	key << path << ':' << buf.st_size << ':' << buf.st_mtime << ':' << size;
+
+	std::string name = Glib::Checksum::compute_checksum(
+		Glib::Checksum::CHECKSUM_MD5, key.str());
+	return (get_thumbnails_dir() + G_DIR_SEPARATOR_S + name + "."
+		+ thumbnail_file_extension);
+}
+
+/**
+ * Icons are cached as binary portable pixmaps, the format needs no
+ * library and is simple enough to read and write from worker threads.
+ */
+bool
+Thumbnailer::read_cache( const std::string& cache, Icon& icon)
+{
+	std::ifstream file( cache.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::string magic;
+	unsigned int w, h, max;
+	file >> magic >> w >> h >> max;
+	if (!file || magic != "P6" || max != UCHAR_MAX || !w || !h)
+		return false;
+	file.get(); // single whitespace before the raster
+
+	std::vector<guint8> rgb(3 * w * h);
+	file.read( reinterpret_cast<char*>(&rgb[0]), rgb.size());
+	if (!file)
+		return false;
+
+	icon.width = w;
+	icon.height = h;
+	icon.rgb.swap(rgb);
+	return true;
+}
+
+void
+Thumbnailer::write_cache( const std::string& cache, const Icon& icon)
+{
+	// Write a temporary file first, so that other workers
+	// never read a partially written icon.
+	std::ostringstream tmp;
+	tmp << cache << '.' << Glib::Thread::self();
+
+	std::ofstream file( tmp.str().c_str(), std::ios::binary);
+	if (!file.is_open())
+		return;
+
+	file << "P6\n" << icon.width << ' ' << icon.height << '\n'
+		<< UCHAR_MAX << '\n';
+	file.write( reinterpret_cast<const char*>(&icon.rgb[0]), icon.rgb.size());
+	file.close();
+
+	if (file)
+		g_rename( tmp.str().c_str(), cache.c_str());
+	else
+		g_unlink(tmp.str().c_str());
+}
+
+} // namespace UI
+
+} // namespace ScanAmati
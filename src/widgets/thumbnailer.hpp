@@ -0,0 +1,118 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/thread.h>
+#include <gdkmm/pixbuf.h>
+
+// files from src directory begin
+#include "image/summary_data.hpp"
+// files from src directory end
+
+namespace ScanAmati {
+
+namespace UI {
+
+/**
+ * Pool of worker threads producing icon pixbufs for image data.
+ *
+ * Requests are queued with add() and served in order. Icons of images
+ * loaded from files are kept in the thumbnails cache directory, keyed
+ * by the file path, size and modification time, so reopening the same
+ * files does not scale the images again. A request of a file without
+ * image data loads the pixels in the worker if its icon is not cached.
+ * Finished icons are delivered on the GUI thread by signal_ready().
+ */
+class Thumbnailer {
+
+public:
+	explicit Thumbnailer(unsigned int workers = 0);
+	~Thumbnailer();
+
+	/** \brief Queue an icon request.
+	 *
+	 * \param data     Image data of the icon, may be empty for a file.
+	 * \param filename File of the data or empty string if there is none,
+	 *                 the icon is not cached in the latter case.
+	 * \param size     Maximum icon width and height.
+	 * \return request id passed to signal_ready() handlers.
+	 */
+	unsigned int add( const Image::SummaryData& data,
+		const std::string& filename = std::string(),
+		unsigned int size = 64);
+
+	/** Drop all queued requests. */
+	void cancel();
+
+	sigc::signal< void, unsigned int, Glib::RefPtr<Gdk::Pixbuf> >
+		signal_ready();
+
+private:
+	struct Request {
+		unsigned int id;
+		unsigned int size;
+		std::string filename;
+		Image::SummaryData data; // shares pixels with the caller
+	};
+
+	struct Icon {
+		unsigned int id;
+		unsigned int width;
+		unsigned int height;
+		std::vector<guint8> rgb;
+	};
+
+	void run_worker();
+	void on_icon_done();
+	void create_icon( const Request&, Icon&);
+
+	static Image::SummaryData load_image(const std::string& filename);
+	static std::string cache_filename( const std::string& filename,
+		unsigned int size);
+	static bool read_cache( const std::string& cache, Icon&);
+	static void write_cache( const std::string& cache, const Icon&);
+
+	std::vector<Glib::Thread*> threads_;
+	std::deque<Request> requests_;
+	std::deque<Icon> icons_;
+	Glib::Mutex mutex_;
+	Glib::Cond cond_;
+	Glib::Dispatcher signal_done_;
+	unsigned int last_id_;
+	bool use_cache_;
+	bool stop_;
+
+	sigc::signal< void, unsigned int, Glib::RefPtr<Gdk::Pixbuf> >
+		signal_ready_;
+};
+
+inline
+sigc::signal< void, unsigned int, Glib::RefPtr<Gdk::Pixbuf> >
+Thumbnailer::signal_ready()
+{
+	return signal_ready_;
+}
+
+} // namespace UI
+
+} // namespace ScanAmati
@@ -0,0 +1,77 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include "tile_cache.hpp"
+
+namespace ScanAmati {
+
+namespace UI {
+
+bool
+operator<( const TileKey& k1, const TileKey& k2)
+{
+	if (k1.scale != k2.scale)
+		return k1.scale < k2.scale;
+	if (k1.palette != k2.palette)
+		return k1.palette < k2.palette;
+	if (k1.row != k2.row)
+		return k1.row < k2.row;
+	return k1.column < k2.column;
+}
+
+Glib::RefPtr<Gdk::Pixbuf>
+TileCache::find(const TileKey& key)
+{
+	Glib::RefPtr<Gdk::Pixbuf> tile;
+
+	TileMap::iterator it = map_.find(key);
+	if (it != map_.end()) {
+		tiles_.splice( tiles_.begin(), tiles_, it->second);
+		tile = it->second->second;
+	}
+	return tile;
+}
+
+void
+TileCache::insert( const TileKey& key, const Glib::RefPtr<Gdk::Pixbuf>& tile)
+{
+	TileMap::iterator it = map_.find(key);
+	if (it != map_.end()) {
+		it->second->second = tile;
+		tiles_.splice( tiles_.begin(), tiles_, it->second);
+		return;
+	}
+
+	tiles_.push_front(TilePair( key, tile));
+	map_.insert(TileMap::value_type( key, tiles_.begin()));
+
+	while (map_.size() > capacity_) {
+		map_.erase(tiles_.back().first);
+		tiles_.pop_back();
+	}
+}
+
+void
+TileCache::clear()
+{
+	map_.clear();
+	tiles_.clear();
+}
+
+} // namespace UI
+
+} // namespace ScanAmati
@@ -0,0 +1,67 @@
+/*
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+
+#include <gdkmm/pixbuf.h>
+
+namespace ScanAmati {
+
+namespace UI {
+
+struct TileKey {
+	double scale; // image scale the tile was rendered with
+	int palette; // palette type the tile was rendered with
+	int column;
+	int row;
+};
+
+bool operator<( const TileKey&, const TileKey&);
+
+/** \brief Least recently used cache of the rendered image tiles.
+ *
+ * Tiles are TILE_SIZE x TILE_SIZE parts of the scaled image (the last
+ * column and row may be smaller). When the cache is full, the tile that
+ * was not requested for the longest time is dropped.
+ */
+class TileCache {
+
+public:
+	enum { TILE_SIZE = 256 };
+
+	explicit TileCache(size_t capacity = 128) : capacity_(capacity) {}
+	Glib::RefPtr<Gdk::Pixbuf> find(const TileKey& key);
+	void insert( const TileKey& key, const Glib::RefPtr<Gdk::Pixbuf>& tile);
+	void clear();
+	size_t size() const { return map_.size(); }
+
+private:
+	typedef std::pair< TileKey, Glib::RefPtr<Gdk::Pixbuf> > TilePair;
+	typedef std::list<TilePair> TileList;
+	typedef std::map< TileKey, TileList::iterator> TileMap;
+
+	TileList tiles_; // most recently used first
+	TileMap map_;
+	size_t capacity_;
+};
+
+} // namespace UI
+
+} // namespace ScanAmati